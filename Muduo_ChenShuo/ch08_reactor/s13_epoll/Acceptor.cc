@@ -14,15 +14,29 @@
 
 #include <boost/bind.hpp>
 
+#include <unistd.h>
+
 using namespace muduo;
 
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr)
   : loop_(loop),
-    acceptSocket_(sockets::createNonblockingOrDie()),
+    acceptSocket_(sockets::createNonblockingOrDie(listenAddr.family())),
     acceptChannel_(loop, acceptSocket_.fd()),
     listenning_(false)
 {
-  acceptSocket_.setReuseAddr(true);
+  if (listenAddr.isUnix())
+  {
+    // a path left by the last run can't be bound
+    std::string path = listenAddr.unixPath();
+    if (!path.empty() && path[0] != '@')
+    {
+      ::unlink(path.c_str());
+    }
+  }
+  else
+  {
+    acceptSocket_.setReuseAddr(true);
+  }
   acceptSocket_.bindAddress(listenAddr);
   acceptChannel_.setReadCallback(
       boost::bind(&Acceptor::handleRead, this));
@@ -36,6 +50,20 @@ void Acceptor::listen()
   acceptChannel_.enableReading();
 }
 
+void Acceptor::pause()
+{
+  loop_->assertInLoopThread();
+  assert(listenning_);
+  acceptChannel_.disableAll();
+}
+
+void Acceptor::resume()
+{
+  loop_->assertInLoopThread();
+  assert(listenning_);
+  acceptChannel_.enableReading();
+}
+
 void Acceptor::handleRead()
 {
   loop_->assertInLoopThread();
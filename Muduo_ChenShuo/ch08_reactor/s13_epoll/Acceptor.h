@@ -13,11 +13,11 @@
 
 #include "Channel.h"
 #include "Socket.h"
+#include "EventLoopFwd.h"
 
 namespace muduo
 {
 
-class EventLoop;
 class InetAddress;
 
 ///
@@ -37,6 +37,11 @@ class Acceptor : muduo::noncopyable
   bool listenning() const { return listenning_; }
   void listen();
 
+  /// Stops and resumes accepting after listen(),
+  /// new connections wait in the backlog meanwhile.
+  void pause();
+  void resume();
+
  private:
   void handleRead();
 
@@ -12,10 +12,87 @@
 #include <errno.h>
 #include <memory.h>
 #include <sys/uio.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace muduo;
 
-ssize_t Buffer::readFd(int fd, int* savedErrno)
+namespace
+{
+
+// first c in [first, last), or last
+const char* findByte(const char* first, const char* last, char c)
+{
+#if defined(__AVX2__)
+  const __m256i c32 = _mm256_set1_epi8(c);
+  for (; last - first >= 32; first += 32)
+  {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, c32));
+    if (mask != 0)
+    {
+      return first + __builtin_ctz(mask);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i c16 = _mm_set1_epi8(c);
+  for (; last - first >= 16; first += 16)
+  {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, c16));
+    if (mask != 0)
+    {
+      return first + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; first < last; ++first)
+  {
+    if (*first == c)
+    {
+      return first;
+    }
+  }
+  return last;
+}
+
+}
+
+const char* Buffer::findEOL(const char* start) const
+{
+  assert(peek() <= start);
+  assert(start <= beginWrite());
+  const char* eol = findByte(start, beginWrite(), '\n');
+  return eol == beginWrite() ? NULL : eol;
+}
+
+const char* Buffer::findCRLF(const char* start) const
+{
+  assert(peek() <= start);
+  assert(start <= beginWrite());
+  // finds LF, then checks the byte before it
+  const char* end = beginWrite();
+  while (end - start >= 2)
+  {
+    const char* lf = findByte(start + 1, end, '\n');
+    if (lf == end)
+    {
+      break;
+    }
+    if (lf[-1] == '\r')
+    {
+      return lf - 1;
+    }
+    start = lf;
+  }
+  return NULL;
+}
+
+ssize_t Buffer::readFd(int fd, int* savedErrno, std::vector<int>* passedFds)
 {
   char extrabuf[65536];
   struct iovec vec[2];
@@ -24,7 +101,8 @@ ssize_t Buffer::readFd(int fd, int* savedErrno)
   vec[0].iov_len = writable;
   vec[1].iov_base = extrabuf;
   vec[1].iov_len = sizeof extrabuf;
-  const ssize_t n = readv(fd, vec, 2);
+  const ssize_t n = passedFds ? sockets::readvWithFds(fd, vec, 2, passedFds)
+                              : readv(fd, vec, 2);
   if (n < 0) {
     *savedErrno = errno;
   } else if (implicit_cast<size_t>(n) <= writable) {
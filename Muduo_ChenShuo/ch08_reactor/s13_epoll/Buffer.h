@@ -36,13 +36,13 @@ class Buffer : public muduo::copyable
   static const size_t kCheapPrepend = 8;
   static const size_t kInitialSize = 1024;
 
-  Buffer()
-    : buffer_(kCheapPrepend + kInitialSize),
+  explicit Buffer(size_t initialSize = kInitialSize)
+    : buffer_(kCheapPrepend + initialSize),
       readerIndex_(kCheapPrepend),
       writerIndex_(kCheapPrepend)
   {
     assert(readableBytes() == 0);
-    assert(writableBytes() == kInitialSize);
+    assert(writableBytes() == initialSize);
     assert(prependableBytes() == kCheapPrepend);
   }
 
@@ -67,6 +67,19 @@ class Buffer : public muduo::copyable
   const char* peek() const
   { return begin() + readerIndex_; }
 
+  /// Delimiter search, with SSE2 or AVX2 when the compiler targets them.
+  /// Returns NULL if not found.
+  const char* findCRLF() const
+  { return findCRLF(peek()); }
+
+  /// @c start must be in [peek(), beginWrite()].
+  const char* findCRLF(const char* start) const;
+
+  const char* findEOL() const
+  { return findEOL(peek()); }
+
+  const char* findEOL(const char* start) const;
+
   // retrieve returns void, to prevent
   // string str(retrieve(readableBytes()), readableBytes());
   // the evaluation of two functions are unspecified
@@ -149,8 +162,9 @@ class Buffer : public muduo::copyable
   /// Read data directly into buffer.
   ///
   /// It may implement with readv(2)
+  /// With @c passedFds, fds passed by SCM_RIGHTS are appended to it.
   /// @return result of read(2), @c errno is saved
-  ssize_t readFd(int fd, int* savedErrno);
+  ssize_t readFd(int fd, int* savedErrno, std::vector<int>* passedFds = NULL);
 
  private:
 
@@ -0,0 +1,107 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BUFFERBUDGET_H
+#define MUDUO_NET_BUFFERBUDGET_H
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/noncopyable.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace muduo
+{
+
+///
+/// Bytes held by the input and output buffers of a group of connections,
+/// eg. those of a TcpServer, against an optional limit.
+///
+/// Connections add the changes of their buffers from their own loops.
+/// The budget is exceeded above @c maxBytes, and stays so until the
+/// bytes drop below @c resumeRatio of it.
+/// Thread safe.
+class BufferBudget : muduo::noncopyable
+{
+ public:
+  BufferBudget()
+    : maxBytes_(0),
+      resumeBytes_(0)
+  { }
+
+  /// 0 means no limit, only accounting.
+  /// Not thread safe, set it before connections add to it.
+  void setLimit(int64_t maxBytes, double resumeRatio)
+  {
+    assert(0 < resumeRatio && resumeRatio <= 1.0);
+    maxBytes_ = maxBytes;
+    resumeBytes_ = static_cast<int64_t>(maxBytes * resumeRatio);
+  }
+
+  int64_t maxBytes() const { return maxBytes_; }
+  int64_t resumeBytes() const { return resumeBytes_; }
+
+  int64_t bytes() { return bytes_.get(); }
+  bool exceeded() { return exceeded_.get() != 0; }
+
+  /// Sends refused while exceeded, and their bytes.
+  int64_t refusedSends() { return refusedSends_.get(); }
+  int64_t refusedBytes() { return refusedBytes_.get(); }
+
+  /// Recomputes exceeded() from bytes(), and returns it.
+  ///
+  /// Racing add()s may leave the flag one change behind, and no more
+  /// add() comes while every large reader is paused.  Call this
+  /// periodically, as TcpServer does, rather than trust the flag.
+  bool update()
+  {
+    updateFlag(bytes_.get());
+    return exceeded();
+  }
+
+  // internal use only
+  void add(int64_t delta)
+  {
+    updateFlag(bytes_.addAndGet(delta));
+  }
+
+  void addRefused(size_t len)
+  {
+    refusedSends_.increment();
+    refusedBytes_.add(static_cast<int64_t>(len));
+  }
+
+ private:
+  void updateFlag(int64_t bytes)
+  {
+    if (maxBytes_ > 0)
+    {
+      if (bytes > maxBytes_)
+      {
+        if (!exceeded()) exceeded_.getAndSet(1);
+      }
+      else if (bytes < resumeBytes_)
+      {
+        if (exceeded()) exceeded_.getAndSet(0);
+      }
+    }
+  }
+
+  int64_t maxBytes_;
+  int64_t resumeBytes_;
+  AtomicInt64 bytes_;
+  AtomicInt32 exceeded_;
+  AtomicInt64 refusedSends_;
+  AtomicInt64 refusedBytes_;
+};
+
+}
+
+#endif  // MUDUO_NET_BUFFERBUDGET_H
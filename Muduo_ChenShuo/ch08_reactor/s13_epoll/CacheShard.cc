@@ -0,0 +1,311 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "CacheShard.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace muduo;
+
+const size_t CacheShard::kPageSize;
+const size_t CacheShard::kMaxKeyLen;
+
+namespace
+{
+
+const size_t kMinChunkSize = 96;
+const double kGrowthFactor = 1.25;
+
+}
+
+// header of an item, followed by the key and the data in its chunk
+struct CacheShard::Item
+{
+  Item* prev;   // LRU of its class
+  Item* next;   // LRU of its class, or free list
+  Item* hnext;  // hash chain
+  uint64_t hash;
+  time_t exptime;
+  uint32_t flags;
+  uint32_t nbytes;
+  uint8_t nkey;
+  uint8_t slabClass;
+
+  char* key() { return reinterpret_cast<char*>(this + 1); }
+  char* data() { return key() + nkey; }
+};
+
+struct CacheShard::SlabClass
+{
+  size_t chunkSize;
+  Item* freeList;
+  Item* lruHead;  // most recently used
+  Item* lruTail;
+};
+
+CacheShard::CacheShard(size_t memoryLimit)
+  : memoryLimit_(memoryLimit),
+    numPages_(0),
+    buckets_(1024),
+    numItems_(0),
+    evictions_(0)
+{
+  size_t size = kMinChunkSize;
+  while (true)
+  {
+    SlabClass c = { size, NULL, NULL, NULL };
+    classes_.push_back(c);
+    if (size == kPageSize)
+    {
+      break;
+    }
+    // 8 byte aligned, the last class holds a whole page
+    size = (static_cast<size_t>(static_cast<double>(size) * kGrowthFactor) + 7) & ~7;
+    if (size > kPageSize / 2)
+    {
+      size = kPageSize;
+    }
+  }
+  assert(classes_.size() < 256);
+}
+
+CacheShard::~CacheShard()
+{
+  for (size_t i = 0; i < pages_.size(); ++i)
+  {
+    ::free(pages_[i]);
+  }
+}
+
+uint64_t CacheShard::hashKey(const StringView& key)
+{
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.size(); ++i)
+  {
+    hash ^= static_cast<unsigned char>(key[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+CacheShard::Item* CacheShard::find(const StringView& key, uint64_t hash)
+{
+  Item* item = buckets_[hash & (buckets_.size() - 1)];
+  while (item)
+  {
+    if (item->hash == hash && item->nkey == key.size()
+        && memcmp(item->key(), key.data(), key.size()) == 0)
+    {
+      return item;
+    }
+    item = item->hnext;
+  }
+  return NULL;
+}
+
+bool CacheShard::get(const StringView& key, uint64_t hash, time_t now,
+                     Value* value)
+{
+  Item* item = find(key, hash);
+  if (item == NULL)
+  {
+    return false;
+  }
+  if (item->exptime != 0 && item->exptime <= now)
+  {
+    unlink(item);
+    release(item);
+    return false;
+  }
+  lruRemove(item);
+  lruPushFront(item);
+  value->key = StringView(item->key(), item->nkey);
+  value->flags = item->flags;
+  value->data = StringView(item->data(), item->nbytes);
+  return true;
+}
+
+CacheShard::SetResult CacheShard::set(const StringView& key, uint64_t hash,
+                                      uint32_t flags, time_t exptime,
+                                      const StringView& data)
+{
+  assert(key.size() <= kMaxKeyLen);
+  size_t size = sizeof(Item) + key.size() + data.size();
+  if (size > kPageSize)
+  {
+    return kTooLarge;
+  }
+  // may evict the old item of this key
+  Item* item = allocate(size);
+  if (item == NULL)
+  {
+    return kOutOfMemory;
+  }
+  Item* old = find(key, hash);
+  if (old)
+  {
+    unlink(old);
+    release(old);
+  }
+  item->hash = hash;
+  item->exptime = exptime;
+  item->flags = flags;
+  item->nbytes = static_cast<uint32_t>(data.size());
+  item->nkey = static_cast<uint8_t>(key.size());
+  memcpy(item->key(), key.data(), key.size());
+  memcpy(item->data(), data.data(), data.size());
+  link(item);
+  return kStored;
+}
+
+bool CacheShard::remove(const StringView& key, uint64_t hash)
+{
+  Item* item = find(key, hash);
+  if (item)
+  {
+    unlink(item);
+    release(item);
+  }
+  return item != NULL;
+}
+
+CacheShard::Item* CacheShard::allocate(size_t size)
+{
+  size_t id = 0;
+  while (classes_[id].chunkSize < size)
+  {
+    ++id;
+  }
+  SlabClass& c = classes_[id];
+
+  if (c.freeList == NULL && (numPages_ + 1) * kPageSize <= memoryLimit_)
+  {
+    char* page = static_cast<char*>(::malloc(kPageSize));
+    if (page)
+    {
+      pages_.push_back(page);
+      ++numPages_;
+      for (size_t offset = 0; offset + c.chunkSize <= kPageSize;
+           offset += c.chunkSize)
+      {
+        Item* chunk = reinterpret_cast<Item*>(page + offset);
+        chunk->next = c.freeList;
+        c.freeList = chunk;
+      }
+    }
+  }
+
+  Item* item = c.freeList;
+  if (item)
+  {
+    c.freeList = item->next;
+  }
+  else if (c.lruTail)
+  {
+    // no page for this class, reuse its least recently used item
+    item = c.lruTail;
+    unlink(item);
+    ++evictions_;
+  }
+  else
+  {
+    return NULL;
+  }
+  item->slabClass = static_cast<uint8_t>(id);
+  return item;
+}
+
+void CacheShard::release(Item* item)
+{
+  SlabClass& c = classes_[item->slabClass];
+  item->next = c.freeList;
+  c.freeList = item;
+}
+
+void CacheShard::link(Item* item)
+{
+  if (numItems_ >= buckets_.size() + buckets_.size() / 2)
+  {
+    grow();
+  }
+  Item*& bucket = buckets_[item->hash & (buckets_.size() - 1)];
+  item->hnext = bucket;
+  bucket = item;
+  lruPushFront(item);
+  ++numItems_;
+}
+
+void CacheShard::unlink(Item* item)
+{
+  Item** p = &buckets_[item->hash & (buckets_.size() - 1)];
+  while (*p != item)
+  {
+    p = &(*p)->hnext;
+  }
+  *p = item->hnext;
+  lruRemove(item);
+  --numItems_;
+}
+
+void CacheShard::lruRemove(Item* item)
+{
+  SlabClass& c = classes_[item->slabClass];
+  if (item->prev)
+  {
+    item->prev->next = item->next;
+  }
+  else
+  {
+    c.lruHead = item->next;
+  }
+  if (item->next)
+  {
+    item->next->prev = item->prev;
+  }
+  else
+  {
+    c.lruTail = item->prev;
+  }
+  item->prev = item->next = NULL;
+}
+
+void CacheShard::lruPushFront(Item* item)
+{
+  SlabClass& c = classes_[item->slabClass];
+  item->prev = NULL;
+  item->next = c.lruHead;
+  if (c.lruHead)
+  {
+    c.lruHead->prev = item;
+  }
+  else
+  {
+    c.lruTail = item;
+  }
+  c.lruHead = item;
+}
+
+void CacheShard::grow()
+{
+  std::vector<Item*> buckets(buckets_.size() * 2);
+  for (size_t i = 0; i < buckets_.size(); ++i)
+  {
+    Item* item = buckets_[i];
+    while (item)
+    {
+      Item* next = item->hnext;
+      Item*& bucket = buckets[item->hash & (buckets.size() - 1)];
+      item->hnext = bucket;
+      bucket = item;
+      item = next;
+    }
+  }
+  buckets_.swap(buckets);
+}
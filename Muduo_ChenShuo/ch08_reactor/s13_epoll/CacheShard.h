@@ -0,0 +1,93 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_CACHESHARD_H
+#define MUDUO_NET_CACHESHARD_H
+
+#include "StringView.h"
+
+#include <muduo/base/noncopyable.h>
+
+#include <vector>
+
+#include <stdint.h>
+#include <time.h>
+
+namespace muduo
+{
+
+///
+/// Key-value items in slab allocated memory, with LRU eviction.
+///
+/// Memory is taken in 1 MiB pages up to the limit, and each page is cut
+/// into chunks of one size class.  An item goes into the smallest class
+/// that fits it.  When the limit is reached, an item evicts the least
+/// recently used item of its class, as memcached does.
+/// Not thread safe, MemcacheServer gives each IO loop its own shard.
+///
+class CacheShard : muduo::noncopyable
+{
+ public:
+  static const size_t kPageSize = 1024*1024;
+  static const size_t kMaxKeyLen = 250;
+
+  enum SetResult { kStored, kTooLarge, kOutOfMemory };
+
+  /// An item found by get(), valid until the next call on the shard.
+  struct Value
+  {
+    StringView key;
+    uint32_t flags;
+    StringView data;
+  };
+
+  explicit CacheShard(size_t memoryLimit);
+  ~CacheShard();
+
+  /// @param hash of the key by hashKey()
+  /// @param now for expiration, in seconds since epoch
+  bool get(const StringView& key, uint64_t hash, time_t now, Value* value);
+
+  /// @param exptime in seconds since epoch, 0 never expires
+  SetResult set(const StringView& key, uint64_t hash, uint32_t flags,
+                time_t exptime, const StringView& data);
+
+  bool remove(const StringView& key, uint64_t hash);
+
+  size_t numItems() const { return numItems_; }
+  size_t memoryUsed() const { return numPages_ * kPageSize; }
+  int64_t evictions() const { return evictions_; }
+
+  static uint64_t hashKey(const StringView& key);
+
+ private:
+  struct Item;
+  struct SlabClass;
+
+  Item* find(const StringView& key, uint64_t hash);
+  Item* allocate(size_t size);
+  void release(Item* item);
+  void link(Item* item);
+  void unlink(Item* item);
+  void lruRemove(Item* item);
+  void lruPushFront(Item* item);
+  void grow();
+
+  const size_t memoryLimit_;
+  std::vector<SlabClass> classes_;
+  std::vector<void*> pages_;
+  size_t numPages_;
+  std::vector<Item*> buckets_;  // chained by Item::hnext
+  size_t numItems_;
+  int64_t evictions_;
+};
+
+}
+
+#endif  // MUDUO_NET_CACHESHARD_H
@@ -19,7 +19,9 @@ namespace muduo
 // All client visible callbacks go here.
 
 class Buffer;
+class InetAddress;
 class TcpConnection;
+class UdpChannel;
 typedef boost::shared_ptr<TcpConnection> TcpConnectionPtr;
 
 typedef boost::function<void()> TimerCallback;
@@ -29,6 +31,14 @@ typedef boost::function<void (const TcpConnectionPtr&,
                               Timestamp)> MessageCallback;
 typedef boost::function<void (const TcpConnectionPtr&)> WriteCompleteCallback;
 typedef boost::function<void (const TcpConnectionPtr&)> CloseCallback;
+typedef boost::function<void (const TcpConnectionPtr&,
+                              size_t len)> SendRefusedCallback;
+typedef boost::function<void (bool exceeded)> BufferBudgetCallback;
+typedef boost::function<void (UdpChannel*,
+                              const char* data,
+                              size_t len,
+                              const InetAddress& peerAddr,
+                              Timestamp)> UdpMessageCallback;
 
 }
 
@@ -8,30 +8,47 @@
 #ifndef MUDUO_NET_CHANNEL_H
 #define MUDUO_NET_CHANNEL_H
 
+#include "EventLoopFwd.h"
+
 #include <boost/function.hpp>
 #include <muduo/base/noncopyable.h>
 
+#include <muduo/base/Logging.h>
 #include <muduo/base/Timestamp.h>
 
+#include <assert.h>
+#include <poll.h>
+
 namespace muduo
 {
 
-class EventLoop;
-
 ///
-/// A selectable I/O channel.
+/// A selectable I/O channel of a @c Loop, a BasicEventLoop.
 ///
 /// This class doesn't own the file descriptor.
 /// The file descriptor could be a socket,
 /// an eventfd, a timerfd, or a signalfd
-class Channel : muduo::noncopyable
+template <typename Loop>
+class BasicChannel : muduo::noncopyable
 {
  public:
   typedef boost::function<void()> EventCallback;
   typedef boost::function<void(Timestamp)> ReadEventCallback;
 
-  Channel(EventLoop* loop, int fd);
-  ~Channel();
+  BasicChannel(Loop* loop, int fd)
+    : loop_(loop),
+      fd_(fd),
+      events_(0),
+      revents_(0),
+      index_(-1),
+      eventHandling_(false)
+  {
+  }
+
+  ~BasicChannel()
+  {
+    assert(!eventHandling_);
+  }
 
   void handleEvent(Timestamp receiveTime);
   void setReadCallback(const ReadEventCallback& cb)
@@ -49,25 +66,37 @@ class Channel : muduo::noncopyable
   bool isNoneEvent() const { return events_ == kNoneEvent; }
 
   void enableReading() { events_ |= kReadEvent; update(); }
+  void disableReading() { events_ &= ~kReadEvent; update(); }
   void enableWriting() { events_ |= kWriteEvent; update(); }
   void disableWriting() { events_ &= ~kWriteEvent; update(); }
   void disableAll() { events_ = kNoneEvent; update(); }
   bool isWriting() const { return events_ & kWriteEvent; }
+  bool isReading() const { return events_ & kReadEvent; }
 
   // for Poller
   int index() { return index_; }
   void set_index(int idx) { index_ = idx; }
 
-  EventLoop* ownerLoop() { return loop_; }
+  Loop* ownerLoop() { return loop_; }
+  /// Hands the channel to another loop, it must have been removed
+  /// from the poller of its loop.
+  void setOwnerLoop(Loop* loop)
+  {
+    assert(isNoneEvent() && index_ == -1);
+    loop_ = loop;
+  }
 
  private:
-  void update();
+  void update() { loop_->updateChannel(this); }
 
-  static const int kNoneEvent;
-  static const int kReadEvent;
-  static const int kWriteEvent;
+  enum
+  {
+    kNoneEvent = 0,
+    kReadEvent = POLLIN | POLLPRI,
+    kWriteEvent = POLLOUT,
+  };
 
-  EventLoop* loop_;
+  Loop* loop_;
   const int  fd_;
   int        events_;
   int        revents_;
@@ -81,5 +110,29 @@ class Channel : muduo::noncopyable
   EventCallback closeCallback_;
 };
 
+template <typename Loop>
+void BasicChannel<Loop>::handleEvent(Timestamp receiveTime)
+{
+  eventHandling_ = true;
+  if (revents_ & POLLNVAL) {
+    LOG_WARN << "Channel::handle_event() POLLNVAL";
+  }
+
+  if ((revents_ & POLLHUP) && !(revents_ & POLLIN)) {
+    LOG_WARN << "Channel::handle_event() POLLHUP";
+    if (closeCallback_) closeCallback_();
+  }
+  if (revents_ & (POLLERR | POLLNVAL)) {
+    if (errorCallback_) errorCallback_();
+  }
+  if (revents_ & (POLLIN | POLLPRI | POLLRDHUP)) {
+    if (readCallback_) readCallback_(receiveTime);
+  }
+  if (revents_ & POLLOUT) {
+    if (writeCallback_) writeCallback_();
+  }
+  eventHandling_ = false;
+}
+
 }
 #endif  // MUDUO_NET_CHANNEL_H
@@ -0,0 +1,75 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_CHANNELTABLE_H
+#define MUDUO_NET_CHANNELTABLE_H
+
+#include <muduo/base/noncopyable.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+
+namespace muduo
+{
+
+///
+/// Channels indexed by fd, for Poller and EPoller.
+///
+/// fds are small dense integers, so a vector that grows on demand
+/// beats a std::map: no node allocation, no rebalancing.
+/// This class doesn't own the Channel objects.
+template <typename ChannelT>
+class ChannelTable : muduo::noncopyable
+{
+ public:
+  ChannelTable()
+    : size_(0)
+  { }
+
+  /// Returns the channel of @c fd, or NULL.
+  ChannelT* find(int fd) const
+  {
+    assert(fd >= 0);
+    size_t idx = static_cast<size_t>(fd);
+    return idx < channels_.size() ? channels_[idx] : NULL;
+  }
+
+  void insert(ChannelT* channel)
+  {
+    size_t idx = static_cast<size_t>(channel->fd());
+    if (idx >= channels_.size())
+    {
+      channels_.resize(std::max(idx + 1, channels_.size() * 2));
+    }
+    assert(channels_[idx] == NULL);
+    channels_[idx] = channel;
+    ++size_;
+  }
+
+  void erase(ChannelT* channel)
+  {
+    size_t idx = static_cast<size_t>(channel->fd());
+    assert(idx < channels_.size());
+    assert(channels_[idx] == channel);
+    channels_[idx] = NULL;
+    --size_;
+  }
+
+  /// Number of channels in the table.
+  size_t size() const { return size_; }
+
+ private:
+  std::vector<ChannelT*> channels_;
+  size_t size_;
+};
+
+}
+#endif  // MUDUO_NET_CHANNELTABLE_H
@@ -15,27 +15,87 @@
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 #include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 using namespace muduo;
 
+namespace
+{
+
+template <typename T>
+void deleteLater(T* p)
+{
+  delete p;
+}
+
+// the first sample sets it
+int64_t smooth(int64_t connectUs, int64_t sampleUs)
+{
+  return connectUs == 0 ? sampleUs : (connectUs * 3 + sampleUs) / 4;
+}
+
+}
+
 const int Connector::kMaxRetryDelayMs;
 
+struct Connector::Attempt
+{
+  Attempt(EventLoop* loop, int sockfd, size_t e, Timestamp now)
+    : channel(loop, sockfd),
+      endpoint(e),
+      startTime(now)
+  { }
+
+  Channel channel;
+  size_t endpoint;
+  Timestamp startTime;
+};
+
 Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
   : loop_(loop),
-    serverAddr_(serverAddr),
+    endpoints_(1, Endpoint(serverAddr)),
+    lastEndpoint_(0),
     connect_(false),
     state_(kDisconnected),
-    retryDelayMs_(kInitRetryDelayMs)
+    attemptDelayMs_(kAttemptDelayMs),
+    maxRetries_(0),
+    failures_(0),
+    retryJitter_(false),
+    seed_(static_cast<unsigned int>(
+        reinterpret_cast<uintptr_t>(this) ^
+        Timestamp::now().microSecondsSinceEpoch()))
 {
   LOG_DEBUG << "ctor[" << this << "]";
 }
 
+Connector::Connector(EventLoop* loop,
+                     const std::vector<InetAddress>& serverAddrs)
+  : loop_(loop),
+    endpoints_(serverAddrs.begin(), serverAddrs.end()),
+    lastEndpoint_(0),
+    connect_(false),
+    state_(kDisconnected),
+    attemptDelayMs_(kAttemptDelayMs),
+    maxRetries_(0),
+    failures_(0),
+    retryJitter_(false),
+    seed_(static_cast<unsigned int>(
+        reinterpret_cast<uintptr_t>(this) ^
+        Timestamp::now().microSecondsSinceEpoch()))
+{
+  assert(!endpoints_.empty());
+  LOG_DEBUG << "ctor[" << this << "] " << endpoints_.size() << " endpoints";
+}
+
 Connector::~Connector()
 {
   LOG_DEBUG << "dtor[" << this << "]";
   loop_->cancel(timerId_);
-  assert(!channel_);
+  assert(attempts_.empty());
 }
 
 void Connector::start()
@@ -50,6 +110,12 @@ void Connector::startInLoop()
   assert(state_ == kDisconnected);
   if (connect_)
   {
+    failures_ = 0;
+    // errors that retrying won't fix may have been fixed since
+    for (size_t i = 0; i < endpoints_.size(); ++i)
+    {
+      endpoints_[i].failed = false;
+    }
     connect();
   }
   else
@@ -58,10 +124,39 @@ void Connector::startInLoop()
   }
 }
 
+// starts attempts until one is in flight, then waits for it, for the
+// attempt delay, or for an endpoint to come out of its backoff.
 void Connector::connect()
 {
-  int sockfd = sockets::createNonblockingOrDie();
-  int ret = sockets::connect(sockfd, serverAddr_.getSockAddrInet());
+  assert(state_ != kConnected);
+  Timestamp now(Timestamp::now());
+  if (connect_ && maxRetries_ > 0 && failures_ >= maxRetries_)
+  {
+    // no new attempts, those in flight may still connect
+    if (attempts_.empty())
+    {
+      giveUp();
+      return;
+    }
+  }
+  else if (connect_)
+  {
+    int endpoint = nextEndpoint(now);
+    while (endpoint >= 0 && !startAttempt(endpoint, now))
+    {
+      endpoint = nextEndpoint(now);
+    }
+  }
+  scheduleNext(now);
+}
+
+bool Connector::startAttempt(size_t endpoint, Timestamp now)
+{
+  const InetAddress& serverAddr = endpoints_[endpoint].addr;
+  int sockfd = sockets::createNonblockingOrDie(serverAddr.family());
+  struct sockaddr_storage addr;
+  socklen_t len = serverAddr.toSockAddr(&addr);
+  int ret = sockets::connect(sockfd, addr, len);
   int savedErrno = (ret == 0) ? 0 : errno;
   switch (savedErrno)
   {
@@ -69,15 +164,25 @@ void Connector::connect()
     case EINPROGRESS:
     case EINTR:
     case EISCONN:
-      connecting(sockfd);
-      break;
+      {
+        Attempt* attempt = new Attempt(loop_, sockfd, endpoint, now);
+        attempts_.push_back(attempt);
+        endpoints_[endpoint].attempting = true;
+        attempt->channel.setWriteCallback(
+            boost::bind(&Connector::handleWrite, this, attempt)); // FIXME: unsafe
+        attempt->channel.setErrorCallback(
+            boost::bind(&Connector::handleError, this, attempt)); // FIXME: unsafe
+        attempt->channel.enableWriting();
+        return true;
+      }
 
     case EAGAIN:
     case EADDRINUSE:
     case EADDRNOTAVAIL:
     case ECONNREFUSED:
     case ENETUNREACH:
-      retry(sockfd);
+    case ENOENT:  // Unix socket not created yet
+      retry(sockfd, endpoint, now);
       break;
 
     case EACCES:
@@ -87,23 +192,89 @@ void Connector::connect()
     case EBADF:
     case EFAULT:
     case ENOTSOCK:
-      LOG_SYSERR << "connect error in Connector::startInLoop " << savedErrno;
+      LOG_SYSERR << "connect error in Connector::startAttempt " << savedErrno;
       sockets::close(sockfd);
+      endpoints_[endpoint].failed = true;
       break;
 
     default:
-      LOG_SYSERR << "Unexpected error in Connector::startInLoop " << savedErrno;
+      LOG_SYSERR << "Unexpected error in Connector::startAttempt " << savedErrno;
       sockets::close(sockfd);
+      endpoints_[endpoint].failed = true;
       // connectErrorCallback_();
       break;
   }
+  return false;
+}
+
+// the healthiest endpoint that can be tried now, -1 if none
+int Connector::nextEndpoint(Timestamp now) const
+{
+  int best = -1;
+  for (size_t i = 0; i < endpoints_.size(); ++i)
+  {
+    const Endpoint& e = endpoints_[i];
+    if (!e.failed && !e.attempting && !(now < e.readyTime)
+        && (best < 0 || e.rank() < endpoints_[best].rank()))
+    {
+      best = static_cast<int>(i);
+    }
+  }
+  return best;
+}
+
+void Connector::scheduleNext(Timestamp now)
+{
+  loop_->cancel(timerId_);
+  setState(attempts_.empty() ? kDisconnected : kConnecting);
+  if (!connect_)
+  {
+    LOG_DEBUG << "do not connect";
+    return;
+  }
+
+  // the first endpoint out of its backoff
+  const Endpoint* next = NULL;
+  for (size_t i = 0; i < endpoints_.size(); ++i)
+  {
+    const Endpoint& e = endpoints_[i];
+    if (!e.failed && !e.attempting
+        && (next == NULL || e.readyTime < next->readyTime))
+    {
+      next = &e;
+    }
+  }
+  if (next == NULL)
+  {
+    if (attempts_.empty())
+    {
+      LOG_ERROR << "Connector::scheduleNext - no endpoint left to connect";
+      giveUp();
+    }
+    return;
+  }
+
+  Timestamp when(next->readyTime);
+  if (!attempts_.empty())
+  {
+    // gives the attempts in flight a head start
+    Timestamp staggered(addTime(now, attemptDelayMs_ / 1000.0));
+    if (when < staggered)
+    {
+      when = staggered;
+    }
+  }
+  double delay = std::max(timeDifference(when, now), 0.0);
+  timerId_ = loop_->runAfter(delay,  // FIXME: unsafe
+                             boost::bind(&Connector::connect, this));
 }
 
 void Connector::restart()
 {
   loop_->assertInLoopThread();
   setState(kDisconnected);
-  retryDelayMs_ = kInitRetryDelayMs;
+  // the endpoint that connected last has its backoff reset,
+  // the others keep theirs.  failed ones are tried again.
   connect_ = true;
   startInLoop();
 }
@@ -112,104 +283,151 @@ void Connector::stop()
 {
   connect_ = false;
   loop_->cancel(timerId_);
+  loop_->runInLoop(boost::bind(&Connector::stopInLoop, this)); // FIXME: unsafe
 }
 
-void Connector::connecting(int sockfd)
+void Connector::stopInLoop()
 {
-  setState(kConnecting);
-  assert(!channel_);
-  channel_.reset(new Channel(loop_, sockfd));
-  channel_->setWriteCallback(
-      boost::bind(&Connector::handleWrite, this)); // FIXME: unsafe
-  channel_->setErrorCallback(
-      boost::bind(&Connector::handleError, this)); // FIXME: unsafe
+  loop_->assertInLoopThread();
+  if (state_ == kConnecting)
+  {
+    setState(kDisconnected);
+    closeAttempts(Timestamp::now());
+  }
+}
 
-  // channel_->tie(shared_from_this()); is not working,
-  // as channel_ is not managed by shared_ptr
-  channel_->enableWriting();
+// returns its sockfd, or -1 if it's been closed in this poll round.
+int Connector::removeAttempt(Attempt* attempt)
+{
+  for (boost::ptr_vector<Attempt>::iterator it = attempts_.begin();
+      it != attempts_.end(); ++it)
+  {
+    if (&*it == attempt)
+    {
+      attempt->channel.disableAll();
+      loop_->removeChannel(&attempt->channel);
+      endpoints_[attempt->endpoint].attempting = false;
+      // Can't delete it here, we may be inside its Channel::handleEvent,
+      // or its event may come later in this poll round.
+      loop_->queueInLoop(
+          boost::bind(&deleteLater<Attempt>, attempts_.release(it).release()));
+      return attempt->channel.fd();
+    }
+  }
+  return -1;
 }
 
-int Connector::removeAndResetChannel()
+void Connector::closeAttempts(Timestamp now)
 {
-  channel_->disableAll();
-  loop_->removeChannel(get_pointer(channel_));
-  int sockfd = channel_->fd();
-  // Can't reset channel_ here, because we are inside Channel::handleEvent
-  loop_->queueInLoop(boost::bind(&Connector::resetChannel, this)); // FIXME: unsafe
-  return sockfd;
+  while (!attempts_.empty())
+  {
+    Attempt* attempt = &attempts_.back();
+    Endpoint& e = endpoints_[attempt->endpoint];
+    // it would have taken longer than this
+    int64_t us = static_cast<int64_t>(
+        timeDifference(now, attempt->startTime) * 1e6);
+    if (us > e.connectUs)
+    {
+      e.connectUs = smooth(e.connectUs, us);
+    }
+    sockets::close(removeAttempt(attempt));
+  }
 }
 
-void Connector::resetChannel()
+void Connector::giveUp()
 {
-  channel_.reset();
+  LOG_ERROR << "Connector::giveUp - " << failures_ << " failures in a row";
+  connect_ = false;
+  loop_->cancel(timerId_);
+  setState(kDisconnected);
+  if (connectFailedCallback_)
+  {
+    connectFailedCallback_();
+  }
 }
 
-void Connector::handleWrite()
+void Connector::handleWrite(Attempt* attempt)
 {
   LOG_TRACE << "Connector::handleWrite " << state_;
 
-  if (state_ == kConnecting)
+  int sockfd = removeAttempt(attempt);
+  if (sockfd < 0)
   {
-    int sockfd = removeAndResetChannel();
-    int err = sockets::getSocketError(sockfd);
-    if (err)
-    {
-      LOG_WARN << "Connector::handleWrite - SO_ERROR = "
-               << err << " " << strerror_tl(err);
-      retry(sockfd);
-    }
-    else if (sockets::isSelfConnect(sockfd))
+    // lost to another attempt of this poll round
+    return;
+  }
+  assert(state_ == kConnecting);
+  Timestamp now(Timestamp::now());
+  size_t endpoint = attempt->endpoint;
+  int err = sockets::getSocketError(sockfd);
+  if (err)
+  {
+    LOG_WARN << "Connector::handleWrite - SO_ERROR = "
+             << err << " " << strerror_tl(err);
+    retry(sockfd, endpoint, now);
+    connect();
+  }
+  else if (sockets::isSelfConnect(sockfd))
+  {
+    LOG_WARN << "Connector::handleWrite - Self connect";
+    retry(sockfd, endpoint, now);
+    connect();
+  }
+  else
+  {
+    Endpoint& e = endpoints_[endpoint];
+    e.connectUs = smooth(e.connectUs, static_cast<int64_t>(
+        timeDifference(now, attempt->startTime) * 1e6));
+    e.retryDelayMs = kInitRetryDelayMs;
+    e.penaltyUs = 0;
+    failures_ = 0;
+    lastEndpoint_ = endpoint;
+    closeAttempts(now);
+    loop_->cancel(timerId_);
+    setState(kConnected);
+    if (connect_)
     {
-      LOG_WARN << "Connector::handleWrite - Self connect";
-      retry(sockfd);
+      newConnectionCallback_(sockfd);
     }
     else
     {
-      setState(kConnected);
-      if (connect_)
-      {
-        newConnectionCallback_(sockfd);
-      }
-      else
-      {
-        sockets::close(sockfd);
-      }
+      sockets::close(sockfd);
     }
   }
-  else
-  {
-    // what happened?
-    assert(state_ == kDisconnected);
-  }
 }
 
-void Connector::handleError()
+void Connector::handleError(Attempt* attempt)
 {
   LOG_ERROR << "Connector::handleError";
-  assert(state_ == kConnecting);
 
-  int sockfd = removeAndResetChannel();
+  int sockfd = removeAttempt(attempt);
+  if (sockfd < 0)
+  {
+    return;
+  }
+  assert(state_ == kConnecting);
   int err = sockets::getSocketError(sockfd);
   LOG_TRACE << "SO_ERROR = " << err << " " << strerror_tl(err);
-  retry(sockfd);
+  retry(sockfd, attempt->endpoint, Timestamp::now());
+  connect();
 }
 
-void Connector::retry(int sockfd)
+void Connector::retry(int sockfd, size_t endpoint, Timestamp now)
 {
   sockets::close(sockfd);
-  setState(kDisconnected);
-  if (connect_)
+  Endpoint& e = endpoints_[endpoint];
+  int delayMs = e.retryDelayMs;
+  if (retryJitter_)
   {
-    LOG_INFO << "Connector::retry - Retry connecting to "
-             << serverAddr_.toHostPort() << " in "
-             << retryDelayMs_ << " milliseconds. ";
-    timerId_ = loop_->runAfter(retryDelayMs_/1000.0,  // FIXME: unsafe
-                               boost::bind(&Connector::startInLoop, this));
-    retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
-  }
-  else
-  {
-    LOG_DEBUG << "do not connect";
+    delayMs = delayMs / 2 + rand_r(&seed_) % (delayMs / 2 + 1);
   }
+  LOG_INFO << "Connector::retry - Retry connecting to "
+           << e.addr.toHostPort() << " in "
+           << delayMs << " milliseconds. ";
+  e.readyTime = addTime(now, delayMs / 1000.0);
+  ++failures_;
+  e.retryDelayMs = std::min(e.retryDelayMs * 2, kMaxRetryDelayMs);
+  // behind the endpoints that connect within an attempt delay, not
+  // more, so it's back in the race once it recovers
+  e.penaltyUs = attemptDelayMs_ * 1000;
 }
-
@@ -10,57 +10,132 @@
 
 #include "InetAddress.h"
 #include "TimerId.h"
+#include "EventLoopFwd.h"
+
+#include <muduo/base/Timestamp.h>
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/function.hpp>
 #include <muduo/base/noncopyable.h>
-#include <boost/scoped_ptr.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <vector>
 
 namespace muduo
 {
 
-class Channel;
-class EventLoop;
-
+///
+/// Connects to one of the replicas of a server.
+///
+/// Attempts start one after another, a delay apart, to the healthiest
+/// endpoint first, and race each other.  The first to connect wins,
+/// the others are closed.  An endpoint that fails backs off on its own,
+/// so a dead replica doesn't hold up the others.
 class Connector : muduo::noncopyable
 {
  public:
   typedef boost::function<void (int sockfd)> NewConnectionCallback;
+  typedef boost::function<void ()> ConnectFailedCallback;
 
   Connector(EventLoop* loop, const InetAddress& serverAddr);
-  ~Connector();
+  /// @c serverAddrs are replicas, tried in this order until their
+  /// connect times are known.
+  Connector(EventLoop* loop, const std::vector<InetAddress>& serverAddrs);
+  ~Connector();  // force out-line dtor, for Attempt.
 
   void setNewConnectionCallback(const NewConnectionCallback& cb)
   { newConnectionCallback_ = cb; }
 
+  /// Called in the loop thread when the connector gives up, see
+  /// setMaxRetries().  It must not destroy the connector.
+  void setConnectFailedCallback(const ConnectFailedCallback& cb)
+  { connectFailedCallback_ = cb; }
+
   void start();  // can be called in any thread
   void restart();  // must be called in loop thread
   void stop();  // can be called in any thread
 
-  const InetAddress& serverAddress() const { return serverAddr_; }
+  /// Waits a random delay in [delay/2, delay] before each retry,
+  /// so connectors that failed together don't retry together.
+  /// Off by default.  Must be called before start().
+  void setRetryJitter(bool on) { retryJitter_ = on; }
+
+  /// Starts the next attempt if the last one hasn't connected within
+  /// @c seconds, 0.25 by default.  Must be called before start().
+  void setAttemptDelay(double seconds)
+  { attemptDelayMs_ = static_cast<int>(seconds * 1000); }
+
+  /// Gives up after @c n failed attempts in a row, over all endpoints,
+  /// or when no endpoint is left.  0 retries forever, the default.
+  /// Must be called before start().
+  void setMaxRetries(int n) { maxRetries_ = n; }
+
+  /// Endpoint of the last connection, the first one before that.
+  const InetAddress& serverAddress() const
+  { return endpoints_[lastEndpoint_].addr; }
+
+  /// Smoothed connect time of endpoint @c i, plus one attempt delay
+  /// if it failed since it last connected, smaller is healthier.
+  /// 0 before it's been tried.  Must be called in the loop thread.
+  int64_t connectMicroseconds(size_t i) const
+  { return endpoints_[i].rank(); }
 
  private:
   enum States { kDisconnected, kConnecting, kConnected };
   static const int kMaxRetryDelayMs = 30*1000;
   static const int kInitRetryDelayMs = 500;
+  static const int kAttemptDelayMs = 250;
+
+  struct Endpoint
+  {
+    explicit Endpoint(const InetAddress& serverAddr)
+      : addr(serverAddr),
+        retryDelayMs(kInitRetryDelayMs),
+        connectUs(0),
+        penaltyUs(0),
+        attempting(false),
+        failed(false)
+    { }
+
+    int64_t rank() const { return connectUs + penaltyUs; }
+
+    InetAddress addr;
+    int retryDelayMs;  // backoff after the next failure
+    Timestamp readyTime;  // not tried again before it
+    int64_t connectUs;
+    int64_t penaltyUs;  // set by a failure, cleared by a connect
+    bool attempting;
+    bool failed;  // by an error that retrying won't fix
+  };
+  struct Attempt;
 
   void setState(States s) { state_ = s; }
   void startInLoop();
   void connect();
-  void connecting(int sockfd);
-  void handleWrite();
-  void handleError();
-  void retry(int sockfd);
-  int removeAndResetChannel();
-  void resetChannel();
+  bool startAttempt(size_t endpoint, Timestamp now);
+  void scheduleNext(Timestamp now);
+  int nextEndpoint(Timestamp now) const;
+  void handleWrite(Attempt* attempt);
+  void handleError(Attempt* attempt);
+  void retry(int sockfd, size_t endpoint, Timestamp now);
+  void stopInLoop();
+  int removeAttempt(Attempt* attempt);
+  void closeAttempts(Timestamp now);
+  void giveUp();
 
   EventLoop* loop_;
-  InetAddress serverAddr_;
+  std::vector<Endpoint> endpoints_;
+  size_t lastEndpoint_;
   bool connect_; // atomic
   States state_;  // FIXME: use atomic variable
-  boost::scoped_ptr<Channel> channel_;
+  boost::ptr_vector<Attempt> attempts_;  // in flight
   NewConnectionCallback newConnectionCallback_;
-  int retryDelayMs_;
+  ConnectFailedCallback connectFailedCallback_;
+  int attemptDelayMs_;
+  int maxRetries_;
+  int failures_;  // in a row
+  bool retryJitter_;
+  unsigned int seed_;  // for rand_r()
   TimerId timerId_;
 };
 typedef boost::shared_ptr<Connector> ConnectorPtr;
@@ -0,0 +1,375 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "Coroutine.h"
+
+#include <muduo/base/Logging.h>
+#include "EventLoop.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using namespace muduo;
+using namespace muduo::detail;
+
+namespace
+{
+
+const size_t kFrameAlign = 64;
+const size_t kMaxPooledFrame = 4096;
+
+struct FreeFrame
+{
+  FreeFrame* next;
+};
+
+// one free list per multiple of kFrameAlign
+struct FrameLists
+{
+  FrameLists()
+    : heads(kMaxPooledFrame / kFrameAlign + 1, static_cast<FreeFrame*>(NULL))
+  { }
+
+  ~FrameLists()
+  {
+    for (size_t i = 0; i < heads.size(); ++i)
+    {
+      while (heads[i])
+      {
+        FreeFrame* frame = heads[i];
+        heads[i] = frame->next;
+        ::operator delete(frame);
+      }
+    }
+  }
+
+  std::vector<FreeFrame*> heads;
+};
+
+thread_local FrameLists t_frames;
+
+// resumes a coroutine, for use as a boost::function
+struct Resume
+{
+  std::coroutine_handle<> handle;
+  void operator()() const { handle.resume(); }
+};
+
+}
+
+void* FramePool::allocate(size_t size)
+{
+  size_t idx = (size + kFrameAlign - 1) / kFrameAlign;
+  if (size > kMaxPooledFrame)
+  {
+    return ::operator new(size);
+  }
+  FreeFrame*& head = t_frames.heads[idx];
+  if (head)
+  {
+    FreeFrame* frame = head;
+    head = frame->next;
+    return frame;
+  }
+  return ::operator new(idx * kFrameAlign);
+}
+
+void FramePool::deallocate(void* p, size_t size)
+{
+  if (size > kMaxPooledFrame)
+  {
+    ::operator delete(p);
+    return;
+  }
+  size_t idx = (size + kFrameAlign - 1) / kFrameAlign;
+  FreeFrame* frame = static_cast<FreeFrame*>(p);
+  frame->next = t_frames.heads[idx];
+  t_frames.heads[idx] = frame;
+}
+
+void Task::promise_type::unhandled_exception()
+{
+  LOG_FATAL << "Task::unhandled_exception";
+}
+
+struct CoConnection::State
+{
+  enum ReadOp { kNone, kUntil, kExactly };
+
+  explicit State(const TcpConnectionPtr& c)
+    : conn(c),
+      inputBuffer(NULL),
+      closed(!c->connected()),
+      readOp(kNone),
+      length(0),
+      writing(false),
+      writeCallbackSet(false)
+  { }
+
+  // fills result and returns true if the pending read is done
+  bool tryRead()
+  {
+    if (closed)
+    {
+      result.clear();
+      return true;
+    }
+    if (inputBuffer == NULL)
+    {
+      return false;
+    }
+    const char* begin = inputBuffer->peek();
+    const char* end = begin + inputBuffer->readableBytes();
+    if (readOp == kUntil)
+    {
+      const char* found = std::search(begin, end, delim.begin(), delim.end());
+      if (found == end)
+      {
+        return false;
+      }
+      result.assign(begin, found);
+      inputBuffer->retrieveUntil(found + delim.size());
+      return true;
+    }
+    else
+    {
+      assert(readOp == kExactly);
+      if (inputBuffer->readableBytes() < length)
+      {
+        return false;
+      }
+      result.assign(begin, length);
+      inputBuffer->retrieve(length);
+      return true;
+    }
+  }
+
+  void onConnection(const TcpConnectionPtr& c)
+  {
+    if (!c->connected())
+    {
+      closed = true;
+      resumeReader();
+      resumeWriter();
+      // breaks the cycle of conn -> callbacks -> state -> conn
+      conn.reset();
+    }
+  }
+
+  // queued by CoConnection(), after the poll that may have closed c
+  static void watchClose(const StatePtr& state, const TcpConnectionPtr& c)
+  {
+    if (c->disconnected())
+    {
+      // the old callback saw the close, nothing would call ours
+      state->onConnection(c);
+    }
+    else
+    {
+      c->setConnectionCallback(boost::bind(&State::onConnection, state, _1));
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+  {
+    inputBuffer = buf;
+    if (reader && tryRead())
+    {
+      resumeReader();
+    }
+  }
+
+  void onWriteComplete(const TcpConnectionPtr& c)
+  {
+    // may be queued by an earlier write, wait for the next one
+    if (c->pendingOutputBytes() > 0)
+    {
+      return;
+    }
+    writing = false;
+    resumeWriter();
+  }
+
+  void resumeReader()
+  {
+    if (reader)
+    {
+      std::coroutine_handle<> h = reader;
+      reader = NULL;
+      h.resume();
+    }
+  }
+
+  void resumeWriter()
+  {
+    if (writer)
+    {
+      std::coroutine_handle<> h = writer;
+      writer = NULL;
+      h.resume();
+    }
+  }
+
+  TcpConnectionPtr conn;
+  Buffer* inputBuffer;  // input buffer of conn, known after first message
+  bool closed;
+  ReadOp readOp;
+  std::string delim;
+  size_t length;
+  std::string result;
+  bool writing;
+  bool writeCallbackSet;
+  std::coroutine_handle<> reader;
+  std::coroutine_handle<> writer;
+};
+
+CoConnection::CoConnection(const TcpConnectionPtr& conn)
+  : state_(new State(conn))
+{
+  conn->getLoop()->assertInLoopThread();
+  conn->setMessageCallback(
+      boost::bind(&State::onMessage, state_, _1, _2, _3));
+  // we are likely inside the connection callback, don't replace it
+  // while it's running.  With IO threads, we may be in a functor queued
+  // by TcpServer, then a poll runs first and may close the connection.
+  conn->getLoop()->queueInLoop(
+      boost::bind(&State::watchClose, state_, conn));
+}
+
+CoConnection::ReadAwaiter CoConnection::readUntil(const std::string& delim)
+{
+  assert(state_->readOp == State::kNone);
+  state_->readOp = State::kUntil;
+  state_->delim = delim;
+  ReadAwaiter a = { state_ };
+  return a;
+}
+
+CoConnection::ReadAwaiter CoConnection::readExactly(size_t n)
+{
+  assert(state_->readOp == State::kNone);
+  state_->readOp = State::kExactly;
+  state_->length = n;
+  ReadAwaiter a = { state_ };
+  return a;
+}
+
+bool CoConnection::ReadAwaiter::await_ready()
+{
+  return state->tryRead();
+}
+
+void CoConnection::ReadAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+  assert(!state->reader);
+  state->reader = h;
+}
+
+std::string CoConnection::ReadAwaiter::await_resume()
+{
+  state->readOp = State::kNone;
+  std::string result;
+  result.swap(state->result);
+  return result;
+}
+
+CoConnection::WriteAwaiter CoConnection::write(const std::string& data)
+{
+  if (!state_->closed)
+  {
+    const TcpConnectionPtr& conn = state_->conn;
+    conn->send(data);
+    // installed when send() first leaves bytes behind,
+    // writes until then queue no write complete functor.
+    if (conn->pendingOutputBytes() > 0)
+    {
+      if (!state_->writeCallbackSet)
+      {
+        state_->writeCallbackSet = true;
+        conn->setWriteCompleteCallback(
+            boost::bind(&State::onWriteComplete, state_, _1));
+      }
+      state_->writing = true;
+    }
+  }
+  WriteAwaiter a = { state_ };
+  return a;
+}
+
+bool CoConnection::WriteAwaiter::await_ready()
+{
+  return state->closed || !state->writing;
+}
+
+void CoConnection::WriteAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+  assert(!state->writer);
+  state->writer = h;
+}
+
+bool CoConnection::WriteAwaiter::await_resume()
+{
+  return !state->closed;
+}
+
+void CoConnection::shutdown()
+{
+  if (!state_->closed)
+  {
+    state_->conn->shutdown();
+  }
+}
+
+bool CoConnection::connected() const
+{
+  return !state_->closed && state_->conn->connected();
+}
+
+const TcpConnectionPtr& CoConnection::connection() const
+{
+  return state_->conn;
+}
+
+CoClient::CoClient(EventLoop* loop, const InetAddress& serverAddr)
+  : client_(loop, serverAddr)
+{
+  client_.setConnectionCallback(
+      boost::bind(&CoClient::onConnection, this, _1));
+}
+
+void CoClient::ConnectAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+  assert(!client->connecting_);
+  client->connecting_ = h;
+  client->client_.connect();
+}
+
+CoConnection CoClient::ConnectAwaiter::await_resume()
+{
+  TcpConnectionPtr conn;
+  conn.swap(client->connection_);
+  return CoConnection(conn);
+}
+
+void CoClient::onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected() && connecting_)
+  {
+    connection_ = conn;
+    std::coroutine_handle<> h = connecting_;
+    connecting_ = NULL;
+    h.resume();
+  }
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+  Resume resume = { h };
+  loop->runAfter(seconds, resume);
+}
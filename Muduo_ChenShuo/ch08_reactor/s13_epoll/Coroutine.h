@@ -0,0 +1,165 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_COROUTINE_H
+#define MUDUO_NET_COROUTINE_H
+
+#if __cplusplus < 202002L
+#error "Coroutine.h requires -std=c++20"
+#endif
+
+#include "Callbacks.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoopFwd.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <coroutine>
+#include <string>
+
+namespace muduo
+{
+
+namespace detail
+{
+
+///
+/// Free lists of coroutine frames, one per loop thread.
+///
+/// Frames are created and resumed in the loop thread only,
+/// so the pool needs no lock.
+class FramePool : muduo::noncopyable
+{
+ public:
+  static void* allocate(size_t size);
+  static void deallocate(void* p, size_t size);
+};
+
+}
+
+///
+/// Fire-and-forget coroutine, runs on the loop that resumes it.
+///
+/// Starts at once, its frame is freed when it returns.
+struct Task
+{
+  struct promise_type
+  {
+    Task get_return_object() { return Task(); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() { }
+    void unhandled_exception();
+
+    static void* operator new(size_t size)
+    { return detail::FramePool::allocate(size); }
+    static void operator delete(void* p, size_t size)
+    { detail::FramePool::deallocate(p, size); }
+  };
+};
+
+///
+/// Awaitable view of a TcpConnection.
+///
+/// Takes over the connection, message and write complete callbacks of
+/// the connection.  Every operation resumes the coroutine in the loop
+/// thread of the connection, directly from the callback.
+/// Reads return an empty string once the connection is down.
+/// Copyable, copies share one connection.
+class CoConnection
+{
+ public:
+  /// Must be called in the loop thread of @c conn.
+  explicit CoConnection(const TcpConnectionPtr& conn);
+
+  struct State;
+  typedef boost::shared_ptr<State> StatePtr;
+
+  struct ReadAwaiter
+  {
+    StatePtr state;
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> h);
+    std::string await_resume();
+  };
+
+  struct WriteAwaiter
+  {
+    StatePtr state;
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> h);
+    bool await_resume();
+  };
+
+  /// Reads until @c delim, which is consumed but not returned.
+  ReadAwaiter readUntil(const std::string& delim);
+  /// Reads exactly @c n bytes.
+  ReadAwaiter readExactly(size_t n);
+  /// Sends @c data, resumes when the output buffer is drained.
+  /// Returns false if the connection is down.
+  WriteAwaiter write(const std::string& data);
+
+  void shutdown();
+  bool connected() const;
+  const TcpConnectionPtr& connection() const;
+
+ private:
+  StatePtr state_;
+};
+
+///
+/// Awaitable TcpClient.
+///
+class CoClient : muduo::noncopyable
+{
+ public:
+  CoClient(EventLoop* loop, const InetAddress& serverAddr);
+
+  struct ConnectAwaiter
+  {
+    CoClient* client;
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> h);
+    CoConnection await_resume();
+  };
+
+  /// Connects, resumes in the loop thread once connected.
+  /// Must be called in the loop thread.
+  ConnectAwaiter connect() { ConnectAwaiter a = { this }; return a; }
+
+  TcpClient& client() { return client_; }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn);
+
+  TcpClient client_;
+  TcpConnectionPtr connection_;
+  std::coroutine_handle<> connecting_;
+};
+
+struct SleepAwaiter
+{
+  EventLoop* loop;
+  double seconds;
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> h);
+  void await_resume() { }
+};
+
+/// co_await sleepFor(loop, d) resumes on @c loop after @c d seconds.
+inline SleepAwaiter sleepFor(EventLoop* loop, double seconds)
+{
+  SleepAwaiter a = { loop, seconds };
+  return a;
+}
+
+}
+
+#endif  // MUDUO_NET_COROUTINE_H
@@ -8,30 +8,49 @@
 #ifndef MUDUO_NET_EPOLLER_H
 #define MUDUO_NET_EPOLLER_H
 
-#include <map>
 #include <vector>
 
+#include <muduo/base/Logging.h>
 #include <muduo/base/Timestamp.h>
-#include "EventLoop.h"
+#include "Channel.h"
+#include "ChannelTable.h"
 
-struct epoll_event;
+#include <boost/static_assert.hpp>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
 
 namespace muduo
 {
 
-class Channel;
+// On Linux, the constants of poll(2) and epoll(4)
+// are expected to be the same.
+BOOST_STATIC_ASSERT(EPOLLIN == POLLIN);
+BOOST_STATIC_ASSERT(EPOLLPRI == POLLPRI);
+BOOST_STATIC_ASSERT(EPOLLOUT == POLLOUT);
+BOOST_STATIC_ASSERT(EPOLLRDHUP == POLLRDHUP);
+BOOST_STATIC_ASSERT(EPOLLERR == POLLERR);
+BOOST_STATIC_ASSERT(EPOLLHUP == POLLHUP);
 
 ///
-/// IO Multiplexing with epoll(4).
+/// IO Multiplexing with epoll(4), the poller policy of BasicEventLoop.
 ///
 /// This class doesn't own the Channel objects.
-class EPoller : muduo::noncopyable
+template <typename Loop>
+class BasicEPoller : muduo::noncopyable
 {
  public:
-  typedef std::vector<Channel*> ChannelList;
+  typedef BasicChannel<Loop> ChannelT;
+  typedef std::vector<ChannelT*> ChannelList;
 
-  EPoller(EventLoop* loop);
-  ~EPoller();
+  BasicEPoller(Loop* loop);
+  ~BasicEPoller();
 
   /// Polls the I/O events.
   /// Must be called in the loop thread.
@@ -39,28 +58,218 @@ class EPoller : muduo::noncopyable
 
   /// Changes the interested I/O events.
   /// Must be called in the loop thread.
-  void updateChannel(Channel* channel);
+  void updateChannel(ChannelT* channel);
   /// Remove the channel, when it destructs.
   /// Must be called in the loop thread.
-  void removeChannel(Channel* channel);
+  void removeChannel(ChannelT* channel);
+
+  /// Number of epoll_ctl(2) calls issued so far.
+  int64_t numCtlCalls() const { return numCtlCalls_; }
 
   void assertInLoopThread() { ownerLoop_->assertInLoopThread(); }
 
  private:
   static const int kInitEventListSize = 16;
+  // Channel::index() is the events registered in epoll for an added
+  // channel, or one of these for a channel not in epoll.
+  enum { kNew = -1, kDeleted = 0 };
 
   void fillActiveChannels(int numEvents,
                           ChannelList* activeChannels) const;
-  void update(int operation, Channel* channel);
+  void applyChanges();
+  void update(int operation, ChannelT* channel);
 
   typedef std::vector<struct epoll_event> EventList;
-  typedef std::map<int, Channel*> ChannelMap;
 
-  EventLoop* ownerLoop_;
+  Loop* ownerLoop_;
   int epollfd_;
   EventList events_;
-  ChannelMap channels_;
+  ChannelTable<ChannelT> channels_;
+  // channels whose interest changed since last poll(), may be NULL
+  ChannelList changes_;
+  int64_t numCtlCalls_;
 };
 
+///
+/// Spins on epoll_wait(2) without sleeping, the poller policy of a
+/// loop that owns a core and wants the lowest latency.
+///
+template <typename Loop>
+class BasicBusyEPoller : public BasicEPoller<Loop>
+{
+ public:
+  typedef typename BasicEPoller<Loop>::ChannelList ChannelList;
+
+  BasicBusyEPoller(Loop* loop)
+    : BasicEPoller<Loop>(loop)
+  {
+  }
+
+  /// Never blocks, @c timeoutMs is ignored.
+  Timestamp poll(int, ChannelList* activeChannels)
+  {
+    return BasicEPoller<Loop>::poll(0, activeChannels);
+  }
+};
+
+typedef BasicEPoller<EventLoop> EPoller;
+
+template <typename Loop>
+BasicEPoller<Loop>::BasicEPoller(Loop* loop)
+  : ownerLoop_(loop),
+    epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
+    events_(kInitEventListSize),
+    numCtlCalls_(0)
+{
+  if (epollfd_ < 0)
+  {
+    LOG_SYSFATAL << "EPoller::EPoller";
+  }
+}
+
+template <typename Loop>
+BasicEPoller<Loop>::~BasicEPoller()
+{
+  ::close(epollfd_);
+}
+
+template <typename Loop>
+Timestamp BasicEPoller<Loop>::poll(int timeoutMs, ChannelList* activeChannels)
+{
+  applyChanges();
+  int numEvents = ::epoll_wait(epollfd_,
+                               &*events_.begin(),
+                               static_cast<int>(events_.size()),
+                               timeoutMs);
+  Timestamp now(Timestamp::now());
+  if (numEvents > 0)
+  {
+    LOG_TRACE << numEvents << " events happended";
+    fillActiveChannels(numEvents, activeChannels);
+    if (implicit_cast<size_t>(numEvents) == events_.size())
+    {
+      events_.resize(events_.size()*2);
+    }
+  }
+  else if (numEvents == 0)
+  {
+    LOG_TRACE << " nothing happended";
+  }
+  else
+  {
+    LOG_SYSERR << "EPoller::poll()";
+  }
+  return now;
+}
+
+template <typename Loop>
+void BasicEPoller<Loop>::fillActiveChannels(int numEvents,
+                                            ChannelList* activeChannels) const
+{
+  assert(implicit_cast<size_t>(numEvents) <= events_.size());
+  for (int i = 0; i < numEvents; ++i)
+  {
+    ChannelT* channel = static_cast<ChannelT*>(events_[i].data.ptr);
+    assert(channels_.find(channel->fd()) == channel);
+    channel->set_revents(events_[i].events);
+    activeChannels->push_back(channel);
+  }
+}
+
+template <typename Loop>
+void BasicEPoller<Loop>::updateChannel(ChannelT* channel)
+{
+  assertInLoopThread();
+  LOG_TRACE << "fd = " << channel->fd() << " events = " << channel->events();
+  if (channel->index() == kNew)
+  {
+    channels_.insert(channel);
+    channel->set_index(kDeleted);
+  }
+  // epoll_ctl is deferred to the next poll(), so that enable-then-disable
+  // in one iteration costs nothing.
+  if (changes_.empty() || changes_.back() != channel)
+  {
+    changes_.push_back(channel);
+  }
+}
+
+template <typename Loop>
+void BasicEPoller<Loop>::removeChannel(ChannelT* channel)
+{
+  assertInLoopThread();
+  LOG_TRACE << "fd = " << channel->fd();
+  assert(channel->isNoneEvent());
+  int index = channel->index();
+  assert(index != kNew);
+  channels_.erase(channel);
+
+  // the channel is going away, drop its pending changes
+  std::replace(changes_.begin(), changes_.end(),
+               channel, static_cast<ChannelT*>(NULL));
+  if (index != kDeleted)
+  {
+    update(EPOLL_CTL_DEL, channel);
+  }
+  channel->set_index(kNew);
+}
+
+template <typename Loop>
+void BasicEPoller<Loop>::applyChanges()
+{
+  for (typename ChannelList::iterator it = changes_.begin();
+      it != changes_.end(); ++it)
+  {
+    ChannelT* channel = *it;
+    if (channel == NULL)
+    {
+      continue;
+    }
+    const int registered = channel->index();
+    const int events = channel->events();
+    assert(registered != kNew);
+    if (events == registered)
+    {
+      continue;
+    }
+    if (registered == kDeleted)
+    {
+      update(EPOLL_CTL_ADD, channel);
+    }
+    else if (channel->isNoneEvent())
+    {
+      update(EPOLL_CTL_DEL, channel);
+    }
+    else
+    {
+      update(EPOLL_CTL_MOD, channel);
+    }
+    channel->set_index(events);
+  }
+  changes_.clear();
+}
+
+template <typename Loop>
+void BasicEPoller<Loop>::update(int operation, ChannelT* channel)
+{
+  struct epoll_event event;
+  bzero(&event, sizeof event);
+  event.events = channel->events();
+  event.data.ptr = channel;
+  int fd = channel->fd();
+  ++numCtlCalls_;
+  if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
+  {
+    if (operation == EPOLL_CTL_DEL)
+    {
+      LOG_SYSERR << "epoll_ctl op=" << operation << " fd=" << fd;
+    }
+    else
+    {
+      LOG_SYSFATAL << "epoll_ctl op=" << operation << " fd=" << fd;
+    }
+  }
+}
+
 }
 #endif  // MUDUO_NET_EPOLLER_H
@@ -8,31 +8,130 @@
 #ifndef MUDUO_NET_EVENTLOOP_H
 #define MUDUO_NET_EVENTLOOP_H
 
+#include <muduo/base/Atomic.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/base/Mutex.h>
 #include <muduo/base/Thread.h>
+#include <muduo/base/Logging.h>
 #include "Callbacks.h"
 #include "TimerId.h"
+#include "EventLoopFwd.h"
+#include "Channel.h"
+#include "EPoller.h"
+#include "Poller.h"
+#include "TimerQueue.h"
 
-#include <boost/scoped_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <vector>
 
+#include <assert.h>
+#include <unistd.h>
+
 namespace muduo
 {
 
-class Channel;
-class EPoller;
-class TimerQueue;
+namespace detail
+{
+
+// in EventLoop.cc, shared by all kinds of loops, one loop per thread.
+extern __thread void* t_loopInThisThread;
+int createEventfd();
+void abortNotInLoopThread(const void* loop, pid_t threadId);
 
-class EventLoop : muduo::noncopyable
+}
+
+///
+/// Queue policy of a loop that other threads talk to, the default.
+/// Functors are queued under a mutex and the loop is woken up by
+/// an eventfd, the counters are atomic.
+///
+struct LockedQueue
 {
- public:
+  static const bool kThreadSafe = true;
+  typedef boost::function<void()> Functor;
+  typedef AtomicInt64 Counter;
+
+  class Queue : muduo::noncopyable
+  {
+   public:
+    void push(const Functor& cb)
+    {
+      MutexLockGuard lock(mutex_);
+      functors_.push_back(cb);
+    }
+
+    void swap(std::vector<Functor>& functors)
+    {
+      MutexLockGuard lock(mutex_);
+      functors_.swap(functors);
+    }
+
+    // only a hint, the loop never sleeps on it
+    bool empty() const { return true; }
+
+   private:
+    MutexLock mutex_;
+    std::vector<Functor> functors_; // @GuardedBy mutex_
+  };
+};
+
+///
+/// Queue policy of a loop that is only touched by its own thread.
+/// No mutex, no eventfd, no atomic counters: everything, including
+/// runInLoop() and quit(), must be called in the loop thread.
+/// The loop polls without blocking while functors are queued.
+///
+struct SingleThreadQueue
+{
+  static const bool kThreadSafe = false;
   typedef boost::function<void()> Functor;
 
-  EventLoop();
+  class Counter
+  {
+   public:
+    Counter() : value_(0) { }
+    int64_t get() const { return value_; }
+    void add(int64_t x) { value_ += x; }
+
+   private:
+    int64_t value_;
+  };
 
-  // force out-line dtor, for scoped_ptr members.
-  ~EventLoop();
+  class Queue : muduo::noncopyable
+  {
+   public:
+    void push(const Functor& cb) { functors_.push_back(cb); }
+    void swap(std::vector<Functor>& functors) { functors_.swap(functors); }
+    bool empty() const { return functors_.empty(); }
+
+   private:
+    std::vector<Functor> functors_;
+  };
+};
+
+///
+/// Reactor, at most one per thread.
+///
+/// The I/O multiplexing, the timers and the functor queue are policies,
+/// fixed at compile time, so the hot path has no virtual calls.
+/// @c EventLoop is the default, epoll(4) with a timerfd and a locked queue,
+/// and is the loop of every TCP class.  Other combinations drive
+/// BasicChannel objects directly, eg. a single-threaded busy-polling loop:
+///
+///   BasicEventLoop<BasicBusyEPoller, BasicTimerQueue, SingleThreadQueue>
+///
+template <template <typename> class PollerPolicy,
+          template <typename> class TimerPolicy,
+          typename QueuePolicy>
+class BasicEventLoop : muduo::noncopyable
+{
+ public:
+  typedef boost::function<void()> Functor;
+  typedef BasicChannel<BasicEventLoop> ChannelType;
+
+  BasicEventLoop();
+  ~BasicEventLoop();
 
   ///
   /// Loops forever.
@@ -48,75 +147,276 @@ class EventLoop : muduo::noncopyable
   ///
   Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+  ///
+  /// Number of polls so far.
+  ///
+  int64_t iteration() const { return iteration_; }
+
+  ///
+  /// Number of epoll_ctl(2) calls so far.
+  /// Must be called in the loop thread.
+  ///
+  int64_t numEpollCtl() const { return poller_.numCtlCalls(); }
+
+  ///
+  /// Microseconds spent in callbacks so far, not waiting in poll.
+  /// Sample it twice to get the busy ratio of an interval.
+  /// Thread safe if the QueuePolicy is.
+  ///
+  int64_t busyMicroseconds() { return busyMicroseconds_.get(); }
+
+  ///
+  /// Bytes queued for output by the connections of this loop.
+  /// Thread safe if the QueuePolicy is.
+  ///
+  int64_t bufferedOutputBytes() { return bufferedOutputBytes_.get(); }
+
+  ///
+  /// Bytes received by the connections of this loop and not yet
+  /// retrieved from their input buffers.
+  /// Thread safe if the QueuePolicy is.
+  ///
+  int64_t bufferedInputBytes() { return bufferedInputBytes_.get(); }
+
   /// Runs callback immediately in the loop thread.
   /// It wakes up the loop, and run the cb.
   /// If in the same loop thread, cb is run within the function.
-  /// Safe to call from other threads.
+  /// Safe to call from other threads if the QueuePolicy is.
   void runInLoop(const Functor& cb);
   /// Queues callback in the loop thread.
   /// Runs after finish pooling.
-  /// Safe to call from other threads.
+  /// Safe to call from other threads if the QueuePolicy is.
   void queueInLoop(const Functor& cb);
 
   // timers
 
   ///
   /// Runs callback at 'time'.
-  /// Safe to call from other threads.
+  /// Safe to call from other threads if the QueuePolicy is.
   ///
-  TimerId runAt(const Timestamp& time, const TimerCallback& cb);
+  TimerId runAt(const Timestamp& time, const TimerCallback& cb)
+  { return timerQueue_.addTimer(cb, time, 0.0); }
   ///
   /// Runs callback after @c delay seconds.
-  /// Safe to call from other threads.
+  /// Safe to call from other threads if the QueuePolicy is.
   ///
-  TimerId runAfter(double delay, const TimerCallback& cb);
+  TimerId runAfter(double delay, const TimerCallback& cb)
+  { return runAt(addTime(Timestamp::now(), delay), cb); }
   ///
   /// Runs callback every @c interval seconds.
-  /// Safe to call from other threads.
+  /// Safe to call from other threads if the QueuePolicy is.
   ///
-  TimerId runEvery(double interval, const TimerCallback& cb);
+  TimerId runEvery(double interval, const TimerCallback& cb)
+  { return timerQueue_.addTimer(cb, addTime(Timestamp::now(), interval), interval); }
 
-  void cancel(TimerId timerId);
+  void cancel(TimerId timerId) { timerQueue_.cancel(timerId); }
 
   // internal use only
   void wakeup();
-  void updateChannel(Channel* channel);
-  void removeChannel(Channel* channel);
+  void addBufferedBytes(int64_t inputDelta, int64_t outputDelta)
+  {
+    if (inputDelta != 0) bufferedInputBytes_.add(inputDelta);
+    if (outputDelta != 0) bufferedOutputBytes_.add(outputDelta);
+  }
+  void updateChannel(ChannelType* channel)
+  {
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    poller_.updateChannel(channel);
+  }
+  void removeChannel(ChannelType* channel)
+  {
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    poller_.removeChannel(channel);
+  }
 
   void assertInLoopThread()
   {
     if (!isInLoopThread())
     {
-      abortNotInLoopThread();
+      detail::abortNotInLoopThread(this, threadId_);
     }
   }
 
   bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
  private:
+  static const int kPollTimeMs = 10000;
 
-  void abortNotInLoopThread();
   void handleRead();  // waked up
   void doPendingFunctors();
 
-  typedef std::vector<Channel*> ChannelList;
+  typedef std::vector<ChannelType*> ChannelList;
 
   bool looping_; /* atomic */
   bool quit_; /* atomic */
   bool callingPendingFunctors_; /* atomic */
   const pid_t threadId_;
+  int64_t iteration_;
   Timestamp pollReturnTime_;
-  boost::scoped_ptr<EPoller> poller_;
-  boost::scoped_ptr<TimerQueue> timerQueue_;
-  int wakeupFd_;
+  typename QueuePolicy::Counter busyMicroseconds_;
+  typename QueuePolicy::Counter bufferedOutputBytes_;
+  typename QueuePolicy::Counter bufferedInputBytes_;
+  // by value, the poller and the timers are called without indirection
+  PollerPolicy<BasicEventLoop> poller_;
+  TimerPolicy<BasicEventLoop> timerQueue_;
+  int wakeupFd_;  // -1 if not thread safe
   // unlike in TimerQueue, which is an internal class,
   // we don't expose Channel to client.
-  boost::scoped_ptr<Channel> wakeupChannel_;
+  ChannelType wakeupChannel_;
   ChannelList activeChannels_;
-  MutexLock mutex_;
-  std::vector<Functor> pendingFunctors_; // @BuardedBy mutex_
+  typename QueuePolicy::Queue pendingFunctors_;
 };
 
+template <template <typename> class P, template <typename> class T, typename Q>
+BasicEventLoop<P, T, Q>::BasicEventLoop()
+  : looping_(false),
+    quit_(false),
+    callingPendingFunctors_(false),
+    threadId_(CurrentThread::tid()),
+    iteration_(0),
+    poller_(this),
+    timerQueue_(this),
+    wakeupFd_(Q::kThreadSafe ? detail::createEventfd() : -1),
+    wakeupChannel_(this, wakeupFd_)
+{
+  LOG_TRACE << "EventLoop created " << this << " in thread " << threadId_;
+  if (detail::t_loopInThisThread)
+  {
+    LOG_FATAL << "Another EventLoop " << detail::t_loopInThisThread
+              << " exists in this thread " << threadId_;
+  }
+  else
+  {
+    detail::t_loopInThisThread = this;
+  }
+  if (Q::kThreadSafe)
+  {
+    wakeupChannel_.setReadCallback(
+        boost::bind(&BasicEventLoop::handleRead, this));
+    // we are always reading the wakeupfd
+    wakeupChannel_.enableReading();
+  }
+}
+
+template <template <typename> class P, template <typename> class T, typename Q>
+BasicEventLoop<P, T, Q>::~BasicEventLoop()
+{
+  assert(!looping_);
+  if (wakeupFd_ >= 0)
+  {
+    ::close(wakeupFd_);
+  }
+  detail::t_loopInThisThread = NULL;
+}
+
+template <template <typename> class P, template <typename> class T, typename Q>
+void BasicEventLoop<P, T, Q>::loop()
+{
+  assert(!looping_);
+  assertInLoopThread();
+  looping_ = true;
+  quit_ = false;
+
+  while (!quit_)
+  {
+    activeChannels_.clear();
+    // nobody would wake us up for the functors queued by the last round
+    const int timeoutMs = pendingFunctors_.empty() ? kPollTimeMs : 0;
+    pollReturnTime_ = poller_.poll(timeoutMs, &activeChannels_);
+    ++iteration_;
+    for (typename ChannelList::iterator it = activeChannels_.begin();
+        it != activeChannels_.end(); ++it)
+    {
+      (*it)->handleEvent(pollReturnTime_);
+    }
+    doPendingFunctors();
+    busyMicroseconds_.add(Timestamp::now().microSecondsSinceEpoch()
+                          - pollReturnTime_.microSecondsSinceEpoch());
+  }
+
+  LOG_TRACE << "EventLoop " << this << " stop looping";
+  looping_ = false;
+}
+
+template <template <typename> class P, template <typename> class T, typename Q>
+void BasicEventLoop<P, T, Q>::quit()
+{
+  quit_ = true;
+  if (!isInLoopThread())
+  {
+    wakeup();
+  }
+}
+
+template <template <typename> class P, template <typename> class T, typename Q>
+void BasicEventLoop<P, T, Q>::runInLoop(const Functor& cb)
+{
+  if (isInLoopThread())
+  {
+    cb();
+  }
+  else
+  {
+    queueInLoop(cb);
+  }
+}
+
+template <template <typename> class P, template <typename> class T, typename Q>
+void BasicEventLoop<P, T, Q>::queueInLoop(const Functor& cb)
+{
+  pendingFunctors_.push(cb);
+
+  if (!isInLoopThread() || callingPendingFunctors_)
+  {
+    wakeup();
+  }
+}
+
+template <template <typename> class P, template <typename> class T, typename Q>
+void BasicEventLoop<P, T, Q>::wakeup()
+{
+  if (!Q::kThreadSafe)
+  {
+    // called in the loop thread, the next poll won't block
+    assertInLoopThread();
+    return;
+  }
+  uint64_t one = 1;
+  ssize_t n = ::write(wakeupFd_, &one, sizeof one);
+  if (n != sizeof one)
+  {
+    LOG_ERROR << "EventLoop::wakeup() writes " << n << " bytes instead of 8";
+  }
+}
+
+template <template <typename> class P, template <typename> class T, typename Q>
+void BasicEventLoop<P, T, Q>::handleRead()
+{
+  uint64_t one = 1;
+  ssize_t n = ::read(wakeupFd_, &one, sizeof one);
+  if (n != sizeof one)
+  {
+    LOG_ERROR << "EventLoop::handleRead() reads " << n << " bytes instead of 8";
+  }
+}
+
+template <template <typename> class P, template <typename> class T, typename Q>
+void BasicEventLoop<P, T, Q>::doPendingFunctors()
+{
+  std::vector<Functor> functors;
+  callingPendingFunctors_ = true;
+
+  pendingFunctors_.swap(functors);
+
+  for (size_t i = 0; i < functors.size(); ++i)
+  {
+    functors[i]();
+  }
+  callingPendingFunctors_ = false;
+}
+
 }
 
 #endif  // MUDUO_NET_EVENTLOOP_H
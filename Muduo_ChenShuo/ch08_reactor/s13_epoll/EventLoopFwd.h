@@ -0,0 +1,40 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_EVENTLOOPFWD_H
+#define MUDUO_NET_EVENTLOOPFWD_H
+
+namespace muduo
+{
+
+// Declares the reactor templates with their default policies,
+// include it instead of forward declaring EventLoop or Channel.
+
+template <typename Loop> class BasicChannel;
+template <typename Loop> class BasicEPoller;
+template <typename Loop> class BasicPoller;
+template <typename Loop> class BasicTimerQueue;
+struct LockedQueue;
+
+template <template <typename> class PollerPolicy =
+#ifdef MUDUO_USE_POLL
+              BasicPoller,  // poll(2), for comparison
+#else
+              BasicEPoller,
+#endif
+          template <typename> class TimerPolicy = BasicTimerQueue,
+          typename QueuePolicy = LockedQueue>
+class BasicEventLoop;
+
+typedef BasicEventLoop<> EventLoop;
+typedef BasicChannel<EventLoop> Channel;
+
+}
+
+#endif  // MUDUO_NET_EVENTLOOPFWD_H
@@ -8,6 +8,8 @@
 #ifndef MUDUO_NET_EVENTLOOPTHREAD_H
 #define MUDUO_NET_EVENTLOOPTHREAD_H
 
+#include "EventLoopFwd.h"
+
 #include <muduo/base/Condition.h>
 #include <muduo/base/Mutex.h>
 #include <muduo/base/Thread.h>
@@ -17,14 +19,14 @@
 namespace muduo
 {
 
-class EventLoop;
-
 class EventLoopThread : muduo::noncopyable
 {
  public:
   EventLoopThread();
   ~EventLoopThread();
   EventLoop* startLoop();
+  /// The loop returned by startLoop().
+  EventLoop* getLoop() const { return loop_; }
 
  private:
   void threadFunc();
@@ -12,6 +12,8 @@
 
 #include <boost/bind.hpp>
 
+#include <algorithm>
+
 using namespace muduo;
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop)
@@ -36,27 +38,89 @@ void EventLoopThreadPool::start()
 
   for (int i = 0; i < numThreads_; ++i)
   {
-    EventLoopThread* t = new EventLoopThread;
-    threads_.push_back(t);
-    loops_.push_back(t->startLoop());
+    addLoop();
   }
 }
 
 EventLoop* EventLoopThreadPool::getNextLoop()
 {
-  baseLoop_->assertInLoopThread();
   EventLoop* loop = baseLoop_;
 
+  MutexLockGuard lock(mutex_);
   if (!loops_.empty())
   {
-    // round-robin
-    loop = loops_[next_];
-    ++next_;
-    if (static_cast<size_t>(next_) >= loops_.size())
+    // round-robin, next_ may be past the end after retireLoop()
+    if (next_ >= loops_.size())
     {
       next_ = 0;
     }
+    loop = loops_[next_];
+    ++next_;
+  }
+  return loop;
+}
+
+std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
+{
+  MutexLockGuard lock(mutex_);
+  if (loops_.empty())
+  {
+    return std::vector<EventLoop*>(1, baseLoop_);
+  }
+  else
+  {
+    return loops_;
+  }
+}
+
+EventLoop* EventLoopThreadPool::addLoop()
+{
+  baseLoop_->assertInLoopThread();
+  EventLoopThread* t = new EventLoopThread;
+  threads_.push_back(t);
+  EventLoop* loop = t->startLoop();
+  {
+  MutexLockGuard lock(mutex_);
+  loops_.push_back(loop);
   }
   return loop;
 }
 
+void EventLoopThreadPool::retireLoop(EventLoop* loop)
+{
+  baseLoop_->assertInLoopThread();
+  MutexLockGuard lock(mutex_);
+  std::vector<EventLoop*>::iterator it =
+      std::find(loops_.begin(), loops_.end(), loop);
+  assert(it != loops_.end());
+  loops_.erase(it);
+}
+
+void EventLoopThreadPool::restoreLoop(EventLoop* loop)
+{
+  baseLoop_->assertInLoopThread();
+  MutexLockGuard lock(mutex_);
+  assert(std::find(loops_.begin(), loops_.end(), loop) == loops_.end());
+  loops_.push_back(loop);
+}
+
+void EventLoopThreadPool::releaseLoop(EventLoop* loop)
+{
+  baseLoop_->assertInLoopThread();
+  for (boost::ptr_vector<EventLoopThread>::iterator it = threads_.begin();
+      it != threads_.end(); ++it)
+  {
+    if (it->getLoop() == loop)
+    {
+      {
+      MutexLockGuard lock(mutex_);
+      assert(std::find(loops_.begin(), loops_.end(), loop) == loops_.end());
+      }
+      // quits and joins
+      threads_.erase(it);
+      return;
+    }
+  }
+  assert(false && "releaseLoop() of a loop not in the pool");
+}
+
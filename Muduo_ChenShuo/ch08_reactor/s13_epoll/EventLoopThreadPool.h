@@ -8,6 +8,8 @@
 #ifndef MUDUO_NET_EVENTLOOPTHREADPOOL_H
 #define MUDUO_NET_EVENTLOOPTHREADPOOL_H
 
+#include "EventLoopFwd.h"
+
 #include <muduo/base/Condition.h>
 #include <muduo/base/Mutex.h>
 #include <muduo/base/Thread.h>
@@ -21,7 +23,6 @@
 namespace muduo
 {
 
-class EventLoop;
 class EventLoopThread;
 
 class EventLoopThreadPool : muduo::noncopyable
@@ -31,15 +32,38 @@ class EventLoopThreadPool : muduo::noncopyable
   ~EventLoopThreadPool();
   void setThreadNum(int numThreads) { numThreads_ = numThreads; }
   void start();
+  /// Picks a loop round-robin, the base loop if there is no IO thread.
+  /// Thread safe.
   EventLoop* getNextLoop();
+  /// Returns all IO loops, or the base loop if there is no IO thread.
+  /// Retired loops are not included.  Thread safe.
+  std::vector<EventLoop*> getAllLoops();
+
+  // resizing at runtime, after start()
+
+  /// Starts one more IO thread and places new work on its loop too.
+  /// Must be called in the base loop thread.
+  EventLoop* addLoop();
+  /// Stops placing new work on @c loop.  Its owner moves what runs
+  /// there to other loops, then calls releaseLoop().
+  /// Must be called in the base loop thread.
+  void retireLoop(EventLoop* loop);
+  /// Places new work on a retired @c loop again, for work that
+  /// can't move away.  Must be called in the base loop thread.
+  void restoreLoop(EventLoop* loop);
+  /// Quits and joins the thread of a retired loop,
+  /// functors still queued in it are dropped.
+  /// Must be called in the base loop thread.
+  void releaseLoop(EventLoop* loop);
 
  private:
   EventLoop* baseLoop_;
   bool started_;
   int numThreads_;
-  int next_;  // always in loop thread
-  boost::ptr_vector<EventLoopThread> threads_;
-  std::vector<EventLoop*> loops_;
+  boost::ptr_vector<EventLoopThread> threads_;  // with retired ones
+  MutexLock mutex_;
+  size_t next_;  // @GuardedBy mutex_
+  std::vector<EventLoop*> loops_;  // @GuardedBy mutex_, not retired
 };
 
 }
@@ -0,0 +1,220 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "HttpContext.h"
+
+#include "Buffer.h"
+
+#include <assert.h>
+#include <string.h>  // memchr
+
+using namespace muduo;
+
+namespace
+{
+
+bool equalsIgnoreCase(const StringView& s, const char* literal, size_t len)
+{
+  return s.size() == len && ::strncasecmp(s.data(), literal, len) == 0;
+}
+
+}
+
+HttpContext::HttpContext()
+  : state_(kExpectRequestLine),
+    parsed_(0),
+    contentLength_(0)
+{
+}
+
+void HttpContext::reset()
+{
+  state_ = kExpectRequestLine;
+  parsed_ = 0;
+  contentLength_ = 0;
+  request_.base_ = NULL;
+  request_.method_ = HttpRequest::kInvalid;
+  request_.version_ = HttpRequest::kUnknown;
+  request_.path_ = HttpRequest::Span();
+  request_.query_ = HttpRequest::Span();
+  request_.body_ = HttpRequest::Span();
+  request_.headers_.clear();
+}
+
+bool HttpContext::parseRequest(const Buffer* buf, Timestamp receiveTime)
+{
+  const char* base = buf->peek();
+  while (state_ != kGotAll)
+  {
+    if (state_ == kExpectBody)
+    {
+      if (buf->readableBytes() - parsed_ < contentLength_)
+      {
+        break;
+      }
+      request_.body_.offset = static_cast<uint32_t>(parsed_);
+      request_.body_.len = static_cast<uint32_t>(contentLength_);
+      parsed_ += contentLength_;
+      state_ = kGotAll;
+    }
+    else
+    {
+      const char* crlf = buf->findCRLF(base + parsed_);
+      if (crlf == NULL)
+      {
+        // the line so far will be scanned again, lines are short
+        if (buf->readableBytes() > kMaxHeaderBytes)
+        {
+          return false;
+        }
+        break;
+      }
+      if (static_cast<size_t>(crlf - base) > kMaxHeaderBytes)
+      {
+        return false;
+      }
+      const char* begin = base + parsed_;
+      bool ok = state_ == kExpectRequestLine
+              ? processRequestLine(base, begin, crlf)
+              : processHeader(base, begin, crlf);
+      if (!ok)
+      {
+        return false;
+      }
+      parsed_ = crlf + 2 - base;
+    }
+  }
+
+  if (state_ == kGotAll)
+  {
+    request_.base_ = base;
+    request_.receiveTime_ = receiveTime;
+  }
+  return true;
+}
+
+bool HttpContext::processRequestLine(const char* base,
+                                     const char* begin,
+                                     const char* end)
+{
+  const char* space = static_cast<const char*>(::memchr(begin, ' ', end - begin));
+  if (space == NULL)
+  {
+    return false;
+  }
+  StringView method(begin, space - begin);
+  if (method == "GET")
+    request_.method_ = HttpRequest::kGet;
+  else if (method == "POST")
+    request_.method_ = HttpRequest::kPost;
+  else if (method == "HEAD")
+    request_.method_ = HttpRequest::kHead;
+  else if (method == "PUT")
+    request_.method_ = HttpRequest::kPut;
+  else if (method == "DELETE")
+    request_.method_ = HttpRequest::kDelete;
+  else
+    return false;
+
+  const char* target = space + 1;
+  space = static_cast<const char*>(::memchr(target, ' ', end - target));
+  if (space == NULL || space == target)
+  {
+    return false;
+  }
+  const char* question =
+      static_cast<const char*>(::memchr(target, '?', space - target));
+  const char* pathEnd = question ? question : space;
+  request_.path_.offset = static_cast<uint32_t>(target - base);
+  request_.path_.len = static_cast<uint32_t>(pathEnd - target);
+  if (question)
+  {
+    request_.query_.offset = static_cast<uint32_t>(question + 1 - base);
+    request_.query_.len = static_cast<uint32_t>(space - question - 1);
+  }
+
+  StringView version(space + 1, end - space - 1);
+  if (version == "HTTP/1.1")
+    request_.version_ = HttpRequest::kHttp11;
+  else if (version == "HTTP/1.0")
+    request_.version_ = HttpRequest::kHttp10;
+  else
+    return false;
+
+  state_ = kExpectHeaders;
+  return true;
+}
+
+bool HttpContext::processHeader(const char* base,
+                                const char* begin,
+                                const char* end)
+{
+  if (begin == end)
+  {
+    state_ = contentLength_ > 0 ? kExpectBody : kGotAll;
+    return true;
+  }
+
+  const char* colon = static_cast<const char*>(::memchr(begin, ':', end - begin));
+  if (colon == NULL || colon == begin)
+  {
+    return false;
+  }
+  const char* value = colon + 1;
+  while (value < end && (*value == ' ' || *value == '\t'))
+    ++value;
+  const char* valueEnd = end;
+  while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+    --valueEnd;
+
+  StringView name(begin, colon - begin);
+  if (equalsIgnoreCase(name, "Content-Length", 14))
+  {
+    if (value == valueEnd)
+    {
+      return false;
+    }
+    size_t len = 0;
+    for (const char* p = value; p < valueEnd; ++p)
+    {
+      if (*p < '0' || *p > '9')
+      {
+        return false;
+      }
+      len = len * 10 + (*p - '0');
+      if (len > kMaxBodyBytes)
+      {
+        return false;
+      }
+    }
+    contentLength_ = len;
+  }
+  else if (equalsIgnoreCase(name, "Transfer-Encoding", 17))
+  {
+    // chunked request bodies are not supported
+    return false;
+  }
+
+  HttpRequest::Header header;
+  header.name.offset = static_cast<uint32_t>(begin - base);
+  header.name.len = static_cast<uint32_t>(colon - begin);
+  header.value.offset = static_cast<uint32_t>(value - base);
+  header.value.len = static_cast<uint32_t>(valueEnd - value);
+  request_.headers_.push_back(header);
+  return true;
+}
+
+bool HttpContext::closeConnection() const
+{
+  assert(gotAll());
+  StringView connection = request_.getHeader("Connection");
+  if (request_.getVersion() == HttpRequest::kHttp11)
+  {
+    return equalsIgnoreCase(connection, "close", 5);
+  }
+  return !equalsIgnoreCase(connection, "keep-alive", 10);
+}
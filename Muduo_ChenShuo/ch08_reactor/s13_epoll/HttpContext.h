@@ -0,0 +1,67 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_HTTPCONTEXT_H
+#define MUDUO_NET_HTTPCONTEXT_H
+
+#include "HttpRequest.h"
+
+#include <muduo/base/noncopyable.h>
+
+namespace muduo
+{
+
+class Buffer;
+
+///
+/// Incremental HTTP/1.x request parser of one connection.
+///
+/// Parses the request at the front of the Buffer one line at a time,
+/// and remembers where it stopped, so each read only parses new lines.
+/// Positions are kept as offsets from Buffer::peek().
+class HttpContext : muduo::noncopyable
+{
+ public:
+  static const size_t kMaxHeaderBytes = 64*1024;
+  static const size_t kMaxBodyBytes = 16*1024*1024;
+
+  HttpContext();
+
+  /// Returns false on a malformed or too long request.
+  bool parseRequest(const Buffer* buf, Timestamp receiveTime);
+
+  bool gotAll() const { return state_ == kGotAll; }
+
+  /// Valid if gotAll(), until the Buffer changes.
+  const HttpRequest& request() const { return request_; }
+
+  /// Bytes of the complete request, to be retrieved from the Buffer.
+  size_t requestBytes() const { return parsed_; }
+
+  /// Whether the connection closes after responding to the request.
+  bool closeConnection() const;
+
+  /// Gets ready for the next request.
+  void reset();
+
+ private:
+  enum State { kExpectRequestLine, kExpectHeaders, kExpectBody, kGotAll };
+
+  bool processRequestLine(const char* base, const char* begin, const char* end);
+  bool processHeader(const char* base, const char* begin, const char* end);
+
+  State state_;
+  size_t parsed_;  // bytes after peek() that have been parsed
+  size_t contentLength_;
+  HttpRequest request_;
+};
+
+}
+
+#endif  // MUDUO_NET_HTTPCONTEXT_H
@@ -0,0 +1,100 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTPREQUEST_H
+#define MUDUO_NET_HTTPREQUEST_H
+
+#include "StringView.h"
+
+#include <muduo/base/copyable.h>
+#include <muduo/base/Timestamp.h>
+
+#include <vector>
+
+#include <stdint.h>
+#include <strings.h>  // strncasecmp
+
+namespace muduo
+{
+
+///
+/// A parsed HTTP request, its fields are views into the input Buffer.
+///
+/// Valid during the HttpServer callback only, copy what you keep.
+class HttpRequest : public muduo::copyable
+{
+ public:
+  enum Method { kInvalid, kGet, kPost, kHead, kPut, kDelete };
+  enum Version { kUnknown, kHttp10, kHttp11 };
+
+  HttpRequest()
+    : base_(NULL), method_(kInvalid), version_(kUnknown)
+  { }
+
+  Method method() const { return method_; }
+  Version getVersion() const { return version_; }
+  StringView path() const { return view(path_); }
+  StringView query() const { return view(query_); }
+  StringView body() const { return view(body_); }
+  Timestamp receiveTime() const { return receiveTime_; }
+
+  int numHeaders() const { return static_cast<int>(headers_.size()); }
+  StringView headerName(int i) const { return view(headers_[i].name); }
+  StringView headerValue(int i) const { return view(headers_[i].value); }
+
+  /// Value of the first header named @c field, case-insensitive.
+  /// Empty if there is none.
+  StringView getHeader(const StringView& field) const
+  {
+    for (size_t i = 0; i < headers_.size(); ++i)
+    {
+      StringView name = view(headers_[i].name);
+      if (name.size() == field.size()
+          && ::strncasecmp(name.data(), field.data(), field.size()) == 0)
+      {
+        return view(headers_[i].value);
+      }
+    }
+    return StringView();
+  }
+
+ private:
+  friend class HttpContext;
+
+  // offset from the first byte of the request, stays valid when
+  // the Buffer moves its bytes between reads
+  struct Span
+  {
+    Span() : offset(0), len(0) { }
+    uint32_t offset;
+    uint32_t len;
+  };
+
+  struct Header
+  {
+    Span name;
+    Span value;
+  };
+
+  StringView view(const Span& s) const
+  { return StringView(base_ + s.offset, s.len); }
+
+  const char* base_;  // set when the request is complete
+  Method method_;
+  Version version_;
+  Span path_;
+  Span query_;
+  Span body_;
+  std::vector<Header> headers_;  // keeps its capacity between requests
+  Timestamp receiveTime_;
+};
+
+}
+
+#endif  // MUDUO_NET_HTTPREQUEST_H
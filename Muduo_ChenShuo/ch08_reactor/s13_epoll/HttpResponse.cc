@@ -0,0 +1,84 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "HttpResponse.h"
+
+#include "Buffer.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+
+HttpResponse::HttpResponse(Buffer* output, bool closeConnection, bool headOnly)
+  : output_(output),
+    statusCode_(200),
+    statusMessage_("OK"),
+    statusWritten_(false),
+    closeConnection_(closeConnection),
+    headOnly_(headOnly),
+    finished_(false)
+{
+}
+
+void HttpResponse::setStatus(int code, const StringView& message)
+{
+  assert(!statusWritten_);
+  statusCode_ = code;
+  statusMessage_ = message;
+}
+
+void HttpResponse::setCloseConnection(bool on)
+{
+  assert(!finished_);
+  closeConnection_ = on;
+}
+
+void HttpResponse::writeStatusLine()
+{
+  if (!statusWritten_)
+  {
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
+    output_->append(buf, n);
+    output_->append(statusMessage_.data(), statusMessage_.size());
+    output_->append("\r\n", 2);
+    statusWritten_ = true;
+  }
+}
+
+void HttpResponse::addHeader(const StringView& field, const StringView& value)
+{
+  assert(!finished_);
+  writeStatusLine();
+  output_->append(field.data(), field.size());
+  output_->append(": ", 2);
+  output_->append(value.data(), value.size());
+  output_->append("\r\n", 2);
+}
+
+void HttpResponse::setBody(const StringView& body)
+{
+  assert(!finished_);
+  writeStatusLine();
+  char buf[64];
+  int n = snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body.size());
+  output_->append(buf, n);
+  if (closeConnection_)
+  {
+    output_->append("Connection: close\r\n\r\n", 21);
+  }
+  else
+  {
+    output_->append("Connection: Keep-Alive\r\n\r\n", 26);
+  }
+  if (!headOnly_)
+  {
+    output_->append(body.data(), body.size());
+  }
+  finished_ = true;
+}
@@ -0,0 +1,61 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTPRESPONSE_H
+#define MUDUO_NET_HTTPRESPONSE_H
+
+#include "StringView.h"
+
+#include <muduo/base/noncopyable.h>
+
+namespace muduo
+{
+
+class Buffer;
+
+///
+/// Writes an HTTP/1.1 response straight into the output buffer.
+///
+/// Set the status first, then add headers, then set the body once.
+/// The status line goes out with the first header, 200 OK by default.
+/// Content-Length and Connection are added by setBody().
+class HttpResponse : muduo::noncopyable
+{
+ public:
+  /// Internal use only, HttpServer creates it.
+  HttpResponse(Buffer* output, bool closeConnection, bool headOnly);
+
+  void setStatus(int code, const StringView& message);
+  void addHeader(const StringView& field, const StringView& value);
+  void setContentType(const StringView& contentType)
+  { addHeader("Content-Type", contentType); }
+
+  /// Must be called before setBody().
+  void setCloseConnection(bool on);
+  bool closeConnection() const { return closeConnection_; }
+
+  /// Completes the response, with no body for a HEAD request.
+  void setBody(const StringView& body);
+  bool finished() const { return finished_; }
+
+ private:
+  void writeStatusLine();
+
+  Buffer* output_;
+  int statusCode_;
+  StringView statusMessage_;
+  bool statusWritten_;
+  bool closeConnection_;
+  bool headOnly_;
+  bool finished_;
+};
+
+}
+
+#endif  // MUDUO_NET_HTTPRESPONSE_H
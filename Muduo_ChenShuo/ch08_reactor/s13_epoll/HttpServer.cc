@@ -0,0 +1,110 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "HttpServer.h"
+
+#include <muduo/base/Logging.h>
+#include "HttpContext.h"
+
+#include <boost/bind.hpp>
+
+using namespace muduo;
+
+namespace
+{
+
+void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
+{
+  resp->setStatus(404, "Not Found");
+  resp->setCloseConnection(true);
+  resp->setBody(StringView());
+}
+
+}
+
+HttpServer::HttpServer(EventLoop* loop, const InetAddress& listenAddr)
+  : server_(loop, listenAddr),
+    httpCallback_(defaultHttpCallback)
+{
+  server_.setConnectionCallback(
+      boost::bind(&HttpServer::onConnection, this, _1));
+  server_.setMessageCallback(
+      boost::bind(&HttpServer::onMessage, this, _1, _2, _3));
+}
+
+HttpServer::~HttpServer()
+{
+}
+
+void HttpServer::start()
+{
+  server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    // one parser per connection, in the connection itself
+    conn->emplaceContext<HttpContext>();
+  }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr& conn,
+                           Buffer* buf,
+                           Timestamp receiveTime)
+{
+  HttpContext* context = conn->context<HttpContext>();
+  assert(context);
+  if (!conn->connected())
+  {
+    // closing after a response, drop the requests behind it
+    buf->retrieveAll();
+    return;
+  }
+  Buffer output(0);
+  bool close = false;
+  while (!close)
+  {
+    if (!context->parseRequest(buf, receiveTime))
+    {
+      LOG_ERROR << "HttpServer::onMessage [" << conn->name()
+                << "] - bad request";
+      output.append("HTTP/1.1 400 Bad Request\r\n"
+                    "Connection: close\r\n\r\n");
+      buf->retrieveAll();
+      close = true;
+      break;
+    }
+    if (!context->gotAll())
+    {
+      break;
+    }
+
+    const HttpRequest& request = context->request();
+    HttpResponse response(&output,
+                          context->closeConnection(),
+                          request.method() == HttpRequest::kHead);
+    httpCallback_(request, &response);
+    if (!response.finished())
+    {
+      response.setBody(StringView());
+    }
+    close = response.closeConnection();
+    buf->retrieve(context->requestBytes());
+    context->reset();
+  }
+
+  if (output.readableBytes() > 0)
+  {
+    conn->send(&output);
+  }
+  if (close)
+  {
+    conn->shutdown();
+  }
+}
@@ -0,0 +1,58 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTPSERVER_H
+#define MUDUO_NET_HTTPSERVER_H
+
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "TcpServer.h"
+
+namespace muduo
+{
+
+///
+/// HTTP/1.x server with keep-alive and pipelining.
+///
+/// The callback runs in the IO loop of the connection, and must respond
+/// before it returns.  Responses to the requests that arrived in one read
+/// are written to one Buffer and sent together, so they keep the order
+/// of the requests.
+class HttpServer : muduo::noncopyable
+{
+ public:
+  typedef boost::function<void (const HttpRequest&,
+                                HttpResponse*)> HttpCallback;
+
+  HttpServer(EventLoop* loop, const InetAddress& listenAddr);
+  ~HttpServer();
+
+  /// Not thread safe, callback be registered before calling start().
+  void setHttpCallback(const HttpCallback& cb)
+  { httpCallback_ = cb; }
+
+  /// See TcpServer::setThreadNum().
+  void setThreadNum(int numThreads)
+  { server_.setThreadNum(numThreads); }
+
+  void start();
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn);
+  void onMessage(const TcpConnectionPtr& conn,
+                 Buffer* buf,
+                 Timestamp receiveTime);
+
+  TcpServer server_;
+  HttpCallback httpCallback_;
+};
+
+}
+
+#endif  // MUDUO_NET_HTTPSERVER_H
@@ -10,10 +10,15 @@
 
 #include "SocketsOps.h"
 
+#include <muduo/base/Logging.h>
+
+#include <algorithm>
+
+#include <stddef.h>  // offsetof
+#include <string.h>  // strnlen
 #include <strings.h>  // bzero
 #include <netinet/in.h>
-
-#include <boost/static_assert.hpp>
+#include <sys/un.h>
 
 //     /* Structure describing an Internet socket address.  */
 //     struct sockaddr_in {
@@ -32,8 +37,6 @@ using namespace muduo;
 
 static const in_addr_t kInaddrAny = INADDR_ANY;
 
-BOOST_STATIC_ASSERT(sizeof(InetAddress) == sizeof(struct sockaddr_in));
-
 InetAddress::InetAddress(uint16_t port)
 {
   bzero(&addr_, sizeof addr_);
@@ -48,8 +51,85 @@ InetAddress::InetAddress(const std::string& ip, uint16_t port)
   sockets::fromHostPort(ip.c_str(), port, &addr_);
 }
 
+InetAddress InetAddress::fromUnixPath(const std::string& path)
+{
+  InetAddress addr(0);
+  addr.addr_.sin_family = AF_UNIX;
+  addr.addr_.sin_addr.s_addr = 0;
+  addr.path_.reset(new std::string(path));
+  return addr;
+}
+
+InetAddress::InetAddress(const struct sockaddr_storage& addr, socklen_t len)
+{
+  bzero(&addr_, sizeof addr_);
+  if (addr.ss_family == AF_UNIX)
+  {
+    const void* raw = &addr;
+    const struct sockaddr_un* un = static_cast<const struct sockaddr_un*>(raw);
+    addr_.sin_family = AF_UNIX;
+    const size_t offset = offsetof(struct sockaddr_un, sun_path);
+    if (len > offset)
+    {
+      std::string path(un->sun_path, len - offset);
+      if (path[0] == '\0')
+      {
+        path[0] = '@';
+      }
+      else
+      {
+        path.resize(strnlen(path.c_str(), path.size()));
+      }
+      path_.reset(new std::string(path));
+    }
+  }
+  else
+  {
+    assert(addr.ss_family == AF_INET);
+    addr_ = *static_cast<const struct sockaddr_in*>(
+        implicit_cast<const void*>(&addr));
+  }
+}
+
+std::string InetAddress::unixPath() const
+{
+  return path_ ? *path_ : std::string();
+}
+
+socklen_t InetAddress::toSockAddr(struct sockaddr_storage* addr) const
+{
+  bzero(addr, sizeof *addr);
+  if (isUnix())
+  {
+    struct sockaddr_un* un =
+        static_cast<struct sockaddr_un*>(implicit_cast<void*>(addr));
+    un->sun_family = AF_UNIX;
+    std::string path = unixPath();
+    if (path.size() >= sizeof un->sun_path)
+    {
+      LOG_ERROR << "InetAddress::toSockAddr - path too long " << path;
+      path.resize(sizeof un->sun_path - 1);
+    }
+    std::copy(path.begin(), path.end(), un->sun_path);
+    if (!path.empty() && path[0] == '@')
+    {
+      // abstract namespace, the name is not NUL terminated
+      un->sun_path[0] = '\0';
+      return static_cast<socklen_t>(
+          offsetof(struct sockaddr_un, sun_path) + path.size());
+    }
+    return sizeof *un;
+  }
+  *static_cast<struct sockaddr_in*>(implicit_cast<void*>(addr)) = addr_;
+  return sizeof addr_;
+}
+
 std::string InetAddress::toHostPort() const
 {
+  if (isUnix())
+  {
+    return "unix:" + unixPath();
+  }
   char buf[32];
   sockets::toHostPort(buf, sizeof buf, addr_);
   return buf;
@@ -13,17 +13,21 @@
 
 #include <muduo/base/copyable.h>
 
+#include <boost/shared_ptr.hpp>
+
 #include <string>
 
 #include <netinet/in.h>
+#include <sys/socket.h>
 
 namespace muduo
 {
 
 ///
-/// Wrapper of sockaddr_in.
+/// Wrapper of sockaddr_in, or of a Unix domain socket path.
 ///
-/// This is an POD interface class.
+/// A Unix address keeps its path out of line, so that a TCP address
+/// stays as small as sockaddr_in.
 class InetAddress : public muduo::copyable
 {
  public:
@@ -41,15 +45,33 @@ class InetAddress : public muduo::copyable
     : addr_(addr)
   { }
 
+  /// Constructs a Unix domain socket address.
+  /// A @c path starting with '@' is in the abstract namespace.
+  static InetAddress fromUnixPath(const std::string& path);
+
+  /// Constructs from an address of any family filled by the kernel.
+  InetAddress(const struct sockaddr_storage& addr, socklen_t len);
+
+  /// "1.2.3.4:80", or "unix:/path" for Unix addresses
   std::string toHostPort() const;
 
   // default copy/assignment are Okay
 
+  sa_family_t family() const { return addr_.sin_family; }
+  bool isUnix() const { return family() == AF_UNIX; }
+  /// The path of a Unix address, empty if unnamed.
+  std::string unixPath() const;
+
+  /// Fills @c addr for bind(2) or connect(2), returns its length.
+  socklen_t toSockAddr(struct sockaddr_storage* addr) const;
+
   const struct sockaddr_in& getSockAddrInet() const { return addr_; }
-  void setSockAddrInet(const struct sockaddr_in& addr) { addr_ = addr; }
+  void setSockAddrInet(const struct sockaddr_in& addr)
+  { addr_ = addr; path_.reset(); }
 
  private:
-  struct sockaddr_in addr_;
+  struct sockaddr_in addr_;  // only sin_family is used by Unix addresses
+  boost::shared_ptr<const std::string> path_;  // of Unix addresses
 };
 
 }
@@ -0,0 +1,150 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "LengthHeaderCodec.h"
+
+#include <muduo/base/Logging.h>
+#include "Buffer.h"
+#include "SocketsOps.h"
+#include "TcpConnection.h"
+
+#include <algorithm>
+
+#include <string.h>  // memcpy
+
+using namespace muduo;
+
+LengthHeaderCodec::LengthHeaderCodec(const FramesCallback& cb,
+                                     int headerLen,
+                                     size_t maxFrameLen)
+  : framesCallback_(cb),
+    headerLen_(headerLen),
+    maxFrameLen_(headerLen < 8
+                 ? std::min(maxFrameLen, (size_t(1) << (headerLen * 8)) - 1)
+                 : maxFrameLen)
+{
+  assert(headerLen == 1 || headerLen == 2 || headerLen == 4 || headerLen == 8);
+  assert(implicit_cast<size_t>(headerLen) <= Buffer::kCheapPrepend);
+}
+
+size_t LengthHeaderCodec::readHeader(const char* p) const
+{
+  switch (headerLen_)
+  {
+    case 1:
+      return static_cast<uint8_t>(*p);
+    case 2:
+    {
+      uint16_t be16 = 0;
+      ::memcpy(&be16, p, sizeof be16);
+      return sockets::networkToHost16(be16);
+    }
+    case 4:
+    {
+      uint32_t be32 = 0;
+      ::memcpy(&be32, p, sizeof be32);
+      return sockets::networkToHost32(be32);
+    }
+    default:
+    {
+      uint64_t be64 = 0;
+      ::memcpy(&be64, p, sizeof be64);
+      return static_cast<size_t>(sockets::networkToHost64(be64));
+    }
+  }
+}
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr& conn,
+                                  Buffer* buf,
+                                  Timestamp receiveTime)
+{
+  StringView frames[kMaxBatch];
+  int count = 0;
+  const char* const begin = buf->peek();
+  const char* const end = buf->beginWrite();
+  const char* p = begin;
+  bool bad = false;
+  while (end - p >= headerLen_)
+  {
+    const size_t len = readHeader(p);
+    if (len > maxFrameLen_)
+    {
+      LOG_ERROR << "LengthHeaderCodec::onMessage [" << conn->name()
+                << "] - invalid length " << len;
+      bad = true;
+      break;
+    }
+    if (implicit_cast<size_t>(end - p - headerLen_) < len)
+    {
+      break;
+    }
+    frames[count++] = StringView(p + headerLen_, len);
+    p += headerLen_ + len;
+    if (count == kMaxBatch)
+    {
+      framesCallback_(conn, frames, count, receiveTime);
+      count = 0;
+    }
+  }
+  if (count > 0)
+  {
+    framesCallback_(conn, frames, count, receiveTime);
+  }
+  // the views are gone, now consume the frames
+  if (bad)
+  {
+    // not shutdown(), the peer could keep sending frames
+    buf->retrieveAll();
+    conn->forceClose();
+  }
+  else
+  {
+    buf->retrieve(p - begin);
+  }
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn,
+                             Buffer* payload) const
+{
+  const size_t len = payload->readableBytes();
+  assert(len <= maxFrameLen_);
+  char header[8];
+  switch (headerLen_)
+  {
+    case 1:
+      header[0] = static_cast<char>(len);
+      break;
+    case 2:
+    {
+      uint16_t be16 = sockets::hostToNetwork16(static_cast<uint16_t>(len));
+      ::memcpy(header, &be16, sizeof be16);
+      break;
+    }
+    case 4:
+    {
+      uint32_t be32 = sockets::hostToNetwork32(static_cast<uint32_t>(len));
+      ::memcpy(header, &be32, sizeof be32);
+      break;
+    }
+    default:
+    {
+      uint64_t be64 = sockets::hostToNetwork64(len);
+      ::memcpy(header, &be64, sizeof be64);
+      break;
+    }
+  }
+  payload->prepend(header, headerLen_);
+  conn->send(payload);
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn,
+                             const StringView& payload) const
+{
+  Buffer buf(payload.size());
+  buf.append(payload.data(), payload.size());
+  send(conn, &buf);
+}
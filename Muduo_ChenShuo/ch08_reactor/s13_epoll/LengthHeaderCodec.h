@@ -0,0 +1,74 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_LENGTHHEADERCODEC_H
+#define MUDUO_NET_LENGTHHEADERCODEC_H
+
+#include "Callbacks.h"
+#include "StringView.h"
+
+#include <muduo/base/noncopyable.h>
+
+namespace muduo
+{
+
+class Buffer;
+
+///
+/// Frames of a length header in network byte order, then the payload.
+///
+/// Decodes every complete frame in the input buffer at once, and passes
+/// them to the callback as views into the buffer, without copying.
+/// Encodes by writing the header into the prepend area of the payload.
+/// Keeps no per connection state, one codec serves a whole server.
+class LengthHeaderCodec : muduo::noncopyable
+{
+ public:
+  /// frames passed to one callback at most
+  static const int kMaxBatch = 64;
+
+  /// The views in @c frames are valid during the call only.
+  typedef boost::function<void (const TcpConnectionPtr&,
+                                const StringView* frames,
+                                int count,
+                                Timestamp)> FramesCallback;
+
+  /// @param headerLen 1, 2, 4 or 8 bytes
+  /// @param maxFrameLen a longer frame closes the connection,
+  ///        capped by what the header can hold
+  explicit LengthHeaderCodec(const FramesCallback& cb,
+                             int headerLen = 4,
+                             size_t maxFrameLen = 64*1024*1024);
+
+  /// Bind it as the message callback of TcpServer or TcpClient.
+  void onMessage(const TcpConnectionPtr& conn,
+                 Buffer* buf,
+                 Timestamp receiveTime);
+
+  /// Sends the readable bytes of @c payload as one frame,
+  /// the header is prepended in place.
+  void send(const TcpConnectionPtr& conn, Buffer* payload) const;
+
+  /// Sends @c payload as one frame, it's copied once.
+  void send(const TcpConnectionPtr& conn, const StringView& payload) const;
+
+  int headerLen() const { return headerLen_; }
+  size_t maxFrameLen() const { return maxFrameLen_; }
+
+ private:
+  size_t readHeader(const char* p) const;
+
+  FramesCallback framesCallback_;
+  const int headerLen_;
+  const size_t maxFrameLen_;
+};
+
+}
+
+#endif  // MUDUO_NET_LENGTHHEADERCODEC_H
@@ -0,0 +1,95 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "LineCodec.h"
+
+#include <muduo/base/Logging.h>
+#include "Buffer.h"
+#include "TcpConnection.h"
+
+using namespace muduo;
+
+LineCodec::LineCodec(const LinesCallback& cb,
+                     Delimiter delimiter,
+                     size_t maxLineLen)
+  : linesCallback_(cb),
+    delimiter_(delimiter),
+    maxLineLen_(maxLineLen)
+{
+}
+
+void LineCodec::send(const TcpConnectionPtr& conn,
+                     const StringView& line,
+                     Delimiter delimiter)
+{
+  Buffer buf(line.size() + 2);
+  buf.append(line.data(), line.size());
+  buf.append(delimiter == kCRLF ? "\r\n" : "\n", delimiter == kCRLF ? 2 : 1);
+  conn->send(&buf);
+}
+
+void LineCodec::onMessage(const TcpConnectionPtr& conn,
+                          Buffer* buf,
+                          Timestamp receiveTime)
+{
+  ScanState* state = conn->context<ScanState>();
+  if (state == NULL)
+  {
+    // the first message of the connection
+    assert(!conn->hasContext());
+    state = conn->emplaceContext<ScanState>();
+  }
+  splitLines(conn, buf, receiveTime, &state->scanned);
+}
+
+void LineCodec::splitLines(const TcpConnectionPtr& conn,
+                           Buffer* buf,
+                           Timestamp receiveTime,
+                           size_t* scanned)
+{
+  const size_t delimLen = delimiter_ == kCRLF ? 2 : 1;
+  assert(*scanned <= buf->readableBytes());
+  StringView lines[kMaxBatch];
+  int count = 0;
+  const char* start = buf->peek();
+  const char* scan = start + *scanned;
+  const char* eol = NULL;
+  while ((eol = delimiter_ == kCRLF ? buf->findCRLF(scan)
+                                    : buf->findEOL(scan)) != NULL)
+  {
+    lines[count++] = StringView(start, eol - start);
+    start = eol + delimLen;
+    scan = start;
+    if (count == kMaxBatch)
+    {
+      linesCallback_(conn, lines, count, receiveTime);
+      count = 0;
+    }
+  }
+  if (count > 0)
+  {
+    linesCallback_(conn, lines, count, receiveTime);
+  }
+
+  // the views are gone, now consume the lines
+  buf->retrieveUntil(start);
+  const size_t partial = buf->readableBytes();
+  if (partial > maxLineLen_)
+  {
+    LOG_ERROR << "LineCodec::onMessage [" << conn->name()
+              << "] - line longer than " << maxLineLen_;
+    // not shutdown(), the peer could keep sending lines
+    buf->retrieveAll();
+    *scanned = 0;
+    conn->forceClose();
+  }
+  else
+  {
+    // a CR at the end may start the next CRLF
+    *scanned = partial >= delimLen ? partial - (delimLen - 1) : 0;
+  }
+}
@@ -0,0 +1,85 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_LINECODEC_H
+#define MUDUO_NET_LINECODEC_H
+
+#include "Callbacks.h"
+#include "StringView.h"
+
+#include <muduo/base/noncopyable.h>
+
+namespace muduo
+{
+
+class Buffer;
+
+///
+/// Splits the input of one connection into lines.
+///
+/// Every complete line in the input buffer is passed to the callback
+/// in one batch, as views into the buffer without the delimiter.
+/// The codec remembers how far it has scanned, so a partial line is
+/// scanned once, however many reads it takes to complete.
+/// One codec serves all connections of a server, set onMessage() as
+/// their message callback.  It keeps how far it scanned in the context
+/// of each connection, which must be free for it.
+class LineCodec : muduo::noncopyable
+{
+ public:
+  enum Delimiter { kCRLF, kLF };
+
+  /// lines passed to one callback at most
+  static const int kMaxBatch = 16;
+  static const size_t kDefaultMaxLineLen = 64*1024;
+
+  /// The views in @c lines are valid during the call only.
+  typedef boost::function<void (const TcpConnectionPtr&,
+                                const StringView* lines,
+                                int count,
+                                Timestamp)> LinesCallback;
+
+  /// @param maxLineLen a longer partial line closes the connection
+  explicit LineCodec(const LinesCallback& cb,
+                     Delimiter delimiter = kCRLF,
+                     size_t maxLineLen = kDefaultMaxLineLen);
+
+  /// Sends @c line followed by the delimiter, it's copied once.
+  static void send(const TcpConnectionPtr& conn,
+                   const StringView& line,
+                   Delimiter delimiter = kCRLF);
+
+  void onMessage(const TcpConnectionPtr& conn,
+                 Buffer* buf,
+                 Timestamp receiveTime);
+
+  /// Like onMessage(), for callers that keep the scan state themselves.
+  /// @c scanned is the bytes after buf->peek() known not to end a line,
+  /// 0 for a new connection.
+  void splitLines(const TcpConnectionPtr& conn,
+                  Buffer* buf,
+                  Timestamp receiveTime,
+                  size_t* scanned);
+
+  /// Context of a connection, see onMessage().
+  struct ScanState
+  {
+    ScanState() : scanned(0) { }
+    size_t scanned;
+  };
+
+ private:
+  LinesCallback linesCallback_;
+  const Delimiter delimiter_;
+  const size_t maxLineLen_;
+};
+
+}
+
+#endif  // MUDUO_NET_LINECODEC_H
@@ -0,0 +1,115 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "LoopMailbox.h"
+
+#include <muduo/base/Logging.h>
+#include "Channel.h"
+#include "EventLoop.h"
+
+#include <boost/bind.hpp>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+LoopMailbox::LoopMailbox(EventLoop* loop, const MessagesCallback& cb)
+  : loop_(CHECK_NOTNULL(loop)),
+    messagesCallback_(cb),
+    eventFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+    head_(NULL)
+{
+  if (eventFd_ < 0)
+  {
+    LOG_SYSFATAL << "Failed in eventfd";
+  }
+}
+
+LoopMailbox::~LoopMailbox()
+{
+  if (channel_)
+  {
+    loop_->assertInLoopThread();
+    channel_->disableAll();
+    loop_->removeChannel(get_pointer(channel_));
+  }
+  ::close(eventFd_);
+  MailboxNode* message = takeAll();
+  while (message)
+  {
+    MailboxNode* next = message->next;
+    delete message;
+    message = next;
+  }
+}
+
+void LoopMailbox::start()
+{
+  loop_->assertInLoopThread();
+  assert(!channel_);
+  channel_.reset(new Channel(loop_, eventFd_));
+  channel_->setReadCallback(boost::bind(&LoopMailbox::handleRead, this));
+  channel_->enableReading();
+}
+
+void LoopMailbox::post(MailboxNode* message)
+{
+  MailboxNode* head = head_;
+  while (true)
+  {
+    message->next = head;
+    MailboxNode* old = __sync_val_compare_and_swap(&head_, head, message);
+    if (old == head)
+    {
+      break;
+    }
+    head = old;
+  }
+  // one wakeup per batch, the loop takes all of them at once
+  if (head == NULL)
+  {
+    uint64_t one = 1;
+    ssize_t n = ::write(eventFd_, &one, sizeof one);
+    if (n != sizeof one)
+    {
+      LOG_ERROR << "LoopMailbox::post() writes " << n << " bytes instead of 8";
+    }
+  }
+}
+
+MailboxNode* LoopMailbox::takeAll()
+{
+  MailboxNode* latest = __sync_lock_test_and_set(&head_, NULL);
+  // newest first, reverse into posting order
+  MailboxNode* first = NULL;
+  while (latest)
+  {
+    MailboxNode* next = latest->next;
+    latest->next = first;
+    first = latest;
+    latest = next;
+  }
+  return first;
+}
+
+void LoopMailbox::handleRead()
+{
+  loop_->assertInLoopThread();
+  // read before taking, a post after the take writes again
+  uint64_t one = 0;
+  ssize_t n = ::read(eventFd_, &one, sizeof one);
+  if (n != sizeof one)
+  {
+    LOG_ERROR << "LoopMailbox::handleRead() reads " << n << " bytes instead of 8";
+  }
+  MailboxNode* first = takeAll();
+  if (first)
+  {
+    messagesCallback_(first);
+  }
+}
@@ -0,0 +1,72 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_LOOPMAILBOX_H
+#define MUDUO_NET_LOOPMAILBOX_H
+
+#include "EventLoopFwd.h"
+
+#include <muduo/base/noncopyable.h>
+
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace muduo
+{
+
+/// A message of LoopMailbox, derive from it.
+struct MailboxNode
+{
+  MailboxNode() : next(NULL) { }
+  virtual ~MailboxNode() { }
+
+  MailboxNode* next;
+};
+
+///
+/// Passes messages to a loop without locks.
+///
+/// Any thread can post(), the loop gets all messages posted since its
+/// last poll as one list, in posting order.  Posting is a compare and
+/// swap, plus a write to an eventfd if the mailbox was empty, unlike
+/// EventLoop::queueInLoop(), which takes a mutex and copies a functor.
+///
+class LoopMailbox : muduo::noncopyable
+{
+ public:
+  /// Takes the messages and their ownership, @c first is the oldest one,
+  /// follow next.  Called in the loop thread.
+  typedef boost::function<void (MailboxNode* first)> MessagesCallback;
+
+  LoopMailbox(EventLoop* loop, const MessagesCallback& cb);
+  /// Must be called in the loop thread, messages not delivered are deleted.
+  ~LoopMailbox();
+
+  /// Starts delivering.  Must be called in the loop thread.
+  void start();
+
+  /// Thread safe.  The mailbox owns @c message until it's delivered.
+  void post(MailboxNode* message);
+
+  EventLoop* getLoop() const { return loop_; }
+
+ private:
+  void handleRead();
+  MailboxNode* takeAll();
+
+  EventLoop* loop_;
+  MessagesCallback messagesCallback_;
+  int eventFd_;
+  boost::scoped_ptr<Channel> channel_;
+  MailboxNode* head_;  // the latest message, atomic
+};
+
+}
+
+#endif  // MUDUO_NET_LOOPMAILBOX_H
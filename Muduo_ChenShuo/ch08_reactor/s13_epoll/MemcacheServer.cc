@@ -0,0 +1,624 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "MemcacheServer.h"
+
+#include <muduo/base/Logging.h>
+#include "CacheShard.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "LoopMailbox.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <deque>
+
+#include <stdio.h>
+
+using namespace muduo;
+
+namespace
+{
+
+const size_t kMaxLineLen = 2048;
+const int64_t kMaxRelativeExptime = 60*60*24*30;  // as memcached
+
+bool nextToken(StringView* line, StringView* token)
+{
+  while (!line->empty() && (*line)[0] == ' ')
+  {
+    line->removePrefix(1);
+  }
+  size_t len = 0;
+  while (len < line->size() && (*line)[len] != ' ')
+  {
+    ++len;
+  }
+  *token = StringView(line->data(), len);
+  line->removePrefix(len);
+  return len > 0;
+}
+
+bool parseInt64(const StringView& s, int64_t* value)
+{
+  size_t i = 0;
+  bool negative = s.size() > 1 && s[0] == '-';
+  if (negative)
+  {
+    ++i;
+  }
+  if (i == s.size() || s.size() > 19)
+  {
+    return false;
+  }
+  int64_t v = 0;
+  for (; i < s.size(); ++i)
+  {
+    if (s[i] < '0' || s[i] > '9')
+    {
+      return false;
+    }
+    v = v * 10 + (s[i] - '0');
+  }
+  *value = negative ? -v : v;
+  return true;
+}
+
+time_t toExptime(int64_t exptime, time_t now)
+{
+  if (exptime == 0)
+  {
+    return 0;
+  }
+  else if (exptime < 0)
+  {
+    return 1;  // expired already
+  }
+  else if (exptime > kMaxRelativeExptime)
+  {
+    return static_cast<time_t>(exptime);
+  }
+  return now + static_cast<time_t>(exptime);
+}
+
+const char* setReply(CacheShard::SetResult result)
+{
+  switch (result)
+  {
+    case CacheShard::kStored:
+      return "STORED\r\n";
+    case CacheShard::kTooLarge:
+      return "SERVER_ERROR object too large for cache\r\n";
+    case CacheShard::kOutOfMemory:
+      return "SERVER_ERROR out of memory storing object\r\n";
+  }
+  return "SERVER_ERROR\r\n";
+}
+
+const char* deleteReply(bool deleted)
+{
+  return deleted ? "DELETED\r\n" : "NOT_FOUND\r\n";
+}
+
+// Out is Buffer or std::string
+template<typename Out>
+void appendValue(Out* out, const CacheShard::Value& value)
+{
+  char header[64];
+  out->append("VALUE ", 6);
+  out->append(value.key.data(), value.key.size());
+  int n = snprintf(header, sizeof header, " %u %zu\r\n",
+                   value.flags, value.data.size());
+  out->append(header, n);
+  out->append(value.data.data(), value.data.size());
+  out->append("\r\n", 2);
+}
+
+}
+
+struct MemcacheServer::Shard : muduo::noncopyable
+{
+  Shard(MemcacheServer* server, EventLoop* l, size_t memoryLimit)
+    : loop(l),
+      cache(memoryLimit),
+      mailbox(l, boost::bind(&MemcacheServer::onMailbox, server, this, _1))
+  { }
+
+  EventLoop* loop;
+  CacheShard cache;
+  LoopMailbox mailbox;
+};
+
+// a request for the shard of another loop, then its reply on the way back
+struct MemcacheServer::Request : MailboxNode
+{
+  enum Command { kGet, kSet, kDelete };
+
+  Request(Command c, const StringView& k, uint64_t h, time_t n)
+    : command(c), noreply(false), answered(false),
+      key(k.data(), k.size()), hash(h), flags(0), exptime(0), now(n), seq(0)
+  { }
+
+  void execute(CacheShard* cache)
+  {
+    switch (command)
+    {
+      case kGet:
+        {
+          CacheShard::Value value;
+          if (cache->get(key, hash, now, &value))
+          {
+            appendValue(&data, value);
+          }
+        }
+        break;
+      case kSet:
+        data = setReply(cache->set(key, hash, flags, exptime, data));
+        break;
+      case kDelete:
+        data = deleteReply(cache->remove(key, hash));
+        break;
+    }
+  }
+
+  Command command;
+  bool noreply;
+  bool answered;
+  std::string key;
+  uint64_t hash;
+  uint32_t flags;
+  time_t exptime;
+  time_t now;
+  std::string data;    // of set, then the reply
+  SessionPtr session;  // NULL with noreply
+  uint64_t seq;        // of the reply in its session
+};
+
+// one per connection, only used in its loop
+struct MemcacheServer::Session : muduo::noncopyable
+{
+  struct Reply
+  {
+    std::string data;
+    bool ready;
+  };
+
+  Session(Shard* s, const TcpConnectionPtr& c)
+    : shard(s), conn(c), firstSeq(0), output(0), flushQueued(false)
+  { }
+
+  /// Appends a reply, after the ones waiting for other shards.
+  void append(const char* data, size_t len)
+  {
+    if (replies.empty())
+    {
+      output.append(data, len);
+    }
+    else
+    {
+      Reply reply = { std::string(data, len), true };
+      replies.push_back(reply);
+    }
+  }
+
+  void append(const char* str) { append(str, strlen(str)); }
+
+  /// Keeps the place of a reply from another shard, returns its seq.
+  uint64_t reserve()
+  {
+    Reply reply = { std::string(), false };
+    replies.push_back(reply);
+    return firstSeq + replies.size() - 1;
+  }
+
+  void fill(uint64_t seq, std::string* data)
+  {
+    Reply& reply = replies[seq - firstSeq];
+    reply.data.swap(*data);
+    reply.ready = true;
+    while (!replies.empty() && replies.front().ready)
+    {
+      output.append(replies.front().data);
+      replies.pop_front();
+      ++firstSeq;
+    }
+  }
+
+  void flush()
+  {
+    if (output.readableBytes() > 0)
+    {
+      TcpConnectionPtr c(conn.lock());
+      if (c)
+      {
+        c->send(&output);
+      }
+      output.retrieveAll();
+    }
+  }
+
+  Shard* shard;  // of its loop
+  boost::weak_ptr<TcpConnection> conn;
+  std::deque<Reply> replies;  // from firstSeq, waiting for other shards
+  uint64_t firstSeq;
+  Buffer output;  // replies in order, sent by flush()
+  bool flushQueued;
+};
+
+MemcacheServer::MemcacheServer(EventLoop* loop,
+                               const InetAddress& listenAddr,
+                               size_t memoryLimit)
+  : server_(loop, listenAddr),
+    memoryLimit_(memoryLimit),
+    cond_(mutex_),
+    destroying_(0)
+{
+  server_.setConnectionCallback(
+      boost::bind(&MemcacheServer::onConnection, this, _1));
+  server_.setMessageCallback(
+      boost::bind(&MemcacheServer::onMessage, this, _1, _2, _3));
+}
+
+MemcacheServer::~MemcacheServer()
+{
+  std::vector<Shard*> remote;
+  for (size_t i = 0; i < shards_.size(); ++i)
+  {
+    if (shards_[i]->loop->isInLoopThread())
+    {
+      delete shards_[i];
+    }
+    else
+    {
+      remote.push_back(shards_[i]);
+    }
+  }
+  {
+    MutexLockGuard lock(mutex_);
+    destroying_ = static_cast<int>(remote.size());
+  }
+  // each mailbox goes in its own loop
+  for (size_t i = 0; i < remote.size(); ++i)
+  {
+    remote[i]->loop->runInLoop(
+        boost::bind(&MemcacheServer::destroyShard, this, remote[i]));
+  }
+  MutexLockGuard lock(mutex_);
+  while (destroying_ > 0)
+  {
+    cond_.wait();
+  }
+}
+
+void MemcacheServer::destroyShard(Shard* shard)
+{
+  delete shard;
+  MutexLockGuard lock(mutex_);
+  if (--destroying_ == 0)
+  {
+    cond_.notifyAll();
+  }
+}
+
+void MemcacheServer::start()
+{
+  server_.start();
+  std::vector<EventLoop*> loops = server_.threadPool()->getAllLoops();
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    Shard* shard = new Shard(this, loops[i], memoryLimit_ / loops.size());
+    shards_.push_back(shard);
+    loops[i]->runInLoop(boost::bind(&LoopMailbox::start, &shard->mailbox));
+  }
+}
+
+MemcacheServer::Shard* MemcacheServer::shardOf(uint64_t hash) const
+{
+  // the low bits pick the bucket in the shard
+  return shards_[(hash >> 32) % shards_.size()];
+}
+
+void MemcacheServer::onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    Shard* shard = NULL;
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+      if (shards_[i]->loop == conn->getLoop())
+      {
+        shard = shards_[i];
+      }
+    }
+    assert(shard != NULL);
+    conn->setTcpNoDelay(true);
+    // shared with the requests waiting for other shards
+    conn->setContext(boost::make_shared<Session>(shard, conn));
+  }
+}
+
+void MemcacheServer::onMessage(const TcpConnectionPtr& conn,
+                               Buffer* buf,
+                               Timestamp receiveTime)
+{
+  const SessionPtr& session = *conn->context<SessionPtr>();
+  if (!conn->connected())
+  {
+    // closing, drop the requests behind it
+    buf->retrieveAll();
+    return;
+  }
+  time_t now = static_cast<time_t>(receiveTime.microSecondsSinceEpoch()
+                                   / Timestamp::kMicroSecondsPerSecond);
+  ParseResult result = kContinue;
+  while (result == kContinue)
+  {
+    const char* crlf = buf->findCRLF();
+    if (crlf == NULL)
+    {
+      if (buf->readableBytes() > kMaxLineLen)
+      {
+        session->append("CLIENT_ERROR line too long\r\n");
+        result = kClose;
+      }
+      break;
+    }
+    result = processLine(session, buf, crlf, now);
+  }
+  session->flush();
+  if (result == kClose)
+  {
+    buf->retrieveAll();
+    conn->shutdown();
+  }
+}
+
+MemcacheServer::ParseResult
+MemcacheServer::processLine(const SessionPtr& session,
+                            Buffer* buf,
+                            const char* crlf,
+                            time_t now)
+{
+  StringView line(buf->peek(), crlf - buf->peek());
+  StringView command;
+  nextToken(&line, &command);
+
+  if (command == "get")
+  {
+    StringView keys = line;
+    StringView key;
+    bool valid = false;
+    while (nextToken(&keys, &key))
+    {
+      valid = key.size() <= CacheShard::kMaxKeyLen;
+      if (!valid)
+      {
+        break;
+      }
+    }
+    if (!valid)
+    {
+      session->append("CLIENT_ERROR bad command line format\r\n");
+    }
+    else
+    {
+      while (nextToken(&line, &key))
+      {
+        processGet(session, key, now);
+      }
+      session->append("END\r\n");
+    }
+    buf->retrieveUntil(crlf + 2);
+    return kContinue;
+  }
+  else if (command == "set")
+  {
+    return processSet(session, line, buf, crlf, now);
+  }
+  else if (command == "delete")
+  {
+    StringView key;
+    StringView noreply;
+    if (!nextToken(&line, &key) || key.size() > CacheShard::kMaxKeyLen)
+    {
+      session->append("CLIENT_ERROR bad command line format\r\n");
+      buf->retrieveUntil(crlf + 2);
+      return kContinue;
+    }
+    nextToken(&line, &noreply);
+    if (noreply == "0")  // an old time argument
+    {
+      nextToken(&line, &noreply);
+    }
+    uint64_t hash = CacheShard::hashKey(key);
+    Shard* shard = shardOf(hash);
+    if (shard == session->shard)
+    {
+      const char* reply = deleteReply(shard->cache.remove(key, hash));
+      if (noreply != "noreply")
+      {
+        session->append(reply);
+      }
+    }
+    else
+    {
+      Request* request = new Request(Request::kDelete, key, hash, now);
+      forward(session, shard, request, noreply == "noreply");
+    }
+    buf->retrieveUntil(crlf + 2);
+    return kContinue;
+  }
+  else if (command == "version")
+  {
+    session->append("VERSION 1.4.0-muduo\r\n");
+    buf->retrieveUntil(crlf + 2);
+    return kContinue;
+  }
+  else if (command == "quit")
+  {
+    return kClose;
+  }
+  session->append("ERROR\r\n");
+  buf->retrieveUntil(crlf + 2);
+  return kContinue;
+}
+
+void MemcacheServer::processGet(const SessionPtr& session,
+                                const StringView& key,
+                                time_t now)
+{
+  uint64_t hash = CacheShard::hashKey(key);
+  Shard* shard = shardOf(hash);
+  if (shard == session->shard)
+  {
+    CacheShard::Value value;
+    if (shard->cache.get(key, hash, now, &value))
+    {
+      if (session->replies.empty())
+      {
+        // straight from the item to the output
+        appendValue(&session->output, value);
+      }
+      else
+      {
+        std::string reply;
+        appendValue(&reply, value);
+        session->append(reply.data(), reply.size());
+      }
+    }
+  }
+  else
+  {
+    forward(session, shard, new Request(Request::kGet, key, hash, now), false);
+  }
+}
+
+// set <key> <flags> <exptime> <bytes> [noreply]\r\n<data>\r\n
+MemcacheServer::ParseResult
+MemcacheServer::processSet(const SessionPtr& session,
+                           StringView args,
+                           Buffer* buf,
+                           const char* crlf,
+                           time_t now)
+{
+  StringView key, flagsArg, exptimeArg, bytesArg, noreply;
+  int64_t flags = 0;
+  int64_t exptime = 0;
+  int64_t bytes = 0;
+  if (!nextToken(&args, &key) || key.size() > CacheShard::kMaxKeyLen
+      || !nextToken(&args, &flagsArg) || !parseInt64(flagsArg, &flags)
+      || flags < 0 || flags > 0xFFFFFFFFLL
+      || !nextToken(&args, &exptimeArg) || !parseInt64(exptimeArg, &exptime)
+      || !nextToken(&args, &bytesArg) || !parseInt64(bytesArg, &bytes)
+      || bytes < 0)
+  {
+    // can't tell where the data ends
+    session->append("CLIENT_ERROR bad command line format\r\n");
+    return kClose;
+  }
+  if (static_cast<size_t>(bytes) > CacheShard::kPageSize)
+  {
+    session->append("SERVER_ERROR object too large for cache\r\n");
+    return kClose;
+  }
+  nextToken(&args, &noreply);
+
+  const char* data = crlf + 2;
+  if (static_cast<size_t>(buf->beginWrite() - data) < static_cast<size_t>(bytes) + 2)
+  {
+    return kWait;
+  }
+  if (data[bytes] != '\r' || data[bytes + 1] != '\n')
+  {
+    session->append("CLIENT_ERROR bad data chunk\r\n");
+    return kClose;
+  }
+
+  StringView value(data, bytes);
+  uint64_t hash = CacheShard::hashKey(key);
+  Shard* shard = shardOf(hash);
+  if (shard == session->shard)
+  {
+    const char* reply = setReply(shard->cache.set(
+        key, hash, static_cast<uint32_t>(flags), toExptime(exptime, now), value));
+    if (noreply != "noreply")
+    {
+      session->append(reply);
+    }
+  }
+  else
+  {
+    Request* request = new Request(Request::kSet, key, hash, now);
+    request->flags = static_cast<uint32_t>(flags);
+    request->exptime = toExptime(exptime, now);
+    request->data.assign(value.data(), value.size());
+    forward(session, shard, request, noreply == "noreply");
+  }
+  buf->retrieveUntil(data + bytes + 2);
+  return kContinue;
+}
+
+void MemcacheServer::forward(const SessionPtr& session,
+                             Shard* shard,
+                             Request* request,
+                             bool noreply)
+{
+  request->noreply = noreply;
+  if (!noreply)
+  {
+    request->session = session;
+    request->seq = session->reserve();
+  }
+  numForwarded_.increment();
+  shard->mailbox.post(request);
+}
+
+void MemcacheServer::onMailbox(Shard* shard, MailboxNode* first)
+{
+  // sessions with replies, flushed once after all messages
+  std::vector<SessionPtr> sessions;
+  MailboxNode* node = first;
+  while (node)
+  {
+    MailboxNode* next = node->next;
+    Request* request = static_cast<Request*>(node);
+    if (!request->answered)
+    {
+      request->execute(&shard->cache);
+      if (request->noreply)
+      {
+        delete request;
+      }
+      else
+      {
+        request->answered = true;
+        request->session->shard->mailbox.post(request);
+      }
+    }
+    else
+    {
+      Session* session = get_pointer(request->session);
+      assert(session->shard == shard);
+      session->fill(request->seq, &request->data);
+      if (!session->flushQueued)
+      {
+        session->flushQueued = true;
+        sessions.push_back(request->session);
+      }
+      delete request;
+    }
+    node = next;
+  }
+
+  for (size_t i = 0; i < sessions.size(); ++i)
+  {
+    sessions[i]->flushQueued = false;
+    sessions[i]->flush();
+  }
+}
@@ -0,0 +1,102 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_MEMCACHESERVER_H
+#define MUDUO_NET_MEMCACHESERVER_H
+
+#include "StringView.h"
+#include "TcpServer.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Condition.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/base/noncopyable.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+namespace muduo
+{
+
+struct MailboxNode;
+
+///
+/// In-memory cache speaking the memcached text protocol:
+/// get with one or more keys, set, delete, version and quit.
+///
+/// Each IO loop owns a CacheShard, and a key belongs to the shard chosen
+/// by its hash.  A request for a key of another shard is posted to the
+/// LoopMailbox of that loop, its reply comes back the same way.
+/// Replies go out in request order, however their shards answer.
+///
+class MemcacheServer : muduo::noncopyable
+{
+ public:
+  /// @param memoryLimit for values, split evenly over the shards
+  MemcacheServer(EventLoop* loop,
+                 const InetAddress& listenAddr,
+                 size_t memoryLimit);
+  /// Must be called in the loop thread, with the IO loops running.
+  ~MemcacheServer();
+
+  /// IO threads, one shard each, see TcpServer::setThreadNum().
+  /// Must be called before start().
+  void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+  /// Must be called in the loop thread.
+  void start();
+
+  /// Requests that went to the shard of another loop.  Thread safe.
+  int64_t numForwarded() const { return numForwarded_.get(); }
+
+ private:
+  struct Shard;
+  struct Session;
+  struct Request;
+  typedef boost::shared_ptr<Session> SessionPtr;
+
+  enum ParseResult { kContinue, kWait, kClose };
+
+  void onConnection(const TcpConnectionPtr& conn);
+  void onMessage(const TcpConnectionPtr& conn,
+                 Buffer* buf,
+                 Timestamp receiveTime);
+  void onMailbox(Shard* shard, MailboxNode* first);
+  ParseResult processLine(const SessionPtr& session,
+                          Buffer* buf,
+                          const char* crlf,
+                          time_t now);
+  void processGet(const SessionPtr& session,
+                  const StringView& key,
+                  time_t now);
+  ParseResult processSet(const SessionPtr& session,
+                         StringView args,
+                         Buffer* buf,
+                         const char* crlf,
+                         time_t now);
+  void forward(const SessionPtr& session,
+               Shard* shard,
+               Request* request,
+               bool noreply);
+  Shard* shardOf(uint64_t hash) const;
+  void destroyShard(Shard* shard);
+
+  TcpServer server_;
+  const size_t memoryLimit_;
+  std::vector<Shard*> shards_;  // fixed after start()
+  mutable AtomicInt64 numForwarded_;
+  MutexLock mutex_;
+  Condition cond_;
+  int destroying_;  // @GuardedBy mutex_
+};
+
+}
+
+#endif  // MUDUO_NET_MEMCACHESERVER_H
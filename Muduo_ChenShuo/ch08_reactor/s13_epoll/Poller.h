@@ -8,30 +8,36 @@
 #ifndef MUDUO_NET_POLLER_H
 #define MUDUO_NET_POLLER_H
 
-#include <map>
 #include <vector>
 
+#include <muduo/base/Logging.h>
 #include <muduo/base/Timestamp.h>
-#include "EventLoop.h"
+#include "Channel.h"
+#include "ChannelTable.h"
 
-struct pollfd;
+#include <algorithm>
+
+#include <assert.h>
+#include <poll.h>
 
 namespace muduo
 {
 
-class Channel;
-
 ///
-/// IO Multiplexing with poll(2).
+/// IO Multiplexing with poll(2), the poller policy of BasicEventLoop.
 ///
 /// This class doesn't own the Channel objects.
-class Poller : muduo::noncopyable
+template <typename Loop>
+class BasicPoller : muduo::noncopyable
 {
  public:
-  typedef std::vector<Channel*> ChannelList;
+  typedef BasicChannel<Loop> ChannelT;
+  typedef std::vector<ChannelT*> ChannelList;
 
-  Poller(EventLoop* loop);
-  ~Poller();
+  BasicPoller(Loop* loop)
+    : ownerLoop_(loop)
+  {
+  }
 
   /// Polls the I/O events.
   /// Must be called in the loop thread.
@@ -39,10 +45,13 @@ class Poller : muduo::noncopyable
 
   /// Changes the interested I/O events.
   /// Must be called in the loop thread.
-  void updateChannel(Channel* channel);
+  void updateChannel(ChannelT* channel);
   /// Remove the channel, when it destructs.
   /// Must be called in the loop thread.
-  void removeChannel(Channel* channel);
+  void removeChannel(ChannelT* channel);
+
+  /// poll(2) keeps no interest set in the kernel, always 0.
+  int64_t numCtlCalls() const { return 0; }
 
   void assertInLoopThread() { ownerLoop_->assertInLoopThread(); }
 
@@ -51,12 +60,106 @@ class Poller : muduo::noncopyable
                           ChannelList* activeChannels) const;
 
   typedef std::vector<struct pollfd> PollFdList;
-  typedef std::map<int, Channel*> ChannelMap;
 
-  EventLoop* ownerLoop_;
+  Loop* ownerLoop_;
   PollFdList pollfds_;
-  ChannelMap channels_;
+  ChannelTable<ChannelT> channels_;
 };
 
+typedef BasicPoller<EventLoop> Poller;
+
+template <typename Loop>
+Timestamp BasicPoller<Loop>::poll(int timeoutMs, ChannelList* activeChannels)
+{
+  // XXX pollfds_ shouldn't change
+  int numEvents = ::poll(&*pollfds_.begin(), pollfds_.size(), timeoutMs);
+  Timestamp now(Timestamp::now());
+  if (numEvents > 0) {
+    LOG_TRACE << numEvents << " events happended";
+    fillActiveChannels(numEvents, activeChannels);
+  } else if (numEvents == 0) {
+    LOG_TRACE << " nothing happended";
+  } else {
+    LOG_SYSERR << "Poller::poll()";
+  }
+  return now;
+}
+
+template <typename Loop>
+void BasicPoller<Loop>::fillActiveChannels(int numEvents,
+                                           ChannelList* activeChannels) const
+{
+  for (typename PollFdList::const_iterator pfd = pollfds_.begin();
+      pfd != pollfds_.end() && numEvents > 0; ++pfd)
+  {
+    if (pfd->revents > 0)
+    {
+      --numEvents;
+      ChannelT* channel = channels_.find(pfd->fd);
+      assert(channel != NULL);
+      assert(channel->fd() == pfd->fd);
+      channel->set_revents(pfd->revents);
+      // pfd->revents = 0;
+      activeChannels->push_back(channel);
+    }
+  }
+}
+
+template <typename Loop>
+void BasicPoller<Loop>::updateChannel(ChannelT* channel)
+{
+  assertInLoopThread();
+  LOG_TRACE << "fd = " << channel->fd() << " events = " << channel->events();
+  if (channel->index() < 0) {
+    // a new one, add to pollfds_
+    struct pollfd pfd;
+    pfd.fd = channel->fd();
+    pfd.events = static_cast<short>(channel->events());
+    pfd.revents = 0;
+    pollfds_.push_back(pfd);
+    int idx = static_cast<int>(pollfds_.size())-1;
+    channel->set_index(idx);
+    channels_.insert(channel);
+  } else {
+    // update existing one
+    assert(channels_.find(channel->fd()) == channel);
+    int idx = channel->index();
+    assert(0 <= idx && idx < static_cast<int>(pollfds_.size()));
+    struct pollfd& pfd = pollfds_[idx];
+    assert(pfd.fd == channel->fd() || pfd.fd == -channel->fd()-1);
+    pfd.events = static_cast<short>(channel->events());
+    pfd.revents = 0;
+    if (channel->isNoneEvent()) {
+      // ignore this pollfd
+      pfd.fd = -channel->fd()-1;
+    }
+  }
+}
+
+template <typename Loop>
+void BasicPoller<Loop>::removeChannel(ChannelT* channel)
+{
+  assertInLoopThread();
+  LOG_TRACE << "fd = " << channel->fd();
+  assert(channel->isNoneEvent());
+  int idx = channel->index();
+  assert(0 <= idx && idx < static_cast<int>(pollfds_.size()));
+  const struct pollfd& pfd = pollfds_[idx]; (void)pfd;
+  assert(pfd.fd == -channel->fd()-1 && pfd.events == channel->events());
+  channels_.erase(channel);
+  if (implicit_cast<size_t>(idx) == pollfds_.size()-1) {
+    pollfds_.pop_back();
+  } else {
+    int channelAtEnd = pollfds_.back().fd;
+    iter_swap(pollfds_.begin()+idx, pollfds_.end()-1);
+    if (channelAtEnd < 0) {
+      channelAtEnd = -channelAtEnd-1;
+    }
+    channels_.find(channelAtEnd)->set_index(idx);
+    pollfds_.pop_back();
+  }
+  channel->set_index(-1);
+}
+
 }
 #endif  // MUDUO_NET_POLLER_H
@@ -0,0 +1,224 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "PubSubHub.h"
+
+#include <muduo/base/Logging.h>
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+
+#include <boost/bind.hpp>
+
+#include <map>
+#include <set>
+
+using namespace muduo;
+
+// subscriptions of the connections in one IO loop, only used in that loop
+struct PubSubHub::LoopHub : muduo::noncopyable
+{
+  typedef std::set<TcpConnectionPtr> Subscribers;
+  typedef std::map<std::string, Subscribers> TopicMap;
+  typedef std::map<TcpConnectionPtr, std::set<std::string> > SubscriptionMap;
+
+  explicit LoopHub(EventLoop* l)
+    : loop(l)
+  { }
+
+  void subscribe(const TcpConnectionPtr& conn, const std::string& topic)
+  {
+    topics[topic].insert(conn);
+    subscriptions[conn].insert(topic);
+  }
+
+  void unsubscribe(const TcpConnectionPtr& conn, const std::string& topic)
+  {
+    TopicMap::iterator it = topics.find(topic);
+    if (it != topics.end())
+    {
+      it->second.erase(conn);
+      if (it->second.empty())
+      {
+        topics.erase(it);
+      }
+    }
+    SubscriptionMap::iterator sub = subscriptions.find(conn);
+    if (sub != subscriptions.end())
+    {
+      sub->second.erase(topic);
+      if (sub->second.empty())
+      {
+        subscriptions.erase(sub);
+      }
+    }
+  }
+
+  void unsubscribeAll(const TcpConnectionPtr& conn)
+  {
+    SubscriptionMap::iterator sub = subscriptions.find(conn);
+    if (sub != subscriptions.end())
+    {
+      // copy, unsubscribe() erases it
+      std::set<std::string> subscribed = sub->second;
+      for (std::set<std::string>::iterator it = subscribed.begin();
+           it != subscribed.end(); ++it)
+      {
+        unsubscribe(conn, *it);
+      }
+    }
+  }
+
+  EventLoop* loop;
+  TopicMap topics;
+  SubscriptionMap subscriptions;
+};
+
+PubSubHub::PubSubHub(EventLoop* loop, const InetAddress& listenAddr)
+  : loop_(CHECK_NOTNULL(loop)),
+    server_(loop, listenAddr)
+{
+  server_.setConnectionCallback(
+      boost::bind(&PubSubHub::onConnection, this, _1));
+  server_.setMessageCallback(
+      boost::bind(&PubSubHub::onMessage, this, _1, _2, _3));
+}
+
+PubSubHub::~PubSubHub()
+{
+}
+
+void PubSubHub::setThreadNum(int numThreads)
+{
+  server_.setThreadNum(numThreads);
+}
+
+void PubSubHub::start()
+{
+  loop_->assertInLoopThread();
+  assert(hubs_.empty());
+  server_.start();
+  std::vector<EventLoop*> loops = server_.threadPool()->getAllLoops();
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    hubs_.push_back(new LoopHub(loops[i]));
+  }
+}
+
+void PubSubHub::publish(const std::string& topic, const std::string& content)
+{
+  // serialized once, shared by all subscribers
+  std::string* message = new std::string;
+  message->reserve(topic.size() + content.size() + 7);
+  message->append("pub ");
+  message->append(topic);
+  message->append(" ");
+  message->append(content);
+  message->append("\r\n");
+  PayloadPtr payload(message);
+
+  published_.increment();
+  for (size_t i = 0; i < hubs_.size(); ++i)
+  {
+    LoopHub* hub = &hubs_[i];
+    hub->loop->runInLoop(
+        boost::bind(&PubSubHub::publishInLoop, this, hub, topic, payload));
+  }
+}
+
+void PubSubHub::publishInLoop(LoopHub* hub,
+                              const std::string& topic,
+                              const PayloadPtr& payload)
+{
+  hub->loop->assertInLoopThread();
+  LoopHub::TopicMap::iterator it = hub->topics.find(topic);
+  if (it == hub->topics.end())
+  {
+    return;
+  }
+  const LoopHub::Subscribers& subscribers = it->second;
+  for (LoopHub::Subscribers::const_iterator conn = subscribers.begin();
+       conn != subscribers.end(); ++conn)
+  {
+    (*conn)->send(payload);
+  }
+  delivered_.add(subscribers.size());
+}
+
+PubSubHub::LoopHub* PubSubHub::findHub(EventLoop* loop)
+{
+  for (size_t i = 0; i < hubs_.size(); ++i)
+  {
+    if (hubs_[i].loop == loop)
+    {
+      return &hubs_[i];
+    }
+  }
+  assert(false);
+  return NULL;
+}
+
+void PubSubHub::onConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    findHub(conn->getLoop())->unsubscribeAll(conn);
+  }
+}
+
+void PubSubHub::onMessage(const TcpConnectionPtr& conn,
+                          Buffer* buf,
+                          Timestamp)
+{
+  LoopHub* hub = findHub(conn->getLoop());
+  const char* crlf = NULL;
+  while ((crlf = buf->findCRLF()) != NULL)
+  {
+    std::string line(buf->peek(), crlf);
+    buf->retrieveUntil(crlf + 2);
+
+    std::string::size_type space = line.find(' ');
+    std::string command = line.substr(0, space);
+    std::string topic;
+    std::string content;
+    if (space != std::string::npos)
+    {
+      std::string::size_type end = line.find(' ', space + 1);
+      topic = line.substr(space + 1, end - space - 1);
+      if (end != std::string::npos)
+      {
+        content = line.substr(end + 1);
+      }
+    }
+
+    if (topic.empty())
+    {
+      LOG_ERROR << "PubSubHub::onMessage [" << conn->name()
+                << "] - bad request " << line;
+      conn->shutdown();
+      break;
+    }
+    else if (command == "sub")
+    {
+      hub->subscribe(conn, topic);
+    }
+    else if (command == "unsub")
+    {
+      hub->unsubscribe(conn, topic);
+    }
+    else if (command == "pub")
+    {
+      publish(topic, content);
+    }
+    else
+    {
+      LOG_ERROR << "PubSubHub::onMessage [" << conn->name()
+                << "] - unknown command " << command;
+      conn->shutdown();
+      break;
+    }
+  }
+}
@@ -0,0 +1,74 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_NET_PUBSUBHUB_H
+#define MUDUO_NET_PUBSUBHUB_H
+
+#include "TcpServer.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/noncopyable.h>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+namespace muduo
+{
+
+///
+/// Topic publish/subscribe hub on top of TcpServer.
+///
+/// Line protocol, from clients:
+///   sub <topic>\r\n
+///   unsub <topic>\r\n
+///   pub <topic> <content>\r\n
+/// to subscribers:
+///   pub <topic> <content>\r\n
+///
+/// Subscriptions are kept by the IO loop of their connection.
+/// A message is serialized once, and one functor per IO loop queues
+/// the same payload to every subscriber of the topic in that loop.
+class PubSubHub : muduo::noncopyable
+{
+ public:
+  PubSubHub(EventLoop* loop, const InetAddress& listenAddr);
+  ~PubSubHub();  // force out-line dtor, for LoopHub.
+
+  /// Must be called before @c start, see TcpServer::setThreadNum().
+  void setThreadNum(int numThreads);
+
+  /// Starts the hub, must be called once in loop's thread.
+  void start();
+
+  /// Publishes @c content to all subscribers of @c topic.
+  /// Thread safe.
+  void publish(const std::string& topic, const std::string& content);
+
+  /// Number of messages published, and of sends to subscribers.
+  /// Thread safe.
+  int64_t numPublished() { return published_.get(); }
+  int64_t numDelivered() { return delivered_.get(); }
+
+ private:
+  struct LoopHub;
+
+  void onConnection(const TcpConnectionPtr& conn);
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp);
+  void publishInLoop(LoopHub* hub,
+                     const std::string& topic,
+                     const PayloadPtr& payload);
+  LoopHub* findHub(EventLoop* loop);
+
+  EventLoop* loop_;
+  // destroyed after server_, whose loops use them
+  boost::ptr_vector<LoopHub> hubs_;
+  TcpServer server_;
+  AtomicInt64 published_;
+  AtomicInt64 delivered_;
+};
+
+}
+
+#endif  // MUDUO_NET_PUBSUBHUB_H
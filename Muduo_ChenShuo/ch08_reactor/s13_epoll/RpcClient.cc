@@ -0,0 +1,160 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "RpcClient.h"
+
+#include <muduo/base/Logging.h>
+#include "EventLoop.h"
+
+#include <boost/bind.hpp>
+
+using namespace muduo;
+
+RpcClient::RpcClient(EventLoop* loop, const InetAddress& serverAddr)
+  : loop_(CHECK_NOTNULL(loop)),
+    client_(loop, serverAddr),
+    codec_(boost::bind(&RpcClient::onFrames, this, _1, _2, _3, _4),
+           rpc::kLengthHeaderLen, rpc::kMaxFrameLen),
+    nextRequestId_(1)
+{
+  client_.setConnectionCallback(
+      boost::bind(&RpcClient::onConnection, this, _1));
+  client_.setMessageCallback(
+      boost::bind(&LengthHeaderCodec::onMessage, &codec_, _1, _2, _3));
+}
+
+RpcClient::~RpcClient()
+{
+  // calls in flight are dropped without their callbacks
+  for (CallMap::iterator it = pending_.begin(); it != pending_.end(); ++it)
+  {
+    loop_->cancel(it->second.deadline);
+  }
+}
+
+void RpcClient::call(uint32_t methodId,
+                     const StringView& request,
+                     double timeoutSeconds,
+                     const ResponseCallback& cb)
+{
+  loop_->runInLoop(
+      boost::bind(&RpcClient::callInLoop, this, methodId,  // FIXME: unsafe
+                  std::string(request.data(), request.size()),
+                  timeoutSeconds, cb));
+}
+
+void RpcClient::callInLoop(uint32_t methodId,
+                           const std::string& request,
+                           double timeoutSeconds,
+                           const ResponseCallback& cb)
+{
+  loop_->assertInLoopThread();
+  if (!connection_)
+  {
+    cb(kRpcNotConnected, StringView());
+    return;
+  }
+
+  uint64_t requestId = nextRequestId_++;
+  Call& call = pending_[requestId];
+  call.cb = cb;
+  call.deadline = loop_->runAfter(
+      timeoutSeconds, boost::bind(&RpcClient::timeout, this, requestId));
+
+  if (output_.readableBytes() == 0)
+  {
+    // after the other calls of this iteration
+    loop_->queueInLoop(boost::bind(&RpcClient::flush, this));
+  }
+  size_t mark = rpc::beginFrame(&output_, methodId, requestId);
+  output_.append(request);
+  rpc::endFrame(&output_, mark);
+}
+
+void RpcClient::flush()
+{
+  if (connection_ && output_.readableBytes() > 0)
+  {
+    connection_->send(&output_);
+  }
+  output_.retrieveAll();
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    connection_ = conn;
+  }
+  else
+  {
+    connection_.reset();
+    output_.retrieveAll();
+    failAll(kRpcConnectionLost);
+  }
+  if (connectionCallback_)
+  {
+    connectionCallback_(conn);
+  }
+}
+
+void RpcClient::onFrames(const TcpConnectionPtr& conn,
+                         const StringView* frames,
+                         int count,
+                         Timestamp)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    uint32_t status = 0;
+    uint64_t requestId = 0;
+    StringView response;
+    if (!rpc::parseFrame(frames[i], &status, &requestId, &response))
+    {
+      LOG_ERROR << "RpcClient::onFrames [" << conn->name()
+                << "] - frame too short";
+      conn->forceClose();
+      break;
+    }
+
+    CallMap::iterator it = pending_.find(requestId);
+    if (it == pending_.end())
+    {
+      // timed out already
+      continue;
+    }
+    loop_->cancel(it->second.deadline);
+    ResponseCallback cb;
+    cb.swap(it->second.cb);
+    pending_.erase(it);
+    cb(static_cast<RpcStatus>(status), response);
+  }
+}
+
+void RpcClient::timeout(uint64_t requestId)
+{
+  CallMap::iterator it = pending_.find(requestId);
+  if (it != pending_.end())
+  {
+    ResponseCallback cb;
+    cb.swap(it->second.cb);
+    pending_.erase(it);
+    cb(kRpcDeadlineExceeded, StringView());
+  }
+}
+
+void RpcClient::failAll(RpcStatus status)
+{
+  CallMap calls;
+  calls.swap(pending_);
+  for (CallMap::iterator it = calls.begin(); it != calls.end(); ++it)
+  {
+    loop_->cancel(it->second.deadline);
+    it->second.cb(status, StringView());
+  }
+}
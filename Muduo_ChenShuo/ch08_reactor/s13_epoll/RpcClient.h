@@ -0,0 +1,99 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_RPCCLIENT_H
+#define MUDUO_NET_RPCCLIENT_H
+
+#include "LengthHeaderCodec.h"
+#include "RpcCodec.h"
+#include "TcpClient.h"
+#include "TimerId.h"
+
+#include <muduo/base/noncopyable.h>
+
+#include <boost/function.hpp>
+
+#include <map>
+
+namespace muduo
+{
+
+///
+/// Calls methods of an RpcServer over one connection.
+///
+/// Calls are multiplexed by request id, their responses may come in any
+/// order.  Each call has a deadline on the TimerQueue of the loop.
+/// Calls made in one loop iteration are encoded into one buffer and
+/// sent together at the end of it.
+///
+class RpcClient : muduo::noncopyable
+{
+ public:
+  /// Called in the loop thread, exactly once per call.
+  /// @c response is the body of the response, or the error message
+  /// of kRpcHandlerFailed, valid during the call only.
+  typedef boost::function<void (RpcStatus status,
+                                const StringView& response)> ResponseCallback;
+
+  RpcClient(EventLoop* loop, const InetAddress& serverAddr);
+  ~RpcClient();
+
+  void connect() { client_.connect(); }
+  void disconnect() { client_.disconnect(); }
+
+  /// Not thread safe.
+  void setConnectionCallback(const ConnectionCallback& cb)
+  { connectionCallback_ = cb; }
+
+  /// Calls @c methodId with @c request, which is copied.
+  /// Fails with kRpcNotConnected right away if there is no connection.
+  /// Thread safe.
+  void call(uint32_t methodId,
+            const StringView& request,
+            double timeoutSeconds,
+            const ResponseCallback& cb);
+
+  /// Calls waiting for their responses.  Must be called in the loop thread.
+  size_t numPending() const { return pending_.size(); }
+
+ private:
+  struct Call
+  {
+    ResponseCallback cb;
+    TimerId deadline;
+  };
+  typedef std::map<uint64_t, Call> CallMap;
+
+  void onConnection(const TcpConnectionPtr& conn);
+  void onFrames(const TcpConnectionPtr& conn,
+                const StringView* frames,
+                int count,
+                Timestamp receiveTime);
+  void callInLoop(uint32_t methodId,
+                  const std::string& request,
+                  double timeoutSeconds,
+                  const ResponseCallback& cb);
+  void flush();
+  void timeout(uint64_t requestId);
+  void failAll(RpcStatus status);
+
+  EventLoop* loop_;
+  TcpClient client_;
+  LengthHeaderCodec codec_;
+  ConnectionCallback connectionCallback_;
+  // always in loop thread
+  TcpConnectionPtr connection_;
+  uint64_t nextRequestId_;
+  CallMap pending_;
+  Buffer output_;  // calls not sent yet, flushed by flush()
+};
+
+}
+
+#endif  // MUDUO_NET_RPCCLIENT_H
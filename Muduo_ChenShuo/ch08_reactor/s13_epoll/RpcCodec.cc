@@ -0,0 +1,81 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "RpcCodec.h"
+
+#include "Buffer.h"
+#include "SocketsOps.h"
+
+#include <string.h>  // memcpy
+
+using namespace muduo;
+
+const char* muduo::rpcStatusName(RpcStatus status)
+{
+  switch (status)
+  {
+    case kRpcOk: return "ok";
+    case kRpcNoSuchMethod: return "no such method";
+    case kRpcHandlerFailed: return "handler failed";
+    case kRpcDeadlineExceeded: return "deadline exceeded";
+    case kRpcConnectionLost: return "connection lost";
+    case kRpcNotConnected: return "not connected";
+  }
+  return "unknown";
+}
+
+size_t rpc::beginFrame(Buffer* out, uint32_t code, uint64_t id)
+{
+  size_t mark = out->readableBytes();
+  char header[kLengthHeaderLen + kHeaderLen];
+  uint32_t len = 0;  // by endFrame()
+  uint32_t code32 = sockets::hostToNetwork32(code);
+  uint64_t id64 = sockets::hostToNetwork64(id);
+  memcpy(header, &len, sizeof len);
+  memcpy(header + kLengthHeaderLen, &code32, sizeof code32);
+  memcpy(header + kLengthHeaderLen + sizeof code32, &id64, sizeof id64);
+  out->append(header, sizeof header);
+  return mark;
+}
+
+void rpc::setCode(Buffer* out, size_t mark, uint32_t code)
+{
+  assert(mark + kLengthHeaderLen + kHeaderLen <= out->readableBytes());
+  uint32_t code32 = sockets::hostToNetwork32(code);
+  size_t frameLen = out->readableBytes() - mark;
+  memcpy(out->beginWrite() - frameLen + kLengthHeaderLen,
+         &code32, sizeof code32);
+}
+
+void rpc::endFrame(Buffer* out, size_t mark)
+{
+  assert(mark + kLengthHeaderLen + kHeaderLen <= out->readableBytes());
+  size_t frameLen = out->readableBytes() - mark;
+  uint32_t len = sockets::hostToNetwork32(
+      static_cast<uint32_t>(frameLen - kLengthHeaderLen));
+  // the frame is at the end of the readable bytes
+  memcpy(out->beginWrite() - frameLen, &len, sizeof len);
+}
+
+bool rpc::parseFrame(const StringView& frame,
+                     uint32_t* code,
+                     uint64_t* id,
+                     StringView* body)
+{
+  if (frame.size() < static_cast<size_t>(kHeaderLen))
+  {
+    return false;
+  }
+  uint32_t code32 = 0;
+  uint64_t id64 = 0;
+  memcpy(&code32, frame.data(), sizeof code32);
+  memcpy(&id64, frame.data() + sizeof code32, sizeof id64);
+  *code = sockets::networkToHost32(code32);
+  *id = sockets::networkToHost64(id64);
+  *body = StringView(frame.data() + kHeaderLen, frame.size() - kHeaderLen);
+  return true;
+}
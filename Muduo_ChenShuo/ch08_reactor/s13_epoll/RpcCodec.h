@@ -0,0 +1,77 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_RPCCODEC_H
+#define MUDUO_NET_RPCCODEC_H
+
+#include "StringView.h"
+
+#include <stdint.h>
+
+namespace muduo
+{
+
+class Buffer;
+
+/// Status of an RPC, in the code field of a response.
+enum RpcStatus
+{
+  kRpcOk = 0,
+  kRpcNoSuchMethod = 1,
+  kRpcHandlerFailed = 2,
+  // set by the client, never on the wire
+  kRpcDeadlineExceeded = 3,
+  kRpcConnectionLost = 4,
+  kRpcNotConnected = 5,
+};
+
+const char* rpcStatusName(RpcStatus status);
+
+///
+/// Wire format of RpcServer and RpcClient, a frame of LengthHeaderCodec
+/// with a 4 byte header, then
+///
+/// @code
+/// +----------------+------------------+--------------+
+/// | code, 4 bytes  | request id, 8    | body         |
+/// +----------------+------------------+--------------+
+/// @endcode
+///
+/// in network byte order.  The code is the method id of a request,
+/// or the RpcStatus of a response.  Responses may come in any order,
+/// the request id matches them.
+///
+namespace rpc
+{
+
+const int kLengthHeaderLen = 4;
+const int kHeaderLen = 12;
+const size_t kMaxFrameLen = 64*1024*1024;
+
+/// Appends the headers of a frame to @c out, the body goes after them.
+/// Returns the mark for endFrame().
+size_t beginFrame(Buffer* out, uint32_t code, uint64_t id);
+
+/// Overwrites the code of the frame begun at @c mark.
+void setCode(Buffer* out, size_t mark, uint32_t code);
+
+/// Fills in the length of the frame begun at @c mark.
+void endFrame(Buffer* out, size_t mark);
+
+/// Splits a frame from LengthHeaderCodec, returns false if it's too short.
+bool parseFrame(const StringView& frame,
+                uint32_t* code,
+                uint64_t* id,
+                StringView* body);
+
+}
+
+}
+
+#endif  // MUDUO_NET_RPCCODEC_H
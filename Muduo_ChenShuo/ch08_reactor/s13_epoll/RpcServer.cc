@@ -0,0 +1,141 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "RpcServer.h"
+
+#include <muduo/base/Logging.h>
+#include <muduo/base/ThreadPool.h>
+#include "EventLoop.h"
+
+#include <boost/bind.hpp>
+
+using namespace muduo;
+
+namespace
+{
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+  }
+}
+
+}
+
+RpcServer::RpcServer(EventLoop* loop, const InetAddress& listenAddr)
+  : server_(loop, listenAddr),
+    codec_(boost::bind(&RpcServer::onFrames, this, _1, _2, _3, _4),
+           rpc::kLengthHeaderLen, rpc::kMaxFrameLen),
+    numWorkers_(0)
+{
+  server_.setConnectionCallback(onConnection);
+  server_.setMessageCallback(
+      boost::bind(&LengthHeaderCodec::onMessage, &codec_, _1, _2, _3));
+}
+
+RpcServer::~RpcServer()
+{
+  if (workers_)
+  {
+    // they hold connections and handlers
+    workers_->stop();
+  }
+}
+
+void RpcServer::registerMethod(uint32_t methodId,
+                               const Handler& handler,
+                               Dispatch dispatch)
+{
+  assert(!workers_);
+  Method method = { handler, dispatch };
+  methods_[methodId] = method;
+}
+
+void RpcServer::start()
+{
+  if (numWorkers_ > 0 && !workers_)
+  {
+    workers_.reset(new ThreadPool("RpcWorker"));
+    workers_->start(numWorkers_);
+  }
+  server_.start();
+}
+
+void RpcServer::onFrames(const TcpConnectionPtr& conn,
+                         const StringView* frames,
+                         int count,
+                         Timestamp)
+{
+  if (!conn->connected())
+  {
+    // closing after a bad frame, drop the frames behind it
+    return;
+  }
+  // responses of inline handlers, sent at once
+  Buffer out;
+  for (int i = 0; i < count; ++i)
+  {
+    uint32_t methodId = 0;
+    uint64_t requestId = 0;
+    StringView request;
+    if (!rpc::parseFrame(frames[i], &methodId, &requestId, &request))
+    {
+      LOG_ERROR << "RpcServer::onFrames [" << conn->name()
+                << "] - frame too short";
+      conn->forceClose();
+      break;
+    }
+
+    MethodMap::const_iterator it = methods_.find(methodId);
+    if (it == methods_.end())
+    {
+      size_t mark = rpc::beginFrame(&out, kRpcNoSuchMethod, requestId);
+      rpc::endFrame(&out, mark);
+    }
+    else if (it->second.dispatch == kInWorker && workers_)
+    {
+      workers_->run(boost::bind(&RpcServer::runInWorker, this, conn,
+                                it->second.handler, requestId,
+                                std::string(request.data(), request.size())));
+    }
+    else
+    {
+      respond(&out, it->second.handler, requestId, request);
+    }
+  }
+  if (out.readableBytes() > 0)
+  {
+    conn->send(&out);
+  }
+}
+
+void RpcServer::runInWorker(const TcpConnectionPtr& conn,
+                            const Handler& handler,
+                            uint64_t requestId,
+                            const std::string& request)
+{
+  Buffer out;
+  respond(&out, handler, requestId, request);
+  // copied into the IO loop, dropped if the connection has gone
+  conn->send(&out);
+}
+
+void RpcServer::respond(Buffer* out,
+                        const Handler& handler,
+                        uint64_t requestId,
+                        const StringView& request)
+{
+  size_t mark = rpc::beginFrame(out, kRpcOk, requestId);
+  if (!handler(request, out))
+  {
+    // the body stays, as the error message
+    rpc::setCode(out, mark, kRpcHandlerFailed);
+  }
+  rpc::endFrame(out, mark);
+}
@@ -0,0 +1,99 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_RPCSERVER_H
+#define MUDUO_NET_RPCSERVER_H
+
+#include "LengthHeaderCodec.h"
+#include "RpcCodec.h"
+#include "TcpServer.h"
+
+#include <muduo/base/noncopyable.h>
+
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <map>
+
+namespace muduo
+{
+
+class ThreadPool;
+
+///
+/// Serves binary RPCs, see RpcCodec.h for the wire format.
+///
+/// A handler runs in the IO loop of the connection, or in a worker thread.
+/// Responses of the requests read at once by one IO loop are encoded into
+/// one buffer and sent together.
+///
+class RpcServer : muduo::noncopyable
+{
+ public:
+  /// Appends the response body to @c response, returns false to fail the
+  /// call with kRpcHandlerFailed, the body is sent as the error message.
+  /// @c request is valid during the call only.
+  typedef boost::function<bool (const StringView& request,
+                                Buffer* response)> Handler;
+
+  enum Dispatch
+  {
+    kInLoop,    // short handlers, never block
+    kInWorker,  // needs setWorkerThreads()
+  };
+
+  RpcServer(EventLoop* loop, const InetAddress& listenAddr);
+  ~RpcServer();  // force out-line dtor, for scoped_ptr members.
+
+  /// IO threads, see TcpServer::setThreadNum().
+  void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+  /// Threads of kInWorker handlers.  Must be called before start().
+  void setWorkerThreads(int numThreads) { numWorkers_ = numThreads; }
+
+  /// Must be called before start().
+  void registerMethod(uint32_t methodId,
+                      const Handler& handler,
+                      Dispatch dispatch = kInLoop);
+
+  void start();
+
+  TcpServer* server() { return &server_; }
+
+ private:
+  struct Method
+  {
+    Handler handler;
+    Dispatch dispatch;
+  };
+  typedef std::map<uint32_t, Method> MethodMap;
+
+  void onFrames(const TcpConnectionPtr& conn,
+                const StringView* frames,
+                int count,
+                Timestamp receiveTime);
+  void runInWorker(const TcpConnectionPtr& conn,
+                   const Handler& handler,
+                   uint64_t requestId,
+                   const std::string& request);
+  static void respond(Buffer* out,
+                      const Handler& handler,
+                      uint64_t requestId,
+                      const StringView& request);
+
+  TcpServer server_;
+  LengthHeaderCodec codec_;
+  MethodMap methods_;  // read only after start()
+  int numWorkers_;
+  boost::scoped_ptr<ThreadPool> workers_;
+};
+
+}
+
+#endif  // MUDUO_NET_RPCSERVER_H
@@ -24,7 +24,9 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress& addr)
 {
-  sockets::bindOrDie(sockfd_, addr.getSockAddrInet());
+  struct sockaddr_storage storage;
+  socklen_t len = addr.toSockAddr(&storage);
+  sockets::bindOrDie(sockfd_, storage, len);
 }
 
 void Socket::listen()
@@ -34,12 +36,12 @@ void Socket::listen()
 
 int Socket::accept(InetAddress* peeraddr)
 {
-  struct sockaddr_in addr;
-  bzero(&addr, sizeof addr);
-  int connfd = sockets::accept(sockfd_, &addr);
+  struct sockaddr_storage addr;
+  socklen_t len = 0;
+  int connfd = sockets::accept(sockfd_, &addr, &len);
   if (connfd >= 0)
   {
-    peeraddr->setSockAddrInet(addr);
+    *peeraddr = InetAddress(addr, len);
   }
   return connfd;
 }
@@ -52,6 +54,14 @@ void Socket::setReuseAddr(bool on)
   // FIXME CHECK
 }
 
+void Socket::setReusePort(bool on)
+{
+  int optval = on ? 1 : 0;
+  ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT,
+               &optval, sizeof optval);
+  // FIXME CHECK
+}
+
 void Socket::shutdownWrite()
 {
   sockets::shutdownWrite(sockfd_);
@@ -65,3 +75,20 @@ void Socket::setTcpNoDelay(bool on)
   // FIXME CHECK
 }
 
+bool Socket::setZeroCopy(bool on)
+{
+  int optval = on ? 1 : 0;
+  return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY,
+                      &optval, sizeof optval) == 0;
+}
+
+void Socket::setLinger(bool on, int seconds)
+{
+  struct linger optval;
+  optval.l_onoff = on ? 1 : 0;
+  optval.l_linger = seconds;
+  ::setsockopt(sockfd_, SOL_SOCKET, SO_LINGER,
+               &optval, sizeof optval);
+  // FIXME CHECK
+}
+
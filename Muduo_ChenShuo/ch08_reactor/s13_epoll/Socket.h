@@ -50,6 +50,11 @@ class Socket : muduo::noncopyable
   ///
   void setReuseAddr(bool on);
 
+  ///
+  /// Enable/disable SO_REUSEPORT
+  ///
+  void setReusePort(bool on);
+
   void shutdownWrite();
 
   ///
@@ -57,6 +62,18 @@ class Socket : muduo::noncopyable
   ///
   void setTcpNoDelay(bool on);
 
+  ///
+  /// Enable/disable SO_ZEROCOPY, so that send(2) accepts MSG_ZEROCOPY.
+  /// Returns false if the kernel doesn't support it.
+  ///
+  bool setZeroCopy(bool on);
+
+  ///
+  /// Enable/disable SO_LINGER, on with 0 seconds makes close(2) send
+  /// a RST and drop the unsent data.
+  ///
+  void setLinger(bool on, int seconds);
+
  private:
   const int sockfd_;
 };
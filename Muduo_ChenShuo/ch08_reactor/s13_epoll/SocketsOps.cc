@@ -12,10 +12,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>  // snprintf
+#include <string.h>  // memcpy
 #include <strings.h>  // bzero
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+
 using namespace muduo;
 
 namespace
@@ -33,6 +37,16 @@ SA* sockaddr_cast(struct sockaddr_in* addr)
   return static_cast<SA*>(implicit_cast<void*>(addr));
 }
 
+const SA* sockaddr_cast(const struct sockaddr_storage* addr)
+{
+  return static_cast<const SA*>(implicit_cast<const void*>(addr));
+}
+
+SA* sockaddr_cast(struct sockaddr_storage* addr)
+{
+  return static_cast<SA*>(implicit_cast<void*>(addr));
+}
+
 void setNonBlockAndCloseOnExec(int sockfd)
 {
   // non-block
@@ -50,11 +64,12 @@ void setNonBlockAndCloseOnExec(int sockfd)
 
 }
 
-int sockets::createNonblockingOrDie()
+int sockets::createNonblockingOrDie(sa_family_t family)
 {
+  const int protocol = family == AF_INET ? IPPROTO_TCP : 0;
   // socket
 #if VALGRIND
-  int sockfd = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  int sockfd = ::socket(family, SOCK_STREAM, protocol);
   if (sockfd < 0)
   {
     LOG_SYSFATAL << "sockets::createNonblockingOrDie";
@@ -62,9 +77,9 @@ int sockets::createNonblockingOrDie()
 
   setNonBlockAndCloseOnExec(sockfd);
 #else
-  int sockfd = ::socket(AF_INET,
+  int sockfd = ::socket(family,
                         SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
-                        IPPROTO_TCP);
+                        protocol);
   if (sockfd < 0)
   {
     LOG_SYSFATAL << "sockets::createNonblockingOrDie";
@@ -73,11 +88,41 @@ int sockets::createNonblockingOrDie()
   return sockfd;
 }
 
+int sockets::createNonblockingUdpOrDie()
+{
+  int sockfd = ::socket(AF_INET,
+                        SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        IPPROTO_UDP);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "sockets::createNonblockingUdpOrDie";
+  }
+  return sockfd;
+}
+
 int sockets::connect(int sockfd, const struct sockaddr_in& addr)
 {
   return ::connect(sockfd, sockaddr_cast(&addr), sizeof addr);
 }
 
+int sockets::connect(int sockfd,
+                     const struct sockaddr_storage& addr,
+                     socklen_t len)
+{
+  return ::connect(sockfd, sockaddr_cast(&addr), len);
+}
+
+void sockets::bindOrDie(int sockfd,
+                        const struct sockaddr_storage& addr,
+                        socklen_t len)
+{
+  int ret = ::bind(sockfd, sockaddr_cast(&addr), len);
+  if (ret < 0)
+  {
+    LOG_SYSFATAL << "sockets::bindOrDie";
+  }
+}
+
 void sockets::bindOrDie(int sockfd, const struct sockaddr_in& addr)
 {
   int ret = ::bind(sockfd, sockaddr_cast(&addr), sizeof addr);
@@ -98,6 +143,19 @@ void sockets::listenOrDie(int sockfd)
 
 int sockets::accept(int sockfd, struct sockaddr_in* addr)
 {
+  struct sockaddr_storage storage;
+  socklen_t len = 0;
+  int connfd = accept(sockfd, &storage, &len);
+  if (connfd >= 0)
+  {
+    *addr = *static_cast<struct sockaddr_in*>(implicit_cast<void*>(&storage));
+  }
+  return connfd;
+}
+
+int sockets::accept(int sockfd, struct sockaddr_storage* addr, socklen_t* len)
+{
+  bzero(addr, sizeof *addr);
   socklen_t addrlen = sizeof *addr;
 #if VALGRIND
   int connfd = ::accept(sockfd, sockaddr_cast(addr), &addrlen);
@@ -106,6 +164,7 @@ int sockets::accept(int sockfd, struct sockaddr_in* addr)
   int connfd = ::accept4(sockfd, sockaddr_cast(addr),
                          &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
 #endif
+  *len = addrlen;
   if (connfd < 0)
   {
     int savedErrno = errno;
@@ -200,6 +259,28 @@ struct sockaddr_in sockets::getPeerAddr(int sockfd)
   return peeraddr;
 }
 
+socklen_t sockets::getLocalAddr(int sockfd, struct sockaddr_storage* addr)
+{
+  bzero(addr, sizeof *addr);
+  socklen_t addrlen = sizeof *addr;
+  if (::getsockname(sockfd, sockaddr_cast(addr), &addrlen) < 0)
+  {
+    LOG_SYSERR << "sockets::getLocalAddr";
+  }
+  return addrlen;
+}
+
+socklen_t sockets::getPeerAddr(int sockfd, struct sockaddr_storage* addr)
+{
+  bzero(addr, sizeof *addr);
+  socklen_t addrlen = sizeof *addr;
+  if (::getpeername(sockfd, sockaddr_cast(addr), &addrlen) < 0)
+  {
+    LOG_SYSERR << "sockets::getPeerAddr";
+  }
+  return addrlen;
+}
+
 int sockets::getSocketError(int sockfd)
 {
   int optval;
@@ -219,6 +300,99 @@ bool sockets::isSelfConnect(int sockfd)
 {
   struct sockaddr_in localaddr = getLocalAddr(sockfd);
   struct sockaddr_in peeraddr = getPeerAddr(sockfd);
-  return localaddr.sin_port == peeraddr.sin_port
+  // only TCP connects to itself
+  return localaddr.sin_family == AF_INET
+      && localaddr.sin_port == peeraddr.sin_port
       && localaddr.sin_addr.s_addr == peeraddr.sin_addr.s_addr;
 }
+
+ssize_t sockets::readvWithFds(int sockfd, const struct iovec* iov, int iovcnt,
+                              std::vector<int>* fds)
+{
+  char control[CMSG_SPACE(16 * sizeof(int))];
+  struct msghdr msg;
+  bzero(&msg, sizeof msg);
+  msg.msg_iov = const_cast<struct iovec*>(iov);
+  msg.msg_iovlen = iovcnt;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+  ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+  if (n < 0)
+  {
+    return n;
+  }
+  if (msg.msg_flags & MSG_CTRUNC)
+  {
+    LOG_ERROR << "sockets::readvWithFds - too many fds, some are lost";
+  }
+  for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL;
+       cm = CMSG_NXTHDR(&msg, cm))
+  {
+    if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+    {
+      const int* passed = reinterpret_cast<const int*>(CMSG_DATA(cm));
+      size_t count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      fds->insert(fds->end(), passed, passed + count);
+    }
+  }
+  return n;
+}
+
+ssize_t sockets::writeWithFd(int sockfd, const void* data, size_t len, int fd)
+{
+  char control[CMSG_SPACE(sizeof(int))];
+  bzero(control, sizeof control);
+  struct iovec vec;
+  vec.iov_base = const_cast<void*>(data);
+  vec.iov_len = len;
+  struct msghdr msg;
+  bzero(&msg, sizeof msg);
+  msg.msg_iov = &vec;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+  struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_SOCKET;
+  cm->cmsg_type = SCM_RIGHTS;
+  cm->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cm), &fd, sizeof fd);
+  return ::sendmsg(sockfd, &msg, 0);
+}
+
+bool sockets::readZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi,
+                                     bool* copied)
+{
+  char control[128];
+  struct msghdr msg;
+  bzero(&msg, sizeof msg);
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+  if (::recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0)
+  {
+    if (errno != EAGAIN)
+    {
+      LOG_SYSERR << "sockets::readZeroCopyCompletion";
+    }
+    return false;
+  }
+
+  for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL;
+       cm = CMSG_NXTHDR(&msg, cm))
+  {
+    if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+        || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+    {
+      const struct sock_extended_err* serr =
+          reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+      if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+      {
+        *lo = serr->ee_info;
+        *hi = serr->ee_data;
+        *copied = serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+        return true;
+      }
+    }
+  }
+  LOG_ERROR << "sockets::readZeroCopyCompletion - not a zero copy notification";
+  return false;
+}
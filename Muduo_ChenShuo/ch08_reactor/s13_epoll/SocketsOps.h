@@ -11,8 +11,11 @@
 #ifndef MUDUO_NET_SOCKETSOPS_H
 #define MUDUO_NET_SOCKETSOPS_H
 
+#include <vector>
+
 #include <arpa/inet.h>
 #include <endian.h>
+#include <sys/uio.h>
 
 namespace muduo
 {
@@ -50,14 +53,22 @@ inline uint16_t networkToHost16(uint16_t net16)
 }
 
 ///
-/// Creates a non-blocking socket file descriptor,
+/// Creates a non-blocking stream socket file descriptor,
+/// of AF_INET or AF_UNIX, abort if any error.
+int createNonblockingOrDie(sa_family_t family = AF_INET);
+///
+/// Creates a non-blocking UDP socket file descriptor,
 /// abort if any error.
-int createNonblockingOrDie();
+int createNonblockingUdpOrDie();
 
 int  connect(int sockfd, const struct sockaddr_in& addr);
+int  connect(int sockfd, const struct sockaddr_storage& addr, socklen_t len);
 void bindOrDie(int sockfd, const struct sockaddr_in& addr);
+void bindOrDie(int sockfd, const struct sockaddr_storage& addr, socklen_t len);
 void listenOrDie(int sockfd);
 int  accept(int sockfd, struct sockaddr_in* addr);
+/// Accepts a connection of any family, *len is the length of *addr.
+int  accept(int sockfd, struct sockaddr_storage* addr, socklen_t* len);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 
@@ -68,10 +79,29 @@ void fromHostPort(const char* ip, uint16_t port,
 
 struct sockaddr_in getLocalAddr(int sockfd);
 struct sockaddr_in getPeerAddr(int sockfd);
+/// Of any family, returns the length of *addr.
+socklen_t getLocalAddr(int sockfd, struct sockaddr_storage* addr);
+socklen_t getPeerAddr(int sockfd, struct sockaddr_storage* addr);
 
 int getSocketError(int sockfd);
 bool isSelfConnect(int sockfd);
 
+///
+/// readv(2) of a Unix socket, also takes the fds passed by SCM_RIGHTS,
+/// appends them to @c fds, close-on-exec.
+ssize_t readvWithFds(int sockfd, const struct iovec* iov, int iovcnt,
+                     std::vector<int>* fds);
+///
+/// write(2) to a Unix socket, passes a copy of @c fd by SCM_RIGHTS.
+ssize_t writeWithFd(int sockfd, const void* data, size_t len, int fd);
+
+///
+/// Reads one MSG_ZEROCOPY completion from the socket error queue.
+/// Returns false if there is none, otherwise sends numbered
+/// [*lo, *hi] are done, *copied tells if the kernel fell back to copying.
+bool readZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi,
+                            bool* copied);
+
 }
 }
 
@@ -0,0 +1,73 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_STRINGVIEW_H
+#define MUDUO_NET_STRINGVIEW_H
+
+#include <muduo/base/copyable.h>
+
+#include <string>
+
+#include <string.h>
+
+namespace muduo
+{
+
+///
+/// Non-owning view of bytes, such as a frame inside a Buffer.
+///
+/// Valid as long as the bytes it points to, usually during a callback.
+class StringView : public muduo::copyable
+{
+ public:
+  StringView()
+    : data_(NULL), size_(0)
+  { }
+
+  StringView(const char* data, size_t size)
+    : data_(data), size_(size)
+  { }
+
+  StringView(const char* str)
+    : data_(str), size_(strlen(str))
+  { }
+
+  StringView(const std::string& str)
+    : data_(str.data()), size_(str.size())
+  { }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  char operator[](size_t i) const { return data_[i]; }
+
+  void removePrefix(size_t n) { data_ += n; size_ -= n; }
+  void removeSuffix(size_t n) { size_ -= n; }
+
+  bool startsWith(const StringView& x) const
+  { return size_ >= x.size_ && memcmp(data_, x.data_, x.size_) == 0; }
+
+  bool operator==(const StringView& x) const
+  { return size_ == x.size_ && memcmp(data_, x.data_, size_) == 0; }
+
+  bool operator!=(const StringView& x) const
+  { return !(*this == x); }
+
+  std::string asString() const { return std::string(data_, size_); }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+}
+
+#endif  // MUDUO_NET_STRINGVIEW_H
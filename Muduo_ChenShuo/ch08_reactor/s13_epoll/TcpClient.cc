@@ -14,8 +14,7 @@
 #include <muduo/base/Logging.h>
 
 #include <boost/bind.hpp>
-
-#include <stdio.h>  // snprintf
+#include <boost/make_shared.hpp>
 
 using namespace muduo;
 
@@ -52,13 +51,35 @@ TcpClient::TcpClient(EventLoop* loop,
                      const InetAddress& serverAddr)
   : loop_(CHECK_NOTNULL(loop)),
     connector_(new Connector(loop, serverAddr)),
+    options_(new ConnectionOptions),
     retry_(false),
     connect_(true),
     nextConnId_(1)
 {
+  init(serverAddr);
+}
+
+TcpClient::TcpClient(EventLoop* loop,
+                     const std::vector<InetAddress>& serverAddrs)
+  : loop_(CHECK_NOTNULL(loop)),
+    connector_(new Connector(loop, serverAddrs)),
+    options_(new ConnectionOptions),
+    retry_(false),
+    connect_(true),
+    nextConnId_(1)
+{
+  // replicas that fail together don't come back to the same retry
+  connector_->setRetryJitter(true);
+  init(serverAddrs.front());
+}
+
+void TcpClient::init(const InetAddress& serverAddr)
+{
+  options_->name = ":" + serverAddr.toHostPort();
+  options_->closeCallback =
+      boost::bind(&TcpClient::removeConnection, this, _1); // FIXME: unsafe
   connector_->setNewConnectionCallback(
       boost::bind(&TcpClient::newConnection, this, _1));
-  // FIXME setConnectFailedCallback
   LOG_INFO << "TcpClient::TcpClient[" << this
            << "] - connector " << get_pointer(connector_);
 }
@@ -87,6 +108,21 @@ TcpClient::~TcpClient()
   }
 }
 
+void TcpClient::setAttemptDelay(double seconds)
+{
+  connector_->setAttemptDelay(seconds);
+}
+
+void TcpClient::setMaxConnectRetries(int n)
+{
+  connector_->setMaxRetries(n);
+}
+
+void TcpClient::setConnectFailedCallback(const boost::function<void()>& cb)
+{
+  connector_->setConnectFailedCallback(cb);
+}
+
 void TcpClient::connect()
 {
   // FIXME: check state
@@ -118,26 +154,24 @@ void TcpClient::stop()
 void TcpClient::newConnection(int sockfd)
 {
   loop_->assertInLoopThread();
-  InetAddress peerAddr(sockets::getPeerAddr(sockfd));
-  char buf[32];
-  snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toHostPort().c_str(), nextConnId_);
+  struct sockaddr_storage addr;
+  socklen_t len = sockets::getPeerAddr(sockfd, &addr);
+  InetAddress peerAddr(addr, len);
+  int connId = nextConnId_;
   ++nextConnId_;
-  const std::string connName = buf;
 
-  InetAddress localAddr(sockets::getLocalAddr(sockfd));
+  len = sockets::getLocalAddr(sockfd, &addr);
+  InetAddress localAddr(addr, len);
+  // named after the replica that answered, not the first one
+  std::string name = ":" + peerAddr.toHostPort();
+  if (options_->name != name)
+  {
+    mutableOptions()->name = name;
+  }
   // FIXME poll with zero timeout to double confirm the new connection
-  // FIXME use make_shared if necessary
-  TcpConnectionPtr conn(new TcpConnection(loop_,
-                                          connName,
-                                          sockfd,
-                                          localAddr,
-                                          peerAddr));
-
-  conn->setConnectionCallback(connectionCallback_);
-  conn->setMessageCallback(messageCallback_);
-  conn->setWriteCompleteCallback(writeCompleteCallback_);
-  conn->setCloseCallback(
-      boost::bind(&TcpClient::removeConnection, this, _1)); // FIXME: unsafe
+  TcpConnectionPtr conn = boost::make_shared<TcpConnection>(
+      loop_, options_, connId, sockfd, localAddr, peerAddr);
+
   {
     MutexLockGuard lock(mutex_);
     connection_ = conn;
@@ -145,6 +179,16 @@ void TcpClient::newConnection(int sockfd)
   conn->connectEstablished();
 }
 
+ConnectionOptions* TcpClient::mutableOptions()
+{
+  // copy on write, options_ may be shared with the connection
+  if (!options_.unique())
+  {
+    options_.reset(new ConnectionOptions(*options_));
+  }
+  return get_pointer(options_);
+}
+
 void TcpClient::removeConnection(const TcpConnectionPtr& conn)
 {
   loop_->assertInLoopThread();
@@ -13,6 +13,8 @@
 #include <muduo/base/Mutex.h>
 #include "TcpConnection.h"
 
+#include <vector>
+
 namespace muduo
 {
 
@@ -24,6 +26,10 @@ class TcpClient : muduo::noncopyable
  public:
   TcpClient(EventLoop* loop,
             const InetAddress& serverAddr);
+  /// Connects to the fastest of @c serverAddrs, replicas of a server,
+  /// see Connector.  Reconnects prefer the ones that connected fast.
+  TcpClient(EventLoop* loop,
+            const std::vector<InetAddress>& serverAddrs);
   ~TcpClient();  // force out-line dtor, for scoped_ptr members.
 
   void connect();
@@ -39,32 +45,43 @@ class TcpClient : muduo::noncopyable
   bool retry() const;
   void enableRetry() { retry_ = true; }
 
+  /// See Connector::setAttemptDelay().  Must be called before connect().
+  void setAttemptDelay(double seconds);
+
+  /// See Connector::setMaxRetries().  Must be called before connect().
+  void setMaxConnectRetries(int n);
+
+  /// Called in the loop thread when connecting gives up.
+  /// It must not destroy the client.  Not thread safe.
+  void setConnectFailedCallback(const boost::function<void()>& cb);
+
   /// Set connection callback.
   /// Not thread safe.
   void setConnectionCallback(const ConnectionCallback& cb)
-  { connectionCallback_ = cb; }
+  { mutableOptions()->connectionCallback = cb; }
 
   /// Set message callback.
   /// Not thread safe.
   void setMessageCallback(const MessageCallback& cb)
-  { messageCallback_ = cb; }
+  { mutableOptions()->messageCallback = cb; }
 
   /// Set write complete callback.
   /// Not thread safe.
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
-  { writeCompleteCallback_ = cb; }
+  { mutableOptions()->writeCompleteCallback = cb; }
 
  private:
   /// Not thread safe, but in loop
   void newConnection(int sockfd);
   /// Not thread safe, but in loop
   void removeConnection(const TcpConnectionPtr& conn);
+  /// The next connection sees the change.
+  ConnectionOptions* mutableOptions();
+  void init(const InetAddress& serverAddr);
 
   EventLoop* loop_;
   ConnectorPtr connector_; // avoid revealing Connector
-  ConnectionCallback connectionCallback_;
-  MessageCallback messageCallback_;
-  WriteCompleteCallback writeCompleteCallback_;
+  ConnectionOptionsPtr options_;
   bool retry_;   // atmoic
   bool connect_; // atomic
   // always in loop thread
@@ -0,0 +1,427 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "TcpClientPool.h"
+
+#include <muduo/base/Logging.h>
+#include "Connector.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "SocketsOps.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <deque>
+
+#include <limits.h>
+
+using namespace muduo;
+
+namespace
+{
+
+void destroyConnection(const TcpConnectionPtr& conn)
+{
+  conn->getLoop()->queueInLoop(
+      boost::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+void discardMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  buf->retrieveAll();
+}
+
+void ignoreConnection(const TcpConnectionPtr&)
+{
+}
+
+// functors the connector queued before it stopped may still use it
+void releaseConnector(const ConnectorPtr&)
+{
+}
+
+}
+
+// one connection slot, its connection is only changed in its loop
+struct TcpClientPool::Member : muduo::noncopyable
+{
+  struct Pending
+  {
+    ResponseCallback cb;
+    Timestamp sendTime;
+  };
+
+  Member(EventLoop* l, const InetAddress& s)
+    : loop(l),
+      server(s),
+      connector(new Connector(l, s)),
+      options(new ConnectionOptions),
+      nextConnId(1),
+      stopped(false)
+  { }
+
+  EventLoop* loop;
+  InetAddress server;
+  ConnectorPtr connector;
+  ConnectionOptionsPtr options;
+  int nextConnId;  // in loop thread
+  bool stopped;    // in loop thread
+  std::deque<Pending> pending;  // in loop thread, in request order
+
+  mutable MutexLock mutex;
+  TcpConnectionPtr connection;  // @GuardedBy mutex, written in loop thread
+
+  // read by any thread
+  mutable AtomicInt32 connected;
+  mutable AtomicInt32 inflight;
+  mutable AtomicInt64 completed;
+  mutable AtomicInt64 failed;
+  mutable AtomicInt64 latencyTotalUs;
+  mutable AtomicInt64 latencyMaxUs;  // written in loop thread only
+};
+
+TcpClientPool::TcpClientPool(EventLoop* baseLoop,
+                             const std::vector<InetAddress>& servers,
+                             const std::string& name)
+  : baseLoop_(CHECK_NOTNULL(baseLoop)),
+    servers_(servers),
+    name_(name),
+    connectionsPerServer_(1),
+    splitter_(&TcpClientPool::splitLine),
+    started_(false),
+    threadPool_(new EventLoopThreadPool(baseLoop)),
+    cond_(mutex_),
+    stopping_(0)
+{
+}
+
+TcpClientPool::~TcpClientPool()
+{
+  if (started_)
+  {
+    stop();
+  }
+}
+
+void TcpClientPool::setThreadNum(int numThreads)
+{
+  assert(0 <= numThreads);
+  threadPool_->setThreadNum(numThreads);
+}
+
+void TcpClientPool::start()
+{
+  baseLoop_->assertInLoopThread();
+  assert(!started_);
+  assert(!servers_.empty() && connectionsPerServer_ > 0);
+  assert(members_.empty());  // can't be restarted
+  started_ = true;
+  threadPool_->start();
+
+  // server by server, so connections to one server spread over the loops
+  for (int i = 0; i < connectionsPerServer_; ++i)
+  {
+    for (size_t j = 0; j < servers_.size(); ++j)
+    {
+      MemberPtr member =
+          boost::make_shared<Member>(threadPool_->getNextLoop(), servers_[j]);
+      Member* m = get_pointer(member);
+      m->options->name = name_ + ":" + servers_[j].toHostPort();
+      m->options->connectionCallback =
+          boost::bind(&TcpClientPool::onConnection, this, _1);
+      m->options->messageCallback =
+          boost::bind(&TcpClientPool::onMessage, this, m, _1, _2, _3);
+      m->options->closeCallback =
+          boost::bind(&TcpClientPool::removeConnection, this, m, _1);
+      m->connector->setRetryJitter(true);
+      m->connector->setNewConnectionCallback(
+          boost::bind(&TcpClientPool::newConnection, this, m, _1));
+      members_.push_back(member);
+    }
+  }
+  for (size_t i = 0; i < members_.size(); ++i)
+  {
+    members_[i]->connector->start();
+  }
+}
+
+void TcpClientPool::stop()
+{
+  baseLoop_->assertInLoopThread();
+  assert(started_);
+  started_ = false;
+  std::vector<Member*> remote;
+  for (size_t i = 0; i < members_.size(); ++i)
+  {
+    Member* member = get_pointer(members_[i]);
+    if (member->loop == baseLoop_)
+    {
+      stopInLoop(member, false);
+    }
+    else
+    {
+      remote.push_back(member);
+    }
+  }
+
+  {
+    MutexLockGuard lock(mutex_);
+    stopping_ = static_cast<int>(remote.size());
+  }
+  for (size_t i = 0; i < remote.size(); ++i)
+  {
+    remote[i]->loop->runInLoop(
+        boost::bind(&TcpClientPool::stopInLoop, this, remote[i], true));
+  }
+  // requests queued before stopInLoop() have run by then
+  MutexLockGuard lock(mutex_);
+  while (stopping_ > 0)
+  {
+    cond_.wait();
+  }
+}
+
+void TcpClientPool::stopInLoop(Member* member, bool notify)
+{
+  member->loop->assertInLoopThread();
+  member->stopped = true;
+  member->connector->stop();
+  member->loop->queueInLoop(
+      boost::bind(releaseConnector, member->connector));
+
+  TcpConnectionPtr conn = member->connection;
+  if (conn)
+  {
+    // the connection may outlive the pool, detach it
+    if (connectionCallback_)
+    {
+      conn->setConnectionCallback(connectionCallback_);
+    }
+    else
+    {
+      conn->setConnectionCallback(ignoreConnection);
+    }
+    conn->setMessageCallback(discardMessage);
+    conn->setCloseCallback(destroyConnection);
+    resetConnection(member);
+    conn->forceClose();
+  }
+
+  if (notify)
+  {
+    MutexLockGuard lock(mutex_);
+    if (--stopping_ == 0)
+    {
+      cond_.notifyAll();
+    }
+  }
+}
+
+bool TcpClientPool::request(const std::string& request,
+                            const ResponseCallback& cb)
+{
+  size_t n = members_.size();
+  if (n == 0)
+  {
+    return false;
+  }
+
+  // rotates the start, so ties go round-robin
+  size_t start = static_cast<uint32_t>(next_.getAndAdd(1)) % n;
+  size_t best = n;
+  int bestInflight = INT_MAX;
+  for (size_t i = 0; i < n; ++i)
+  {
+    const Member& member = *members_[(start + i) % n];
+    if (member.connected.get())
+    {
+      int inflight = member.inflight.get();
+      if (inflight < bestInflight)
+      {
+        best = (start + i) % n;
+        bestInflight = inflight;
+      }
+    }
+  }
+  if (best == n)
+  {
+    return false;
+  }
+
+  const MemberPtr& member = members_[best];
+
+  TcpConnectionPtr conn;
+  {
+    MutexLockGuard lock(member->mutex);
+    conn = member->connection;
+  }
+  if (!conn)
+  {
+    return false;
+  }
+  member->inflight.increment();
+  member->loop->runInLoop(
+      boost::bind(&TcpClientPool::requestInLoop,
+                  member, conn, request, cb, Timestamp::now()));
+  return true;
+}
+
+void TcpClientPool::requestInLoop(const MemberPtr& member,
+                                  const TcpConnectionPtr& conn,
+                                  const std::string& request,
+                                  const ResponseCallback& cb,
+                                  Timestamp sendTime)
+{
+  member->loop->assertInLoopThread();
+  if (conn->connected() && !member->stopped)
+  {
+    Member::Pending pending = { cb, sendTime };
+    member->pending.push_back(pending);
+    conn->send(request);
+  }
+  else
+  {
+    // closed after request() picked it, failPending() has run
+    member->inflight.decrement();
+    member->failed.increment();
+    cb(NULL);
+  }
+}
+
+void TcpClientPool::failPending(Member* member)
+{
+  std::deque<Member::Pending> pending;
+  pending.swap(member->pending);
+  member->inflight.add(-static_cast<int>(pending.size()));
+  member->failed.add(pending.size());
+  for (size_t i = 0; i < pending.size(); ++i)
+  {
+    pending[i].cb(NULL);
+  }
+}
+
+void TcpClientPool::newConnection(Member* member, int sockfd)
+{
+  member->loop->assertInLoopThread();
+  struct sockaddr_storage addr;
+  socklen_t len = sockets::getPeerAddr(sockfd, &addr);
+  InetAddress peerAddr(addr, len);
+  len = sockets::getLocalAddr(sockfd, &addr);
+  InetAddress localAddr(addr, len);
+
+  TcpConnectionPtr conn = boost::make_shared<TcpConnection>(
+      member->loop, member->options, member->nextConnId++,
+      sockfd, localAddr, peerAddr);
+  // requests are small and wait for their responses
+  conn->setTcpNoDelay(true);
+  {
+    MutexLockGuard lock(member->mutex);
+    member->connection = conn;
+  }
+  conn->connectEstablished();
+  member->connected.getAndSet(1);
+  numConnected_.increment();
+}
+
+void TcpClientPool::resetConnection(Member* member)
+{
+  {
+    MutexLockGuard lock(member->mutex);
+    member->connection.reset();
+  }
+  member->connected.getAndSet(0);
+  numConnected_.decrement();
+  failPending(member);
+}
+
+void TcpClientPool::removeConnection(Member* member,
+                                     const TcpConnectionPtr& conn)
+{
+  member->loop->assertInLoopThread();
+  assert(member->connection == conn);
+  resetConnection(member);
+  member->loop->queueInLoop(
+      boost::bind(&TcpConnection::connectDestroyed, conn));
+  if (!member->stopped)
+  {
+    LOG_INFO << "TcpClientPool::removeConnection [" << conn->name()
+             << "] - Reconnecting to " << member->server.toHostPort();
+    member->connector->restart();
+  }
+}
+
+void TcpClientPool::onConnection(const TcpConnectionPtr& conn)
+{
+  if (connectionCallback_)
+  {
+    connectionCallback_(conn);
+  }
+}
+
+void TcpClientPool::onMessage(Member* member,
+                              const TcpConnectionPtr& conn,
+                              Buffer* buf,
+                              Timestamp receiveTime)
+{
+  while (buf->readableBytes() > 0)
+  {
+    ssize_t len = splitter_(buf);
+    if (len == 0)
+    {
+      break;
+    }
+    else if (len < 0 || member->pending.empty())
+    {
+      LOG_ERROR << "TcpClientPool::onMessage [" << conn->name() << "] - "
+                << (len < 0 ? "bad response" : "response without request");
+      buf->retrieveAll();
+      conn->forceClose();
+      break;
+    }
+
+    Member::Pending pending = member->pending.front();
+    member->pending.pop_front();
+    int64_t latency = receiveTime.microSecondsSinceEpoch()
+                      - pending.sendTime.microSecondsSinceEpoch();
+    member->inflight.decrement();
+    member->completed.increment();
+    member->latencyTotalUs.add(latency);
+    if (latency > member->latencyMaxUs.get())
+    {
+      member->latencyMaxUs.getAndSet(latency);
+    }
+
+    StringView response(buf->peek(), len);
+    pending.cb(&response);
+    buf->retrieve(len);
+  }
+}
+
+std::vector<TcpClientPool::ConnectionStats> TcpClientPool::stats() const
+{
+  std::vector<ConnectionStats> result(members_.size());
+  for (size_t i = 0; i < members_.size(); ++i)
+  {
+    const Member& member = *members_[i];
+    ConnectionStats& s = result[i];
+    s.server = member.server.toHostPort();
+    s.connected = member.connected.get() != 0;
+    s.inflight = member.inflight.get();
+    s.completed = member.completed.get();
+    s.failed = member.failed.get();
+    s.latencyTotalUs = member.latencyTotalUs.get();
+    s.latencyMaxUs = member.latencyMaxUs.get();
+  }
+  return result;
+}
+
+ssize_t TcpClientPool::splitLine(const Buffer* buf)
+{
+  const char* crlf = buf->findCRLF();
+  return crlf ? crlf + 2 - buf->peek() : 0;
+}
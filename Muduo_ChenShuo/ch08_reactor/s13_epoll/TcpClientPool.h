@@ -0,0 +1,159 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TCPCLIENTPOOL_H
+#define MUDUO_NET_TCPCLIENTPOOL_H
+
+#include "StringView.h"
+#include "TcpConnection.h"
+#include "EventLoopFwd.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Condition.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/base/noncopyable.h>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <vector>
+
+namespace muduo
+{
+
+class EventLoopThreadPool;
+
+///
+/// Persistent connections to one or more servers, spread over IO threads.
+///
+/// Requests are pipelined on the connections and answered in order,
+/// each goes to the connected connection with the fewest requests
+/// in flight.  A lost connection fails its requests in flight and
+/// reconnects with jittered backoff.
+///
+/// @code
+/// TcpClientPool pool(&loop, servers, "sudoku");
+/// pool.setThreadNum(4);
+/// pool.setConnectionsPerServer(8);
+/// pool.start();
+/// pool.request("1:" + puzzle + "\r\n", onSolved);
+/// @endcode
+///
+class TcpClientPool : muduo::noncopyable
+{
+ public:
+  /// Called in the IO thread of the connection.
+  /// @c response is NULL if the connection was lost before the response,
+  /// otherwise it's valid during the call.
+  typedef boost::function<void (const StringView* response)> ResponseCallback;
+
+  /// Returns the length of the first response in @c buf, 0 if it's not
+  /// complete yet, or -1 if @c buf is malformed, which closes the connection.
+  typedef boost::function<ssize_t (const Buffer* buf)> ResponseSplitter;
+
+  /// Statistics of one connection slot, it keeps its numbers over reconnects.
+  struct ConnectionStats
+  {
+    std::string server;  // host:port
+    bool connected;
+    int inflight;
+    int64_t completed;
+    int64_t failed;
+    int64_t latencyTotalUs;  // of completed requests
+    int64_t latencyMaxUs;
+
+    ConnectionStats() : connected(false), inflight(0), completed(0), failed(0),
+                        latencyTotalUs(0), latencyMaxUs(0) { }
+  };
+
+  TcpClientPool(EventLoop* baseLoop,
+                const std::vector<InetAddress>& servers,
+                const std::string& name);
+  ~TcpClientPool();  // force out-line dtor, for scoped_ptr members.
+
+  /// Number of IO threads, 0 means all connections in the base loop.
+  /// Must be called before start().
+  void setThreadNum(int numThreads);
+
+  /// Must be called before start(), default 1.
+  void setConnectionsPerServer(int n) { connectionsPerServer_ = n; }
+
+  /// Default splits lines ending with CRLF, see splitLine().
+  /// Must be called before start().
+  void setResponseSplitter(const ResponseSplitter& splitter)
+  { splitter_ = splitter; }
+
+  /// Called when a connection is up or down, in its IO thread.
+  /// Must be called before start().
+  void setConnectionCallback(const ConnectionCallback& cb)
+  { connectionCallback_ = cb; }
+
+  /// Starts connecting, the IO threads are started here.
+  /// Must be called in the base loop thread.
+  void start();
+
+  /// Closes all connections, failing the requests in flight,
+  /// and waits until each IO thread has closed its connections.
+  /// The pool can't be started again.
+  /// Must be called in the base loop thread.
+  void stop();
+
+  /// Sends @c request on the connection with the fewest requests
+  /// in flight.  Returns false without calling @c cb if none is connected.
+  /// Thread safe.
+  bool request(const std::string& request, const ResponseCallback& cb);
+
+  /// Number of connected connections.  Thread safe.
+  int numConnected() const { return numConnected_.get(); }
+
+  /// Thread safe.
+  std::vector<ConnectionStats> stats() const;
+
+  /// Splits responses that are lines ending with CRLF, the CRLF included.
+  static ssize_t splitLine(const Buffer* buf);
+
+ private:
+  struct Member;
+  typedef boost::shared_ptr<Member> MemberPtr;
+
+  void stopInLoop(Member* member, bool notify);
+  void newConnection(Member* member, int sockfd);
+  void removeConnection(Member* member, const TcpConnectionPtr& conn);
+  void onConnection(const TcpConnectionPtr& conn);
+  void onMessage(Member* member, const TcpConnectionPtr& conn,
+                 Buffer* buf, Timestamp receiveTime);
+  void resetConnection(Member* member);
+  static void requestInLoop(const MemberPtr& member,
+                            const TcpConnectionPtr& conn,
+                            const std::string& request,
+                            const ResponseCallback& cb,
+                            Timestamp sendTime);
+  static void failPending(Member* member);
+
+  EventLoop* baseLoop_;
+  std::vector<InetAddress> servers_;
+  std::string name_;
+  int connectionsPerServer_;
+  ResponseSplitter splitter_;
+  ConnectionCallback connectionCallback_;
+  bool started_;
+  boost::scoped_ptr<EventLoopThreadPool> threadPool_;
+  // fixed after start(), queued requests hold a reference to theirs
+  std::vector<MemberPtr> members_;
+  mutable AtomicInt32 numConnected_;
+  AtomicInt32 next_;  // where request() starts looking, for ties
+  MutexLock mutex_;
+  Condition cond_;
+  int stopping_;  // @GuardedBy mutex_
+};
+
+}
+
+#endif  // MUDUO_NET_TCPCLIENTPOOL_H
@@ -8,74 +8,157 @@
 #include "TcpConnection.h"
 
 #include <muduo/base/Logging.h>
+#include "BufferBudget.h"
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Socket.h"
 #include "SocketsOps.h"
+#include "TrafficCapture.h"
 
 #include <boost/bind.hpp>
 
 #include <errno.h>
 #include <stdio.h>
+#include <sys/socket.h>
 
 using namespace muduo;
 
+const double TcpConnection::kZeroCopyLingerSeconds = 2.0;
+
+namespace
+{
+const double kZeroCopyPollSeconds = 0.01;
+}
+
 TcpConnection::TcpConnection(EventLoop* loop,
-                             const std::string& nameArg,
+                             const ConnectionOptionsPtr& options,
+                             int id,
                              int sockfd,
                              const InetAddress& localAddr,
                              const InetAddress& peerAddr)
   : loop_(CHECK_NOTNULL(loop)),
-    name_(nameArg),
+    options_(options),
+    id_(id),
     state_(kConnecting),
-    socket_(new Socket(sockfd)),
-    channel_(new Channel(loop, sockfd)),
+    socket_(sockfd),
+    channel_(loop, sockfd),
     localAddr_(localAddr),
-    peerAddr_(peerAddr)
+    peerAddr_(peerAddr),
+    readBudget_(0),
+    readStopped_(false),
+    budgetPaused_(false),
+    receiveFds_(false),
+    zeroCopyThreshold_(0),
+    inputBuffer_(0),
+    payloadOffset_(0),
+    payloadBytes_(0),
+    zeroCopyNextId_(0),
+    outputBuffer_(0),
+    reportedInputBytes_(0),
+    reportedOutputBytes_(0),
+    contextTag_(NULL),
+    contextDestroy_(NULL)
 {
-  LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this
+  LOG_DEBUG << "TcpConnection::ctor[" << name() << "] at " << this
             << " fd=" << sockfd;
-  channel_->setReadCallback(
+  channel_.setReadCallback(
       boost::bind(&TcpConnection::handleRead, this, _1));
-  channel_->setWriteCallback(
+  channel_.setWriteCallback(
       boost::bind(&TcpConnection::handleWrite, this));
-  channel_->setCloseCallback(
+  channel_.setCloseCallback(
       boost::bind(&TcpConnection::handleClose, this));
-  channel_->setErrorCallback(
+  channel_.setErrorCallback(
       boost::bind(&TcpConnection::handleError, this));
 }
 
 TcpConnection::~TcpConnection()
 {
-  LOG_DEBUG << "TcpConnection::dtor[" <<  name_ << "] at " << this
-            << " fd=" << channel_->fd();
+  LOG_DEBUG << "TcpConnection::dtor[" << name() << "] at " << this
+            << " fd=" << channel_.fd();
+  for (size_t i = 0; i < passedFds_.size(); ++i)
+  {
+    sockets::close(passedFds_[i]);
+  }
+  clearContext();
+  if (!zeroCopyInflight_.empty())
+  {
+    // the loop went away first, the kernel must not send them any more
+    socket_.setLinger(true, 0);
+  }
+}
+
+std::string TcpConnection::name() const
+{
+  char buf[32];
+  snprintf(buf, sizeof buf, "#%d", id_);
+  return options_->name + buf;
+}
+
+ConnectionOptions* TcpConnection::mutableOptions()
+{
+  // copy on write, options_ may be shared with other connections
+  if (!options_.unique())
+  {
+    options_.reset(new ConnectionOptions(*options_));
+  }
+  return get_pointer(options_);
 }
 
 void TcpConnection::send(const std::string& message)
 {
   if (state_ == kConnected) {
-    if (loop_->isInLoopThread()) {
+    if (getLoop()->isInLoopThread()) {
       sendInLoop(message);
     } else {
-      loop_->runInLoop(
-          boost::bind(&TcpConnection::sendInLoop, this, message));
+      void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+      getLoop()->queueInLoop(boost::bind(fp, shared_from_this(), message));
+    }
+  }
+}
+
+void TcpConnection::send(Buffer* message)
+{
+  if (state_ == kConnected) {
+    if (getLoop()->isInLoopThread()) {
+      sendInLoop(message->peek(), message->readableBytes());
+      message->retrieveAll();
+    } else {
+      void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+      getLoop()->queueInLoop(
+          boost::bind(fp, shared_from_this(), message->retrieveAsString()));
     }
   }
 }
 
 void TcpConnection::sendInLoop(const std::string& message)
+{
+  EventLoop* loop = getLoop();
+  if (!loop->isInLoopThread()) {
+    // moved since it was queued, follows the connection
+    void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+    loop->queueInLoop(boost::bind(fp, shared_from_this(), message));
+    return;
+  }
+  sendInLoop(message.data(), message.size());
+}
+
+void TcpConnection::sendInLoop(const void* data, size_t len)
 {
   loop_->assertInLoopThread();
+  if (refuseSend(len)) {
+    return;
+  }
   ssize_t nwrote = 0;
-  // if no thing in output queue, try writing directly
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-    nwrote = ::write(channel_->fd(), message.data(), message.size());
+  // if no thing in output queue, try writing directly.
+  // payloads may be queued without writing while moving to another loop
+  if (!channel_.isWriting() && pendingOutputBytes() == 0) {
+    nwrote = ::write(channel_.fd(), data, len);
     if (nwrote >= 0) {
-      if (implicit_cast<size_t>(nwrote) < message.size()) {
+      if (implicit_cast<size_t>(nwrote) < len) {
         LOG_TRACE << "I am going to write more data";
-      } else if (writeCompleteCallback_) {
+      } else if (options_->writeCompleteCallback) {
         loop_->queueInLoop(
-            boost::bind(writeCompleteCallback_, shared_from_this()));
+            boost::bind(&TcpConnection::writeCompleted, shared_from_this()));
       }
     } else {
       nwrote = 0;
@@ -86,12 +169,210 @@ void TcpConnection::sendInLoop(const std::string& message)
   }
 
   assert(nwrote >= 0);
-  if (implicit_cast<size_t>(nwrote) < message.size()) {
-    outputBuffer_.append(message.data()+nwrote, message.size()-nwrote);
-    if (!channel_->isWriting()) {
-      channel_->enableWriting();
+  if (implicit_cast<size_t>(nwrote) < len) {
+    outputBuffer_.append(static_cast<const char*>(data)+nwrote, len-nwrote);
+    if (!channel_.isWriting()) {
+      channel_.enableWriting();
+    }
+    updateBufferedBytes();
+  }
+}
+
+void TcpConnection::send(const PayloadPtr& message)
+{
+  if (state_ == kConnected) {
+    if (getLoop()->isInLoopThread()) {
+      sendPayloadInLoop(message);
+    } else {
+      getLoop()->queueInLoop(boost::bind(&TcpConnection::sendPayloadInLoop,
+                                         shared_from_this(), message));
+    }
+  }
+}
+
+void TcpConnection::sendPayloadInLoop(const PayloadPtr& message)
+{
+  EventLoop* loop = getLoop();
+  if (!loop->isInLoopThread()) {
+    // moved since it was queued, follows the connection
+    loop->queueInLoop(boost::bind(&TcpConnection::sendPayloadInLoop,
+                                  shared_from_this(), message));
+    return;
+  }
+  if (outputBuffer_.readableBytes() > 0) {
+    // keep the order with bytes sent before
+    sendInLoop(*message);
+    return;
+  }
+  if (refuseSend(message->size())) {
+    return;
+  }
+
+  // if no thing in output queue, try writing directly
+  const bool idle = !channel_.isWriting() && pendingOutputBytes() == 0;
+  pendingPayloads_.push_back(message);
+  payloadBytes_ += message->size();
+  if (!idle) {
+    updateBufferedBytes();
+    return;
+  }
+  if (writePayloads()) {
+    if (options_->writeCompleteCallback) {
+      loop_->queueInLoop(
+          boost::bind(&TcpConnection::writeCompleted, shared_from_this()));
+    }
+  } else {
+    channel_.enableWriting();
+    updateBufferedBytes();
+  }
+}
+
+// Returns true if the buffer budget drops a message that would wait
+// in the output queue.  One that goes straight to the socket costs
+// no memory, so it's always sent.
+bool TcpConnection::refuseSend(size_t len)
+{
+  BufferBudget* budget = options_->bufferBudget;
+  if (budget == NULL || pendingOutputBytes() == 0 || !budget->exceeded()) {
+    return false;
+  }
+  budget->addRefused(len);
+  if (options_->sendRefusedCallback) {
+    options_->sendRefusedCallback(self_, len);
+  }
+  return true;
+}
+
+// Tells the loop and the budget how the bytes held by the buffers
+// have changed.
+void TcpConnection::updateBufferedBytes()
+{
+  const size_t input = inputBuffer_.readableBytes();
+  const size_t output = pendingOutputBytes();
+  if (input == reportedInputBytes_ && output == reportedOutputBytes_) {
+    return;
+  }
+  const int64_t inputDelta = implicit_cast<int64_t>(input)
+                             - implicit_cast<int64_t>(reportedInputBytes_);
+  const int64_t outputDelta = implicit_cast<int64_t>(output)
+                              - implicit_cast<int64_t>(reportedOutputBytes_);
+  loop_->addBufferedBytes(inputDelta, outputDelta);
+  if (options_->bufferBudget) {
+    options_->bufferBudget->add(inputDelta + outputDelta);
+  }
+  reportedInputBytes_ = input;
+  reportedOutputBytes_ = output;
+  bufferedBytes_.getAndSet(implicit_cast<int64_t>(input + output));
+}
+
+// Returns true if pendingPayloads_ are all sent.
+bool TcpConnection::writePayloads()
+{
+  while (!pendingPayloads_.empty()) {
+    const PayloadPtr& message = pendingPayloads_.front();
+    const char* data = message->data() + payloadOffset_;
+    const size_t len = message->size() - payloadOffset_;
+    const bool zeroCopy = zeroCopyThreshold_ > 0
+                          && message->size() >= zeroCopyThreshold_;
+    ssize_t n = ::send(channel_.fd(), data, len, zeroCopy ? MSG_ZEROCOPY : 0);
+    bool zeroCopied = zeroCopy && n > 0;
+    if (n < 0 && zeroCopy && errno == ENOBUFS) {
+      // out of optmem for pinning pages, let the kernel copy this time
+      n = ::send(channel_.fd(), data, len, 0);
+      zeroCopied = false;
+    }
+    if (n < 0) {
+      if (errno != EWOULDBLOCK) {
+        LOG_SYSERR << "TcpConnection::writePayloads";
+      }
+      return false;
+    }
+
+    if (zeroCopied) {
+      // the kernel numbers each successful MSG_ZEROCOPY send, from 0
+      uint32_t id = zeroCopyNextId_++;
+      if (!zeroCopyInflight_.empty()
+          && zeroCopyInflight_.back().second == message) {
+        zeroCopyInflight_.back().first = id;
+      } else {
+        zeroCopyInflight_.push_back(std::make_pair(id, message));
+      }
+    }
+    payloadOffset_ += n;
+    payloadBytes_ -= n;
+    if (payloadOffset_ < message->size()) {
+      return false;
     }
+    pendingPayloads_.pop_front();
+    payloadOffset_ = 0;
   }
+  return true;
+}
+
+// Returns true if any zero copy completion was read from the error queue.
+bool TcpConnection::handleZeroCopyCompletion()
+{
+  bool any = false;
+  uint32_t lo = 0;
+  uint32_t hi = 0;
+  bool copied = false;
+  while (sockets::readZeroCopyCompletion(channel_.fd(), &lo, &hi, &copied)) {
+    LOG_TRACE << "zero copy sends [" << lo << ", " << hi << "] done"
+              << (copied ? ", copied by kernel" : "");
+    any = true;
+    // completions may be coalesced, release every payload up to hi
+    while (!zeroCopyInflight_.empty()
+           && static_cast<int32_t>(zeroCopyInflight_.front().first - hi) <= 0) {
+      zeroCopyInflight_.pop_front();
+    }
+  }
+  return any;
+}
+
+void TcpConnection::clearContext()
+{
+  // no assertInLoopThread(), the dtor may run in any thread
+  if (contextTag_)
+  {
+    void (*destroy)(void*) = contextDestroy_;
+    contextTag_ = NULL;
+    contextDestroy_ = NULL;
+    destroy(&context_);
+  }
+}
+
+std::vector<int> TcpConnection::takePassedFds()
+{
+  loop_->assertInLoopThread();
+  std::vector<int> fds;
+  fds.swap(passedFds_);
+  return fds;
+}
+
+bool TcpConnection::sendWithFd(const std::string& message, int fd)
+{
+  loop_->assertInLoopThread();
+  assert(!message.empty());
+  if (state_ != kConnected || channel_.isWriting()
+      || pendingOutputBytes() > 0) {
+    return false;
+  }
+  ssize_t n = sockets::writeWithFd(channel_.fd(),
+                                   message.data(), message.size(), fd);
+  if (n < 0) {
+    if (errno != EWOULDBLOCK) {
+      LOG_SYSERR << "TcpConnection::sendWithFd";
+    }
+    return false;
+  }
+  // the fd went with the first byte, the rest is ordinary data
+  if (implicit_cast<size_t>(n) < message.size()) {
+    sendInLoop(message.substr(n));
+  } else if (options_->writeCompleteCallback) {
+    loop_->queueInLoop(
+        boost::bind(&TcpConnection::writeCompleted, shared_from_this()));
+  }
+  return true;
 }
 
 void TcpConnection::shutdown()
@@ -100,24 +381,184 @@ void TcpConnection::shutdown()
   if (state_ == kConnected)
   {
     setState(kDisconnecting);
-    // FIXME: shared_from_this()?
-    loop_->runInLoop(boost::bind(&TcpConnection::shutdownInLoop, this));
+    getLoop()->runInLoop(
+        boost::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
   }
 }
 
 void TcpConnection::shutdownInLoop()
 {
-  loop_->assertInLoopThread();
-  if (!channel_->isWriting())
+  EventLoop* loop = getLoop();
+  if (!loop->isInLoopThread()) {
+    // moved since it was queued, follows the connection
+    loop->queueInLoop(
+        boost::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+    return;
+  }
+  // output may be pending without writing while moving to another loop
+  if (!channel_.isWriting() && pendingOutputBytes() == 0)
   {
     // we are not writing
-    socket_->shutdownWrite();
+    socket_.shutdownWrite();
+  }
+}
+
+void TcpConnection::forceClose()
+{
+  // FIXME: use compare and swap
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    setState(kDisconnecting);
+    getLoop()->queueInLoop(
+        boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+  }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+  EventLoop* loop = getLoop();
+  if (!loop->isInLoopThread()) {
+    // moved since it was queued, follows the connection
+    loop->queueInLoop(
+        boost::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    return;
+  }
+  // the peer may have closed first
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    handleClose();
   }
 }
 
 void TcpConnection::setTcpNoDelay(bool on)
 {
-  socket_->setTcpNoDelay(on);
+  socket_.setTcpNoDelay(on);
+}
+
+void TcpConnection::stopRead()
+{
+  loop_->assertInLoopThread();
+  readStopped_ = true;
+  updateReading();
+}
+
+void TcpConnection::startRead()
+{
+  loop_->assertInLoopThread();
+  readStopped_ = false;
+  updateReading();
+}
+
+void TcpConnection::setBudgetPaused(bool paused)
+{
+  loop_->assertInLoopThread();
+  budgetPaused_ = paused;
+  updateReading();
+}
+
+void TcpConnection::runInLoop(const boost::function<void()>& cb)
+{
+  EventLoop* loop = getLoop();
+  if (loop->isInLoopThread()) {
+    cb();
+  } else {
+    // checks again where it lands, the connection may have moved.
+    // cb holds the connection, so this does too.
+    loop->queueInLoop(boost::bind(&TcpConnection::runInLoop, this, cb));
+  }
+}
+
+void TcpConnection::queueInLoop(const boost::function<void()>& cb)
+{
+  getLoop()->queueInLoop(boost::bind(&TcpConnection::runInLoop, this, cb));
+}
+
+void TcpConnection::moveToLoop(EventLoop* from, EventLoop* to)
+{
+  runInLoop(boost::bind(&TcpConnection::moveInLoop,
+                        shared_from_this(), from, to));
+}
+
+void TcpConnection::moveInLoop(EventLoop* from, EventLoop* to)
+{
+  loop_->assertInLoopThread();
+  // moved already, closing, or spliced with a peer of this loop
+  if (loop_ != from || from == to || state_ != kConnected
+      || relayReadable_ || relayWritable_) {
+    return;
+  }
+  channel_.disableAll();
+  loop_->removeChannel(&channel_);
+  // the counters are thread safe
+  const int64_t inputBytes = implicit_cast<int64_t>(reportedInputBytes_);
+  const int64_t outputBytes = implicit_cast<int64_t>(reportedOutputBytes_);
+  from->addBufferedBytes(-inputBytes, -outputBytes);
+  to->addBufferedBytes(inputBytes, outputBytes);
+  channel_.setOwnerLoop(to);
+  // from now on, runInLoop() goes to the new loop
+  __atomic_store_n(&loop_, to, __ATOMIC_RELEASE);
+  to->runInLoop(boost::bind(&TcpConnection::attachInLoop, shared_from_this()));
+}
+
+void TcpConnection::attachInLoop()
+{
+  loop_->assertInLoopThread();
+  // closed, or sent again, before it arrived
+  if (state_ == kDisconnected) {
+    return;
+  }
+  updateReading();
+  if (pendingOutputBytes() > 0 && !channel_.isWriting()) {
+    channel_.enableWriting();
+  }
+  if (options_->movedCallback) {
+    options_->movedCallback(self_);
+  }
+}
+
+void TcpConnection::updateReading()
+{
+  const bool reading = !readStopped_ && !budgetPaused_
+                       && state_ != kDisconnected;
+  if (reading && !channel_.isReading()) {
+    channel_.enableReading();
+  } else if (!reading && channel_.isReading()) {
+    channel_.disableReading();
+  }
+}
+
+void TcpConnection::setRelayCallbacks(const boost::function<void()>& readable,
+                                      const boost::function<void()>& writable)
+{
+  loop_->assertInLoopThread();
+  relayReadable_ = readable;
+  relayWritable_ = writable;
+}
+
+void TcpConnection::enableRelayWriting()
+{
+  loop_->assertInLoopThread();
+  if (!channel_.isWriting() && state_ != kDisconnected) {
+    channel_.enableWriting();
+  }
+}
+
+void TcpConnection::disableRelayWriting()
+{
+  loop_->assertInLoopThread();
+  if (channel_.isWriting() && pendingOutputBytes() == 0) {
+    channel_.disableWriting();
+  }
+}
+
+void TcpConnection::setZeroCopyThreshold(size_t bytes)
+{
+  if (bytes > 0 && !socket_.setZeroCopy(true)) {
+    LOG_SYSERR << "TcpConnection::setZeroCopyThreshold [" << name()
+               << "] - SO_ZEROCOPY not supported, use copy path";
+    bytes = 0;
+  }
+  zeroCopyThreshold_ = bytes;
 }
 
 void TcpConnection::connectEstablished()
@@ -125,59 +566,155 @@ void TcpConnection::connectEstablished()
   loop_->assertInLoopThread();
   assert(state_ == kConnecting);
   setState(kConnected);
-  channel_->enableReading();
-  connectionCallback_(shared_from_this());
+  lastReceiveTime_.getAndSet(Timestamp::now().microSecondsSinceEpoch());
+  self_ = shared_from_this();
+  updateReading();
+  if (options_->trafficRecorder) {
+    options_->trafficRecorder->record(TrafficEvent::kOpen, id_,
+                                      Timestamp::now(), NULL, 0);
+  }
+  options_->connectionCallback(self_);
 }
 
 void TcpConnection::connectDestroyed()
 {
   loop_->assertInLoopThread();
-  assert(state_ == kConnected || state_ == kDisconnecting);
+  // kConnected if the owner goes away first, see TcpClient
+  assert(state_ != kConnecting);
   setState(kDisconnected);
-  channel_->disableAll();
-  connectionCallback_(shared_from_this());
+  channel_.disableAll();
+  if (options_->trafficRecorder) {
+    options_->trafficRecorder->record(TrafficEvent::kClose, id_,
+                                      Timestamp::now(), NULL, 0);
+  }
+  options_->connectionCallback(self_);
+  // buffered bytes are dropped with the connection
+  const int64_t inputBytes = implicit_cast<int64_t>(reportedInputBytes_);
+  const int64_t outputBytes = implicit_cast<int64_t>(reportedOutputBytes_);
+  loop_->addBufferedBytes(-inputBytes, -outputBytes);
+  if (options_->bufferBudget) {
+    options_->bufferBudget->add(-inputBytes - outputBytes);
+  }
+  reportedInputBytes_ = 0;
+  reportedOutputBytes_ = 0;
+  bufferedBytes_.getAndSet(0);
+
+  loop_->removeChannel(&channel_);
+  if (!zeroCopyInflight_.empty()) {
+    lingerZeroCopy(addTime(Timestamp::now(), kZeroCopyLingerSeconds));
+  }
+  // the caller holds another reference
+  self_.reset();
+}
 
-  loop_->removeChannel(get_pointer(channel_));
+// Keeps the payloads of a closed connection until the kernel is done
+// with them, polls the error queue as the channel is gone.
+void TcpConnection::lingerZeroCopy(Timestamp deadline)
+{
+  loop_->assertInLoopThread();
+  handleZeroCopyCompletion();
+  if (zeroCopyInflight_.empty()) {
+    return;
+  }
+  if (Timestamp::now() < deadline) {
+    loop_->runAfter(kZeroCopyPollSeconds,
+        boost::bind(&TcpConnection::lingerZeroCopy,
+                    shared_from_this(), deadline));
+  } else {
+    LOG_WARN << "TcpConnection::lingerZeroCopy [" << name() << "] - "
+             << zeroCopyInflight_.size() << " payloads not acked, reset";
+    // close(2) in the dtor drops the unsent data, then the payloads go
+    socket_.setLinger(true, 0);
+  }
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
   int savedErrno = 0;
-  ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-  if (n > 0) {
-    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-  } else if (n == 0) {
-    handleClose();
-  } else {
-    errno = savedErrno;
-    LOG_SYSERR << "TcpConnection::handleRead";
-    handleError();
+  size_t total = 0;
+  lastReceiveTime_.getAndSet(receiveTime.microSecondsSinceEpoch());
+  if (relayReadable_) {
+    relayReadable_();
+    return;
+  }
+  while (true) {
+    const size_t writable = inputBuffer_.writableBytes();
+    ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno,
+                                    receiveFds_ ? &passedFds_ : NULL);
+    if (n > 0) {
+      total += n;
+      if (options_->trafficRecorder) {
+        options_->trafficRecorder->record(TrafficEvent::kData, id_,
+                                          receiveTime,
+                                          inputBuffer_.beginWrite() - n, n);
+      }
+      options_->messageCallback(self_, &inputBuffer_, receiveTime);
+      updateBufferedBytes();
+      // a short read means the socket is drained
+      if (readBudget_ == 0
+          || total >= readBudget_
+          || implicit_cast<size_t>(n) < writable) {
+        break;
+      }
+      // the callback stopped reading, closed, or gave the socket to
+      // TcpRelay, the rest stays in the kernel
+      if (readStopped_ || budgetPaused_ || relayReadable_
+          || state_ != kConnected) {
+        break;
+      }
+    } else if (n == 0) {
+      handleClose();
+      break;
+    } else {
+      if (total > 0 && savedErrno == EAGAIN) {
+        break;
+      }
+      errno = savedErrno;
+      LOG_SYSERR << "TcpConnection::handleRead";
+      handleError();
+      break;
+    }
   }
 }
 
 void TcpConnection::handleWrite()
 {
   loop_->assertInLoopThread();
-  if (channel_->isWriting()) {
-    ssize_t n = ::write(channel_->fd(),
-                        outputBuffer_.peek(),
-                        outputBuffer_.readableBytes());
-    if (n > 0) {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0) {
-        channel_->disableWriting();
-        if (writeCompleteCallback_) {
-          loop_->queueInLoop(
-              boost::bind(writeCompleteCallback_, shared_from_this()));
-        }
-        if (state_ == kDisconnecting) {
-          shutdownInLoop();
-        }
+  if (channel_.isWriting()) {
+    if (relayWritable_ && pendingOutputBytes() == 0) {
+      relayWritable_();
+      return;
+    }
+    if (!writePayloads()) {
+      LOG_TRACE << "I am going to write more data";
+      updateBufferedBytes();
+      return;
+    }
+    if (outputBuffer_.readableBytes() > 0) {
+      ssize_t n = ::write(channel_.fd(),
+                          outputBuffer_.peek(),
+                          outputBuffer_.readableBytes());
+      if (n > 0) {
+        outputBuffer_.retrieve(n);
       } else {
-        LOG_TRACE << "I am going to write more data";
+        LOG_SYSERR << "TcpConnection::handleWrite";
+      }
+    }
+    updateBufferedBytes();
+    if (outputBuffer_.readableBytes() == 0) {
+      channel_.disableWriting();
+      if (options_->writeCompleteCallback) {
+        loop_->queueInLoop(
+            boost::bind(&TcpConnection::writeCompleted, shared_from_this()));
+      }
+      if (relayWritable_) {
+        // bytes of the relay may wait behind those just written
+        relayWritable_();
+      } else if (state_ == kDisconnecting) {
+        shutdownInLoop();
       }
     } else {
-      LOG_SYSERR << "TcpConnection::handleWrite";
+      LOG_TRACE << "I am going to write more data";
     }
   } else {
     LOG_TRACE << "Connection is down, no more writing";
@@ -189,15 +726,38 @@ void TcpConnection::handleClose()
   loop_->assertInLoopThread();
   LOG_TRACE << "TcpConnection::handleClose state = " << state_;
   assert(state_ == kConnected || state_ == kDisconnecting);
+  // no more sends, nor a second close by forceClose()
+  setState(kDisconnected);
   // we don't close fd, leave it to dtor, so we can find leaks easily.
-  channel_->disableAll();
+  channel_.disableAll();
   // must be the last line
-  closeCallback_(shared_from_this());
+  options_->closeCallback(self_);
+}
+
+void TcpConnection::writeCompleted()
+{
+  EventLoop* loop = getLoop();
+  if (!loop->isInLoopThread()) {
+    // moved since it was queued, follows the connection
+    loop->queueInLoop(
+        boost::bind(&TcpConnection::writeCompleted, shared_from_this()));
+    return;
+  }
+  // it may land after connectDestroyed()
+  if (self_ && options_->writeCompleteCallback) {
+    options_->writeCompleteCallback(self_);
+  }
 }
 
 void TcpConnection::handleError()
 {
-  int err = sockets::getSocketError(channel_->fd());
-  LOG_ERROR << "TcpConnection::handleError [" << name_
+  // POLLERR also tells that MSG_ZEROCOPY completions are queued,
+  // a real error may come with them
+  bool zeroCopy = zeroCopyThreshold_ > 0 && handleZeroCopyCompletion();
+  int err = sockets::getSocketError(channel_.fd());
+  if (zeroCopy && err == 0) {
+    return;
+  }
+  LOG_ERROR << "TcpConnection::handleError [" << name()
             << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
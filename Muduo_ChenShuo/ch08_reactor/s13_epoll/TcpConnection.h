@@ -10,24 +10,82 @@
 
 #include "Buffer.h"
 #include "Callbacks.h"
+#include "Channel.h"
 #include "InetAddress.h"
+#include "Socket.h"
+#include "EventLoopFwd.h"
 
-#include <boost/any.hpp>
+#include <muduo/base/Atomic.h>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 #include <muduo/base/noncopyable.h>
-#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+#include <list>
+#include <new>
+#include <vector>
+
+// bytes of TcpConnection::context(), in every connection
+#ifndef MUDUO_CONNECTION_CONTEXT_SIZE
+#define MUDUO_CONNECTION_CONTEXT_SIZE 128
+#endif
 
 namespace muduo
 {
 
-class Channel;
-class EventLoop;
-class Socket;
+namespace detail
+{
+// one per type, its address tells the type of a context without RTTI.
+template <typename T>
+struct ContextTag
+{
+  static const char id;
+};
+
+template <typename T>
+const char ContextTag<T>::id = 0;
+}
+
+class BufferBudget;
+class TrafficRecorder;
+
+/// An immutable message that can be shared by connections.
+typedef boost::shared_ptr<const std::string> PayloadPtr;
+
+///
+/// Name and callbacks of connections, shared by all connections of
+/// a TcpServer or TcpClient.
+///
+/// A connection that overrides a callback gets its own copy.
+struct ConnectionOptions
+{
+  ConnectionOptions() : trafficRecorder(NULL), bufferBudget(NULL) { }
+
+  std::string name;  // connections are named name#id
+  ConnectionCallback connectionCallback;
+  MessageCallback messageCallback;
+  WriteCompleteCallback writeCompleteCallback;
+  CloseCallback closeCallback;
+  SendRefusedCallback sendRefusedCallback;
+  ConnectionCallback movedCallback;  // in the new loop, see moveToLoop()
+  TrafficRecorder* trafficRecorder;  // not owned, may be NULL
+  BufferBudget* bufferBudget;  // not owned, may be NULL
+};
+
+typedef boost::shared_ptr<ConnectionOptions> ConnectionOptionsPtr;
 
 ///
 /// TCP connection, for both client and server usage.
 ///
+/// Callbacks get a reference to a TcpConnectionPtr that is valid during
+/// the call, copy it to keep the connection.
+///
+/// Create it with boost::make_shared, so the object and its reference
+/// count take one allocation.  Its buffers start empty and grow on demand,
+/// so idle connections stay small.
+///
 class TcpConnection : muduo::noncopyable,
                       public boost::enable_shared_from_this<TcpConnection>
 {
@@ -36,37 +94,203 @@ class TcpConnection : muduo::noncopyable,
   ///
   /// User should not create this object.
   TcpConnection(EventLoop* loop,
-                const std::string& name,
+                const ConnectionOptionsPtr& options,
+                int id,
                 int sockfd,
                 const InetAddress& localAddr,
                 const InetAddress& peerAddr);
   ~TcpConnection();
 
-  EventLoop* getLoop() const { return loop_; }
-  const std::string& name() const { return name_; }
+  /// Changes if the connection moves, see moveToLoop().  Thread safe.
+  EventLoop* getLoop() const
+  { return __atomic_load_n(&loop_, __ATOMIC_ACQUIRE); }
+  /// Formatted on each call, don't use it in hot paths.
+  std::string name() const;
+  int fd() const { return socket_.fd(); }
   const InetAddress& localAddress() { return localAddr_; }
   const InetAddress& peerAddress() { return peerAddr_; }
   bool connected() const { return state_ == kConnected; }
+  bool disconnected() const { return state_ == kDisconnected; }
+
+  /// Time of the last read from the socket, or of the connection.
+  /// Thread safe.
+  Timestamp lastReceiveTime() { return Timestamp(lastReceiveTime_.get()); }
 
   //void send(const void* message, size_t len);
   // Thread safe.
   void send(const std::string& message);
+  // Thread safe. Takes all readable bytes of @c message,
+  // they are copied only if called from another thread.
+  void send(Buffer* message);
+  // Thread safe. @c message is queued by reference, so one payload can be
+  // sent to many connections without copying.  It's copied only if bytes
+  // sent by send(const std::string&) are still waiting in front of it.
+  // With zero copy, a big enough message is held until the kernel is done.
+  void send(const PayloadPtr& message);
   // Thread safe.
   void shutdown();
+  // Thread safe. Closes without waiting for the peer, output not yet
+  // written to the socket is dropped.
+  void forceClose();
   void setTcpNoDelay(bool on);
 
+  /// Stops reading from the socket, for backpressure.
+  /// Bytes keep arriving in the kernel until its buffer is full.
+  /// Must be called in the loop thread.
+  void stopRead();
+  /// Reads again after stopRead(), unless the buffer budget still
+  /// holds it.  Must be called in the loop thread.
+  void startRead();
+  bool isReading() const { return channel_.isReading(); }
+
+  /// Caps the bytes read from the socket in one poll iteration.
+  ///
+  /// With a non-zero budget, handleRead() keeps reading until the socket
+  /// is drained or the budget is spent, or the message callback stops
+  /// reading or closes the connection.  The channel is level-triggered,
+  /// so a connection that stops on its budget is reported again by the
+  /// next poll, after the other active channels of this iteration.
+  /// 0 means one read per event, which is the default.
+  /// Must be called in the loop thread.
+  void setReadBudget(size_t bytes) { readBudget_ = bytes; }
+
+  /// Sends PayloadPtr messages of at least @c bytes with MSG_ZEROCOPY.
+  ///
+  /// Smaller messages stay on the copy path, which is cheaper for them.
+  /// The kernel reads a payload until the peer acks it, so a closed
+  /// connection keeps its payloads for up to kZeroCopyLingerSeconds,
+  /// then resets the peer and drops the unacked data.
+  /// 0 disables zero copy, which is the default.
+  /// Must be called before connectEstablished() or in the loop thread.
+  void setZeroCopyThreshold(size_t bytes);
+  static const double kZeroCopyLingerSeconds;
+
+  /// Receives fds passed by SCM_RIGHTS on a Unix socket,
+  /// take them with takePassedFds().  Off by default.
+  /// Must be called in the loop thread, before the first message.
+  void setReceiveFds(bool on) { receiveFds_ = on; }
+
+  /// Fds received so far, the caller owns them.
+  /// Must be called in the loop thread.
+  std::vector<int> takePassedFds();
+
+  /// Sends @c message with a copy of @c fd, on a Unix socket.
+  ///
+  /// The fd goes with the first byte of @c message.  Returns false if
+  /// bytes sent before are still pending, or the socket is full,
+  /// try again from the write complete callback.
+  /// Must be called in the loop thread.
+  bool sendWithFd(const std::string& message, int fd);
+
+  /// Bytes accepted by send() but not yet written to the socket.
+  /// Must be called in the loop thread.
+  size_t pendingOutputBytes() const
+  { return payloadBytes_ + outputBuffer_.readableBytes(); }
+
+  /// Bytes held by the input buffer and the output queue, as last
+  /// reported to the loop.  Thread safe.
+  int64_t bufferedBytes() { return bufferedBytes_.get(); }
+
+  static const size_t kContextSize = MUDUO_CONNECTION_CONTEXT_SIZE;
+
+  /// Constructs a T in the context area of this connection, in place of
+  /// the old context, eg. the state machine of a protocol.
+  ///
+  /// The area is part of the connection object, a T bigger than
+  /// kContextSize fails to compile rather than allocate.  The context
+  /// is destroyed with the connection, or by clearContext().
+  /// Must be called in the loop thread.
+  template <typename T>
+  T* emplaceContext()
+  {
+    checkContextType<T>();
+    clearContext();
+    T* context = new (&context_) T();
+    setContextType<T>();
+    return context;
+  }
+
+  /// Like emplaceContext(), copies @c value.
+  template <typename T>
+  T* setContext(const T& value)
+  {
+    checkContextType<T>();
+    clearContext();
+    T* context = new (&context_) T(value);
+    setContextType<T>();
+    return context;
+  }
+
+  /// The context if it is a T, NULL otherwise.
+  /// Must be called in the loop thread.
+  template <typename T>
+  T* context()
+  {
+    return contextTag_ == &detail::ContextTag<T>::id
+        ? reinterpret_cast<T*>(&context_) : NULL;
+  }
+
+  bool hasContext() const { return contextTag_ != NULL; }
+
+  /// Must be called in the loop thread.
+  void clearContext();
+
   void setConnectionCallback(const ConnectionCallback& cb)
-  { connectionCallback_ = cb; }
+  { mutableOptions()->connectionCallback = cb; }
 
   void setMessageCallback(const MessageCallback& cb)
-  { messageCallback_ = cb; }
+  { mutableOptions()->messageCallback = cb; }
 
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
-  { writeCompleteCallback_ = cb; }
+  { mutableOptions()->writeCompleteCallback = cb; }
+
+  /// Called in the loop thread with a message that send() dropped,
+  /// because the buffer budget is exceeded, see TcpServer.
+  void setSendRefusedCallback(const SendRefusedCallback& cb)
+  { mutableOptions()->sendRefusedCallback = cb; }
 
   /// Internal use only.
   void setCloseCallback(const CloseCallback& cb)
-  { closeCallback_ = cb; }
+  { mutableOptions()->closeCallback = cb; }
+
+  /// Internal use only, for TcpRelay.
+  ///
+  /// Readable events go to @c readable instead of the input buffer,
+  /// which also no longer sees the end of file.  Writable events go to
+  /// @c writable once bytes accepted by send() are written, ask for them
+  /// with enableRelayWriting().  Empty callbacks give the socket back.
+  /// Must be called in the loop thread.
+  void setRelayCallbacks(const boost::function<void()>& readable,
+                         const boost::function<void()>& writable);
+  /// Internal use only, for TcpRelay.  Must be called in the loop thread.
+  void enableRelayWriting();
+  /// Internal use only, for TcpRelay.  Keeps writable events while
+  /// send() has bytes pending.  Must be called in the loop thread.
+  void disableRelayWriting();
+  /// Internal use only, for TcpRelay.
+  Buffer* inputBuffer() { return &inputBuffer_; }
+
+  /// Internal use only, for TcpServer.  Stops reading while the buffer
+  /// budget is exceeded, independent of stopRead().
+  /// Must be called in the loop thread.
+  void setBudgetPaused(bool paused);
+
+  /// Runs @c cb in the loop of this connection, at once if called there.
+  /// If the connection moves before @c cb runs, @c cb follows it.
+  /// @c cb must hold a reference to the connection, eg. bound with
+  /// a TcpConnectionPtr, which keeps it alive until @c cb runs.
+  /// Thread safe.
+  void runInLoop(const boost::function<void()>& cb);
+  /// Queues @c cb in the loop of this connection, like runInLoop().
+  /// Thread safe.
+  void queueInLoop(const boost::function<void()>& cb);
+
+  /// Internal use only, for TcpServer.  Moves the connection from
+  /// @c from to @c to, with its buffers, if it's still in @c from.
+  /// Only a connected one moves, not one of TcpRelay.  Once it's
+  /// there, the moved callback of the options runs in @c to.
+  /// Thread safe.
+  void moveToLoop(EventLoop* from, EventLoop* to);
 
   // called when TcpServer accepts a new connection
   void connectEstablished();   // should be called only once
@@ -81,23 +305,94 @@ class TcpConnection : muduo::noncopyable,
   void handleWrite();
   void handleClose();
   void handleError();
+  void writeCompleted();
   void sendInLoop(const std::string& message);
+  void sendInLoop(const void* data, size_t len);
+  void sendPayloadInLoop(const PayloadPtr& message);
+  bool writePayloads();
+  bool handleZeroCopyCompletion();
+  void lingerZeroCopy(Timestamp deadline);
   void shutdownInLoop();
+  void forceCloseInLoop();
+  bool refuseSend(size_t len);
+  void moveInLoop(EventLoop* from, EventLoop* to);
+  void attachInLoop();
+  void updateReading();
+  void updateBufferedBytes();
+  ConnectionOptions* mutableOptions();
+
+  template <typename T>
+  static void checkContextType()
+  {
+    BOOST_STATIC_ASSERT(sizeof(T) <= kContextSize);
+    BOOST_STATIC_ASSERT(boost::alignment_of<T>::value
+                        <= boost::alignment_of<ContextStorage>::value);
+  }
+
+  template <typename T>
+  void setContextType()
+  {
+    contextTag_ = &detail::ContextTag<T>::id;
+    contextDestroy_ = &destroyContext<T>;
+  }
+
+  template <typename T>
+  static void destroyContext(void* context)
+  {
+    static_cast<T*>(context)->~T();
+  }
+
+  union ContextStorage
+  {
+    char bytes[MUDUO_CONNECTION_CONTEXT_SIZE];
+    long double alignLongDouble;
+    int64_t alignInt64;
+    void* alignPointer;
+  };
+
+  // lists don't allocate when empty, unlike deques
+  typedef std::list<PayloadPtr> PayloadQueue;
+  // payloads referenced by the kernel, with the last zero copy send id
+  typedef std::list<std::pair<uint32_t, PayloadPtr> > ZeroCopyList;
 
+  // stored by moveInLoop() in the old loop, other threads use getLoop()
   EventLoop* loop_;
-  std::string name_;
+  ConnectionOptionsPtr options_;
+  // owns this while connected, callbacks borrow it by reference
+  // instead of taking a new reference with shared_from_this().
+  TcpConnectionPtr self_;
+  int id_;
   StateE state_;  // FIXME: use atomic variable
-  // we don't expose those classes to client.
-  boost::scoped_ptr<Socket> socket_;
-  boost::scoped_ptr<Channel> channel_;
+  // declared before socket_, the payloads outlive the fd
+  ZeroCopyList zeroCopyInflight_;
+  Socket socket_;
+  Channel channel_;
   InetAddress localAddr_;
   InetAddress peerAddr_;
-  ConnectionCallback connectionCallback_;
-  MessageCallback messageCallback_;
-  WriteCompleteCallback writeCompleteCallback_;
-  CloseCallback closeCallback_;
+  AtomicInt64 lastReceiveTime_;  // microseconds since epoch
+  size_t readBudget_;
+  bool readStopped_;   // by stopRead()
+  bool budgetPaused_;  // by setBudgetPaused()
+  bool receiveFds_;
+  std::vector<int> passedFds_;  // owned until taken
+  size_t zeroCopyThreshold_;
   Buffer inputBuffer_;
+  // pendingPayloads_ are sent before outputBuffer_
+  PayloadQueue pendingPayloads_;
+  size_t payloadOffset_;  // bytes sent of pendingPayloads_.front()
+  size_t payloadBytes_;   // bytes not sent of pendingPayloads_
+  uint32_t zeroCopyNextId_;
   Buffer outputBuffer_;
+  // buffered bytes the loop and the budget know of
+  size_t reportedInputBytes_;
+  size_t reportedOutputBytes_;
+  AtomicInt64 bufferedBytes_;  // their sum, for other threads
+  boost::function<void()> relayReadable_;
+  boost::function<void()> relayWritable_;
+  // the context, if contextTag_ is not NULL
+  const char* contextTag_;
+  void (*contextDestroy_)(void*);
+  ContextStorage context_;
 };
 
 typedef boost::shared_ptr<TcpConnection> TcpConnectionPtr;
@@ -0,0 +1,228 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "TcpRelay.h"
+
+#include <muduo/base/Logging.h>
+#include "EventLoop.h"
+
+#include <boost/bind.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+namespace
+{
+
+// the default capacity of a pipe
+const size_t kPipeSize = 64*1024;
+const unsigned int kSpliceFlags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+
+}
+
+struct TcpRelay::Direction
+{
+  Direction(const TcpConnectionPtr& f, const TcpConnectionPtr& t)
+    : from(f), to(t), inPipe(0), eof(false), done(false), bytes(0)
+  {
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+      LOG_SYSFATAL << "Failed in pipe2";
+    }
+    pipeRead = fds[0];
+    pipeWrite = fds[1];
+  }
+
+  ~Direction()
+  {
+    ::close(pipeRead);
+    ::close(pipeWrite);
+  }
+
+  TcpConnectionPtr from;
+  TcpConnectionPtr to;
+  int pipeRead;
+  int pipeWrite;
+  size_t inPipe;  // bytes read from @c from, not yet written to @c to
+  bool eof;       // @c from has no more bytes
+  bool done;      // @c to is shut down
+  int64_t bytes;
+};
+
+TcpRelay::TcpRelay(const TcpConnectionPtr& first,
+                   const TcpConnectionPtr& second)
+  : forward_(new Direction(first, second)),
+    backward_(new Direction(second, first)),
+    closing_(false),
+    numClosed_(0)
+{
+  assert(first->getLoop() == second->getLoop());
+}
+
+TcpRelay::~TcpRelay()
+{
+}
+
+int64_t TcpRelay::forwardBytes() const
+{
+  return forward_->bytes;
+}
+
+int64_t TcpRelay::backwardBytes() const
+{
+  return backward_->bytes;
+}
+
+void TcpRelay::start()
+{
+  const TcpConnectionPtr& first = forward_->from;
+  const TcpConnectionPtr& second = forward_->to;
+  first->getLoop()->assertInLoopThread();
+  assert(first->connected() && second->connected());
+
+  first->setConnectionCallback(
+      boost::bind(&TcpRelay::onConnection, shared_from_this(), _1));
+  second->setConnectionCallback(
+      boost::bind(&TcpRelay::onConnection, shared_from_this(), _1));
+  // send() keeps them in front of the spliced bytes
+  if (first->inputBuffer()->readableBytes() > 0)
+  {
+    second->send(first->inputBuffer());
+  }
+  if (second->inputBuffer()->readableBytes() > 0)
+  {
+    first->send(second->inputBuffer());
+  }
+  // the connections own this, so they may call back with a raw pointer
+  first->setRelayCallbacks(
+      boost::bind(&TcpRelay::onReadable, this, get_pointer(forward_)),
+      boost::bind(&TcpRelay::flush, this, get_pointer(backward_)));
+  second->setRelayCallbacks(
+      boost::bind(&TcpRelay::onReadable, this, get_pointer(backward_)),
+      boost::bind(&TcpRelay::flush, this, get_pointer(forward_)));
+  first->startRead();
+  second->startRead();
+}
+
+void TcpRelay::onReadable(Direction* d)
+{
+  if (closing_)
+  {
+    return;
+  }
+  ssize_t n = ::splice(d->from->fd(), NULL, d->pipeWrite, NULL,
+                       kPipeSize, kSpliceFlags);
+  if (n > 0)
+  {
+    d->inPipe += n;
+  }
+  else if (n == 0)
+  {
+    d->eof = true;
+    d->from->stopRead();
+  }
+  else if (errno == EAGAIN)
+  {
+    if (d->inPipe == 0)
+    {
+      return;
+    }
+    // the pipe is full, wait for the other side
+    d->from->stopRead();
+  }
+  else
+  {
+    LOG_SYSERR << "TcpRelay::onReadable";
+    closeBoth();
+    return;
+  }
+  flush(d);
+}
+
+void TcpRelay::flush(Direction* d)
+{
+  if (closing_)
+  {
+    return;
+  }
+  if (d->to->pendingOutputBytes() > 0)
+  {
+    // TcpConnection::handleWrite() calls back when they are written
+    d->to->enableRelayWriting();
+    return;
+  }
+  while (d->inPipe > 0)
+  {
+    ssize_t n = ::splice(d->pipeRead, NULL, d->to->fd(), NULL,
+                         d->inPipe, kSpliceFlags);
+    if (n > 0)
+    {
+      d->inPipe -= n;
+      d->bytes += n;
+      if (!d->eof)
+      {
+        d->from->startRead();
+      }
+    }
+    else if (n < 0 && errno == EAGAIN)
+    {
+      d->to->enableRelayWriting();
+      return;
+    }
+    else
+    {
+      LOG_SYSERR << "TcpRelay::flush";
+      closeBoth();
+      return;
+    }
+  }
+  d->to->disableRelayWriting();
+  if (d->eof && !d->done)
+  {
+    d->done = true;
+    d->to->shutdown();
+    if (forward_->done && backward_->done)
+    {
+      closeBoth();
+    }
+  }
+}
+
+void TcpRelay::closeBoth()
+{
+  closing_ = true;
+  forward_->from->forceClose();
+  forward_->to->forceClose();
+}
+
+void TcpRelay::onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    return;
+  }
+  conn->setRelayCallbacks(boost::function<void()>(),
+                          boost::function<void()>());
+  closeBoth();
+  if (++numClosed_ == 2)
+  {
+    // the connections own this relay, let them go
+    TcpRelayPtr self(shared_from_this());
+    forward_->from.reset();
+    forward_->to.reset();
+    backward_->from.reset();
+    backward_->to.reset();
+    if (closeCallback_)
+    {
+      closeCallback_(self);
+    }
+  }
+}
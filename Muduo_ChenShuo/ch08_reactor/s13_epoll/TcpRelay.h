@@ -0,0 +1,83 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TCPRELAY_H
+#define MUDUO_NET_TCPRELAY_H
+
+#include "TcpConnection.h"
+
+#include <muduo/base/noncopyable.h>
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace muduo
+{
+
+class TcpRelay;
+typedef boost::shared_ptr<TcpRelay> TcpRelayPtr;
+
+///
+/// Relays bytes between two connections of one loop with splice(2),
+/// they don't pass through user space.
+///
+/// Each direction has a pipe, bytes go from the socket into the pipe,
+/// then from the pipe into the other socket.  A direction whose pipe is
+/// full stops reading until the other socket takes some bytes.
+/// The end of file of one side shuts down writing of the other side once
+/// its pipe is drained.  When both directions have ended, or on error,
+/// both connections are closed.
+///
+/// Bytes already in the input buffer of a connection go first.
+/// The relay replaces the connection callbacks of the connections,
+/// use setCloseCallback() to learn when it's done.  It lives as long
+/// as the connections.
+///
+class TcpRelay : muduo::noncopyable,
+                 public boost::enable_shared_from_this<TcpRelay>
+{
+ public:
+  typedef boost::function<void (const TcpRelayPtr&)> RelayCloseCallback;
+
+  /// Both connections must belong to the same loop.
+  TcpRelay(const TcpConnectionPtr& first, const TcpConnectionPtr& second);
+  ~TcpRelay();
+
+  /// Called once, after both connections are closed.
+  void setCloseCallback(const RelayCloseCallback& cb)
+  { closeCallback_ = cb; }
+
+  /// Must be called in the loop thread, with both connections connected.
+  void start();
+
+  /// Bytes written to the second connection.
+  int64_t forwardBytes() const;
+  /// Bytes written to the first connection.
+  int64_t backwardBytes() const;
+
+ private:
+  struct Direction;
+
+  void onReadable(Direction* d);
+  void flush(Direction* d);
+  void onConnection(const TcpConnectionPtr& conn);
+  void closeBoth();
+
+  boost::scoped_ptr<Direction> forward_;
+  boost::scoped_ptr<Direction> backward_;
+  RelayCloseCallback closeCallback_;
+  bool closing_;
+  int numClosed_;
+};
+
+}
+
+#endif  // MUDUO_NET_TCPRELAY_H
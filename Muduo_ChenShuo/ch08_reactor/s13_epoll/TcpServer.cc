@@ -14,25 +14,186 @@
 #include "SocketsOps.h"
 
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/weak_ptr.hpp>
 
-#include <stdio.h>  // snprintf
+#include <algorithm>
+#include <functional>
 
 using namespace muduo;
 
+namespace
+{
+
+typedef std::map<EventLoop*, int64_t> BusySamples;
+
+// Busy ratio of each loop since the last sample, 0 for a new loop.
+std::vector<double> sampleBusyRatios(const std::vector<EventLoop*>& loops,
+                                     double elapsedMicroseconds,
+                                     BusySamples* samples)
+{
+  std::vector<double> ratios(loops.size());
+  BusySamples next;
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    int64_t busy = loops[i]->busyMicroseconds();
+    BusySamples::const_iterator it = samples->find(loops[i]);
+    if (it != samples->end() && elapsedMicroseconds > 0)
+    {
+      ratios[i] = (busy - it->second) / elapsedMicroseconds;
+    }
+    next[loops[i]] = busy;
+  }
+  // forget retired loops
+  samples->swap(next);
+  return ratios;
+}
+
+// A chain of timers in @c loop, it ends when the connection moves away
+// and a new chain starts in its new loop.
+void checkIdle(const boost::weak_ptr<TcpConnection>& weakConn,
+               double timeout,
+               EventLoop* loop)
+{
+  TcpConnectionPtr conn(weakConn.lock());
+  if (conn && !conn->disconnected() && conn->getLoop() == loop)
+  {
+    double idle = timeDifference(Timestamp::now(), conn->lastReceiveTime());
+    if (idle >= timeout)
+    {
+      LOG_INFO << "TcpServer - closing idle connection " << conn->name();
+      conn->forceClose();
+    }
+    else
+    {
+      // a timer per timeout period, not per message
+      loop->runAfter(timeout - idle,
+                     boost::bind(checkIdle, weakConn, timeout, loop));
+    }
+  }
+}
+
+// Starts the chain of checkIdle() in the loop of @c conn,
+// for a new connection, and again after each move.
+void watchIdle(const TcpConnectionPtr& conn, double timeout)
+{
+  EventLoop* loop = conn->getLoop();
+  loop->runAfter(timeout,
+                 boost::bind(checkIdle, boost::weak_ptr<TcpConnection>(conn),
+                             timeout, loop));
+}
+
+}
+
 TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr)
   : loop_(CHECK_NOTNULL(loop)),
     name_(listenAddr.toHostPort()),
     acceptor_(new Acceptor(loop, listenAddr)),
     threadPool_(new EventLoopThreadPool(loop)),
+    options_(new ConnectionOptions),
+    readBudget_(0),
+    zeroCopyThreshold_(0),
+    maxConnections_(0),
+    overflowPolicy_(kRejectNew),
+    idleTimeout_(0),
+    maxBusyRatio_(0),
+    maxBufferedBytes_(0),
+    resumeRatio_(0),
+    overloadCheckInterval_(0),
+    overloaded_(false),
     started_(false),
-    nextConnId_(1)
+    nextConnId_(1),
+    numConnections_(0),
+    budgetCheckInterval_(0),
+    budgetExceeded_(false),
+    minThreads_(0),
+    maxThreads_(0),
+    growRatio_(0),
+    shrinkRatio_(0),
+    elasticInterval_(0),
+    retiringLoop_(NULL),
+    retiringDrained_(false),
+    retiringPasses_(0)
 {
+  options_->name = name_;
+  options_->bufferBudget = &bufferBudget_;
+  options_->closeCallback =
+      boost::bind(&TcpServer::removeConnection, this, _1); // FIXME: unsafe
   acceptor_->setNewConnectionCallback(
       boost::bind(&TcpServer::newConnection, this, _1, _2));
 }
 
 TcpServer::~TcpServer()
 {
+  if (overloadCheckInterval_ > 0)
+  {
+    loop_->cancel(overloadTimer_);
+  }
+  if (budgetCheckInterval_ > 0)
+  {
+    loop_->cancel(budgetTimer_);
+  }
+  if (elasticInterval_ > 0)
+  {
+    loop_->cancel(elasticTimer_);
+  }
+}
+
+void TcpServer::setIdleTimeout(double seconds)
+{
+  idleTimeout_ = seconds;
+  // a connection that moves checks in its new loop
+  if (seconds > 0)
+  {
+    mutableOptions()->movedCallback = boost::bind(watchIdle, _1, seconds);
+  }
+  else
+  {
+    mutableOptions()->movedCallback = ConnectionCallback();
+  }
+}
+
+void TcpServer::setOverloadLimits(double maxBusyRatio,
+                                  int64_t maxBufferedBytes,
+                                  double resumeRatio,
+                                  double interval)
+{
+  assert(!started_);
+  assert(0 < resumeRatio && resumeRatio <= 1.0);
+  assert(interval > 0);
+  maxBusyRatio_ = maxBusyRatio;
+  maxBufferedBytes_ = maxBufferedBytes;
+  resumeRatio_ = resumeRatio;
+  overloadCheckInterval_ = interval;
+}
+
+void TcpServer::setBufferBudget(int64_t maxBytes,
+                                double resumeRatio,
+                                double interval)
+{
+  assert(!started_);
+  assert(interval > 0);
+  bufferBudget_.setLimit(maxBytes, resumeRatio);
+  budgetCheckInterval_ = maxBytes > 0 ? interval : 0;
+}
+
+void TcpServer::setElasticThreads(int minThreads,
+                                  int maxThreads,
+                                  double growRatio,
+                                  double shrinkRatio,
+                                  double interval)
+{
+  assert(!started_);
+  // the base loop never retires, keep one IO loop at least
+  assert(1 <= minThreads && minThreads <= maxThreads);
+  assert(0 <= shrinkRatio && shrinkRatio < growRatio);
+  assert(interval > 0);
+  minThreads_ = minThreads;
+  maxThreads_ = maxThreads;
+  growRatio_ = growRatio;
+  shrinkRatio_ = shrinkRatio;
+  elasticInterval_ = interval;
+  threadPool_->setThreadNum(minThreads);
 }
 
 void TcpServer::setThreadNum(int numThreads)
@@ -47,6 +208,23 @@ void TcpServer::start()
   {
     started_ = true;
     threadPool_->start();
+    if (overloadCheckInterval_ > 0)
+    {
+      lastOverloadCheck_ = Timestamp::now();
+      overloadTimer_ = loop_->runEvery(
+          overloadCheckInterval_, boost::bind(&TcpServer::checkOverload, this));
+    }
+    if (elasticInterval_ > 0)
+    {
+      lastElasticCheck_ = Timestamp::now();
+      elasticTimer_ = loop_->runEvery(
+          elasticInterval_, boost::bind(&TcpServer::checkElastic, this));
+    }
+    if (budgetCheckInterval_ > 0)
+    {
+      budgetTimer_ = loop_->runEvery(
+          budgetCheckInterval_, boost::bind(&TcpServer::checkBufferBudget, this));
+    }
   }
 
   if (!acceptor_->listenning())
@@ -59,26 +237,309 @@ void TcpServer::start()
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
   loop_->assertInLoopThread();
-  char buf[32];
-  snprintf(buf, sizeof buf, "#%d", nextConnId_);
+  if (maxConnections_ > 0 && numConnections_ >= maxConnections_)
+  {
+    if (overflowPolicy_ == kRejectNew)
+    {
+      LOG_WARN << "TcpServer::newConnection [" << name_
+               << "] - reject " << peerAddr.toHostPort() << ", "
+               << numConnections_ << " connections";
+      sockets::close(sockfd);
+      return;
+    }
+    closeOldestIdle();
+  }
+  int connId = nextConnId_;
   ++nextConnId_;
-  std::string connName = name_ + buf;
 
   LOG_INFO << "TcpServer::newConnection [" << name_
-           << "] - new connection [" << connName
+           << "] - new connection [" << name_ << "#" << connId
            << "] from " << peerAddr.toHostPort();
-  InetAddress localAddr(sockets::getLocalAddr(sockfd));
+  struct sockaddr_storage local;
+  socklen_t localLen = sockets::getLocalAddr(sockfd, &local);
+  InetAddress localAddr(local, localLen);
   // FIXME poll with zero timeout to double confirm the new connection
   EventLoop* ioLoop = threadPool_->getNextLoop();
-  TcpConnectionPtr conn(
-      new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-  connections_[connName] = conn;
-  conn->setConnectionCallback(connectionCallback_);
-  conn->setMessageCallback(messageCallback_);
-  conn->setWriteCompleteCallback(writeCompleteCallback_);
-  conn->setCloseCallback(
-      boost::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
+  // one allocation for the connection and its reference count
+  TcpConnectionPtr conn = boost::make_shared<TcpConnection>(
+      ioLoop, options_, connId, sockfd, localAddr, peerAddr);
+  if (implicit_cast<size_t>(sockfd) >= connections_.size())
+  {
+    connections_.resize(std::max(implicit_cast<size_t>(sockfd) + 1,
+                                 connections_.size() * 2));
+  }
+  assert(!connections_[sockfd]);
+  connections_[sockfd] = conn;
+  ++numConnections_;
+  conn->setReadBudget(readBudget_);
+  if (zeroCopyThreshold_ > 0)
+  {
+    conn->setZeroCopyThreshold(zeroCopyThreshold_);
+  }
   ioLoop->runInLoop(boost::bind(&TcpConnection::connectEstablished, conn));
+  if (idleTimeout_ > 0)
+  {
+    watchIdle(conn, idleTimeout_);
+  }
+}
+
+void TcpServer::closeOldestIdle()
+{
+  loop_->assertInLoopThread();
+  // O(fds), paid only at the limit
+  TcpConnection* oldest = NULL;
+  Timestamp oldestTime;
+  for (size_t fd = 0; fd < connections_.size(); ++fd)
+  {
+    TcpConnection* conn = get_pointer(connections_[fd]);
+    // skip the ones being closed
+    if (conn && conn->connected())
+    {
+      Timestamp t = conn->lastReceiveTime();
+      if (oldest == NULL || t < oldestTime)
+      {
+        oldest = conn;
+        oldestTime = t;
+      }
+    }
+  }
+  if (oldest)
+  {
+    LOG_WARN << "TcpServer::closeOldestIdle [" << name_
+             << "] - close " << oldest->name() << ", idle "
+             << timeDifference(Timestamp::now(), oldestTime) << "s";
+    oldest->forceClose();
+  }
+}
+
+void TcpServer::checkOverload()
+{
+  loop_->assertInLoopThread();
+  if (!acceptor_->listenning())
+  {
+    return;
+  }
+  std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+  Timestamp now(Timestamp::now());
+  double elapsedMicroseconds = timeDifference(now, lastOverloadCheck_) * 1e6;
+  lastOverloadCheck_ = now;
+  std::vector<double> ratios =
+      sampleBusyRatios(loops, elapsedMicroseconds, &busySamples_);
+  double busyRatio = 0;
+  int64_t bufferedBytes = 0;
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    busyRatio = std::max(busyRatio, ratios[i]);
+    bufferedBytes += loops[i]->bufferedOutputBytes();
+  }
+
+  if (!overloaded_)
+  {
+    if ((maxBusyRatio_ > 0 && busyRatio > maxBusyRatio_)
+        || (maxBufferedBytes_ > 0 && bufferedBytes > maxBufferedBytes_))
+    {
+      LOG_WARN << "TcpServer::checkOverload [" << name_
+               << "] - stop accepting, busy " << busyRatio
+               << ", buffered " << bufferedBytes << " bytes";
+      overloaded_ = true;
+      acceptor_->pause();
+    }
+  }
+  else
+  {
+    if ((maxBusyRatio_ <= 0 || busyRatio < maxBusyRatio_ * resumeRatio_)
+        && (maxBufferedBytes_ <= 0
+            || bufferedBytes < maxBufferedBytes_ * resumeRatio_))
+    {
+      LOG_WARN << "TcpServer::checkOverload [" << name_
+               << "] - resume accepting, busy " << busyRatio
+               << ", buffered " << bufferedBytes << " bytes";
+      overloaded_ = false;
+      acceptor_->resume();
+    }
+  }
+}
+
+void TcpServer::checkElastic()
+{
+  loop_->assertInLoopThread();
+  std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+  Timestamp now(Timestamp::now());
+  double elapsedMicroseconds = timeDifference(now, lastElasticCheck_) * 1e6;
+  lastElasticCheck_ = now;
+  std::vector<double> ratios =
+      sampleBusyRatios(loops, elapsedMicroseconds, &elasticSamples_);
+  if (retiringLoop_)
+  {
+    // no resizing until the last one is gone
+    drainRetiringLoop();
+    return;
+  }
+
+  double average = 0;
+  size_t leastBusy = 0;
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    average += ratios[i];
+    if (ratios[i] < ratios[leastBusy])
+    {
+      leastBusy = i;
+    }
+  }
+  average /= static_cast<double>(loops.size());
+  const int numThreads = static_cast<int>(loops.size());
+
+  if (average > growRatio_ && numThreads < maxThreads_)
+  {
+    EventLoop* ioLoop = threadPool_->addLoop();
+    LOG_WARN << "TcpServer::checkElastic [" << name_ << "] - busy "
+             << average << ", add loop " << ioLoop << ", "
+             << numThreads + 1 << " threads";
+  }
+  else if (average < shrinkRatio_ && numThreads > minThreads_)
+  {
+    retiringLoop_ = loops[leastBusy];
+    retiringDrained_ = false;
+    retiringPasses_ = 0;
+    LOG_WARN << "TcpServer::checkElastic [" << name_ << "] - busy "
+             << average << ", retire loop " << retiringLoop_ << ", "
+             << numThreads - 1 << " threads";
+    threadPool_->retireLoop(retiringLoop_);
+    drainRetiringLoop();
+  }
+}
+
+void TcpServer::drainRetiringLoop()
+{
+  loop_->assertInLoopThread();
+  assert(retiringLoop_);
+  // O(fds), paid only while retiring
+  int remaining = 0;
+  for (size_t fd = 0; fd < connections_.size(); ++fd)
+  {
+    const TcpConnectionPtr& conn = connections_[fd];
+    if (conn && conn->getLoop() == retiringLoop_)
+    {
+      // asks again for those that could not move last time
+      ++remaining;
+      conn->moveToLoop(retiringLoop_, threadPool_->getNextLoop());
+    }
+  }
+
+  if (remaining > 0)
+  {
+    retiringDrained_ = false;
+    if (++retiringPasses_ >= kMaxDrainPasses)
+    {
+      // spliced by TcpRelay, or slow to close, they stay where they are
+      LOG_WARN << "TcpServer::drainRetiringLoop [" << name_
+               << "] - keep loop " << retiringLoop_ << ", "
+               << remaining << " connections did not move";
+      threadPool_->restoreLoop(retiringLoop_);
+      retiringLoop_ = NULL;
+    }
+  }
+  else if (!retiringDrained_)
+  {
+    // one more interval, for functors that follow the moved connections
+    retiringDrained_ = true;
+  }
+  else
+  {
+    LOG_WARN << "TcpServer::drainRetiringLoop [" << name_
+             << "] - release loop " << retiringLoop_;
+    threadPool_->releaseLoop(retiringLoop_);
+    retiringLoop_ = NULL;
+  }
+}
+
+void TcpServer::checkBufferBudget()
+{
+  loop_->assertInLoopThread();
+  // not the cached flag, add()s may have left it behind
+  const bool exceeded = bufferBudget_.update();
+  if (exceeded)
+  {
+    pauseLargestReaders();
+  }
+  if (exceeded != budgetExceeded_)
+  {
+    budgetExceeded_ = exceeded;
+    LOG_WARN << "TcpServer::checkBufferBudget [" << name_ << "] - "
+             << (exceeded ? "exceeded" : "resumed") << ", buffered "
+             << bufferBudget_.bytes() << " bytes";
+    if (!exceeded)
+    {
+      resumePausedReaders();
+    }
+    if (bufferBudgetCallback_)
+    {
+      bufferBudgetCallback_(exceeded);
+    }
+  }
+}
+
+void TcpServer::pauseLargestReaders()
+{
+  loop_->assertInLoopThread();
+  // O(fds log fds), paid only while exceeded
+  typedef std::pair<int64_t, size_t> Candidate;  // bytes, fd
+  std::vector<Candidate> candidates;
+  for (size_t fd = 0; fd < connections_.size(); ++fd)
+  {
+    const TcpConnectionPtr& conn = connections_[fd];
+    if (conn && conn->connected()
+        && budgetPaused_.find(conn) == budgetPaused_.end())
+    {
+      int64_t bytes = conn->bufferedBytes();
+      if (bytes > 0)
+      {
+        candidates.push_back(Candidate(bytes, fd));
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            std::greater<Candidate>());
+
+  // enough readers to hold the bytes above the resume level
+  int64_t excess = bufferBudget_.bytes() - bufferBudget_.resumeBytes();
+  for (size_t i = 0; i < candidates.size() && excess > 0; ++i)
+  {
+    const TcpConnectionPtr& conn = connections_[candidates[i].second];
+    LOG_WARN << "TcpServer::pauseLargestReaders [" << name_
+             << "] - stop reading " << conn->name() << ", "
+             << candidates[i].first << " bytes";
+    budgetPaused_.insert(conn);
+    conn->runInLoop(
+        boost::bind(&TcpConnection::setBudgetPaused, conn, true));
+    excess -= candidates[i].first;
+  }
+}
+
+void TcpServer::resumePausedReaders()
+{
+  loop_->assertInLoopThread();
+  for (WeakConnectionSet::iterator it = budgetPaused_.begin();
+      it != budgetPaused_.end(); ++it)
+  {
+    TcpConnectionPtr conn(it->lock());
+    if (conn)
+    {
+      conn->runInLoop(
+          boost::bind(&TcpConnection::setBudgetPaused, conn, false));
+    }
+  }
+  budgetPaused_.clear();
+}
+
+ConnectionOptions* TcpServer::mutableOptions()
+{
+  // copy on write, options_ may be shared with connections
+  if (!options_.unique())
+  {
+    options_.reset(new ConnectionOptions(*options_));
+  }
+  return get_pointer(options_);
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
@@ -92,10 +553,12 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
   loop_->assertInLoopThread();
   LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
            << "] - connection " << conn->name();
-  size_t n = connections_.erase(conn->name());
-  assert(n == 1); (void)n;
-  EventLoop* ioLoop = conn->getLoop();
-  ioLoop->queueInLoop(
+  assert(connections_[conn->fd()] == conn);
+  connections_[conn->fd()].reset();
+  --numConnections_;
+  budgetPaused_.erase(conn);
+  // follows the connection if it's moving to another loop
+  conn->queueInLoop(
       boost::bind(&TcpConnection::connectDestroyed, conn));
 }
 
@@ -8,23 +8,36 @@
 #ifndef MUDUO_NET_TCPSERVER_H
 #define MUDUO_NET_TCPSERVER_H
 
+#include "BufferBudget.h"
 #include "Callbacks.h"
 #include "TcpConnection.h"
+#include "TimerId.h"
+#include "EventLoopFwd.h"
 
-#include <map>
 #include <muduo/base/noncopyable.h>
 #include <boost/scoped_ptr.hpp>
+#include <boost/smart_ptr/owner_less.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <map>
+#include <set>
+#include <vector>
 
 namespace muduo
 {
 
 class Acceptor;
-class EventLoop;
 class EventLoopThreadPool;
 
 class TcpServer : muduo::noncopyable
 {
  public:
+  /// What to do with a new connection beyond the limit.
+  enum OverflowPolicy
+  {
+    kRejectNew,        // closes the new one
+    kCloseOldestIdle,  // closes the one that received nothing for longest
+  };
 
   TcpServer(EventLoop* loop, const InetAddress& listenAddr);
   ~TcpServer();  // force out-line dtor, for scoped_ptr members.
@@ -47,41 +60,197 @@ class TcpServer : muduo::noncopyable
   /// Thread safe.
   void start();
 
+  /// The IO loops of the connections, valid after calling start().
+  EventLoopThreadPool* threadPool() { return get_pointer(threadPool_); }
+
   /// Set connection callback.
   /// Not thread safe.
   void setConnectionCallback(const ConnectionCallback& cb)
-  { connectionCallback_ = cb; }
+  { mutableOptions()->connectionCallback = cb; }
 
   /// Set message callback.
   /// Not thread safe.
   void setMessageCallback(const MessageCallback& cb)
-  { messageCallback_ = cb; }
+  { mutableOptions()->messageCallback = cb; }
 
   /// Set write complete callback.
   /// Not thread safe.
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
-  { writeCompleteCallback_ = cb; }
+  { mutableOptions()->writeCompleteCallback = cb; }
+
+  /// Set per-iteration read budget of new connections,
+  /// see TcpConnection::setReadBudget().
+  /// Not thread safe.
+  void setReadBudget(size_t bytes)
+  { readBudget_ = bytes; }
+
+  /// Set zero copy threshold of new connections,
+  /// see TcpConnection::setZeroCopyThreshold().
+  /// Not thread safe.
+  void setZeroCopyThreshold(size_t bytes)
+  { zeroCopyThreshold_ = bytes; }
+
+  /// Records the bytes received by new connections, with their opening
+  /// and closing, see TrafficRecorder.  NULL stops recording, the default.
+  /// Not thread safe.
+  void setTrafficRecorder(TrafficRecorder* recorder)
+  { mutableOptions()->trafficRecorder = recorder; }
+
+  /// Caps the number of connections, 0 means no limit, the default.
+  /// Not thread safe.
+  void setMaxConnections(int maxConnections,
+                         OverflowPolicy policy = kRejectNew)
+  {
+    maxConnections_ = maxConnections;
+    overflowPolicy_ = policy;
+  }
+
+  /// Closes connections that receive nothing for @c seconds,
+  /// checked by timers of their IO loops.  0 disables it, the default.
+  /// Not thread safe.
+  void setIdleTimeout(double seconds);
+
+  /// Stops accepting while an IO loop is busy for more than
+  /// @c maxBusyRatio of the time, or connections have more than
+  /// @c maxBufferedBytes of output waiting, 0 ignores either limit.
+  /// Accepting resumes once both are below @c resumeRatio of their limits.
+  /// Sampled every @c interval seconds.
+  /// Must be called before @c start.
+  void setOverloadLimits(double maxBusyRatio,
+                         int64_t maxBufferedBytes,
+                         double resumeRatio = 0.8,
+                         double interval = 0.1);
+
+  /// Caps the bytes held by the input buffers and output queues of
+  /// all connections at @c maxBytes, 0 means no limit, the default.
+  ///
+  /// Past the limit, send() drops messages that would wait in an output
+  /// queue, see setSendRefusedCallback(), and the connections holding
+  /// the most bytes stop reading, until the bytes drop below
+  /// @c resumeRatio of the limit.  Readers are picked every
+  /// @c interval seconds.
+  /// Must be called before @c start.
+  void setBufferBudget(int64_t maxBytes,
+                       double resumeRatio = 0.8,
+                       double interval = 0.1);
+
+  /// Grows and shrinks the IO threads with load, between @c minThreads
+  /// and @c maxThreads, starting with @c minThreads.
+  ///
+  /// Every @c interval seconds, a thread is added if the IO loops are
+  /// busy for more than @c growRatio of the time on average.  Below
+  /// @c shrinkRatio, the least busy loop takes no more connections, its
+  /// connections move to the other loops with their buffers, then its
+  /// thread quits.  If some connections don't move for a while, eg.
+  /// those spliced by TcpRelay, the loop stays in use instead.
+  /// Not for servers that keep state per IO loop, like PubSubHub or
+  /// MemcacheServer.
+  /// Must be called before @c start, overrides setThreadNum().
+  void setElasticThreads(int minThreads,
+                         int maxThreads,
+                         double growRatio = 0.75,
+                         double shrinkRatio = 0.25,
+                         double interval = 1.0);
+
+  /// Called in loop's thread when the buffer budget gets exceeded,
+  /// and again when the bytes drop below the resume level.
+  /// Not thread safe.
+  void setBufferBudgetCallback(const BufferBudgetCallback& cb)
+  { bufferBudgetCallback_ = cb; }
+
+  /// Set send refused callback of connections,
+  /// see TcpConnection::setSendRefusedCallback().
+  /// Not thread safe.
+  void setSendRefusedCallback(const SendRefusedCallback& cb)
+  { mutableOptions()->sendRefusedCallback = cb; }
+
+  /// Bytes held by the buffers of all connections, with the refused
+  /// sends, accounted even without a limit.  Per loop numbers are
+  /// EventLoop::bufferedInputBytes() and bufferedOutputBytes().
+  /// Thread safe.
+  BufferBudget* bufferBudget() { return &bufferBudget_; }
+
+  /// Must be called in loop's thread.
+  int numConnections() const { return numConnections_; }
+  bool overloaded() const { return overloaded_; }
+  /// Connections that stopped reading for the buffer budget.
+  int numBudgetPaused() const { return static_cast<int>(budgetPaused_.size()); }
 
  private:
+  // of a retiring loop, before it stays
+  static const int kMaxDrainPasses = 10;
+
   /// Not thread safe, but in loop
   void newConnection(int sockfd, const InetAddress& peerAddr);
   /// Thread safe.
   void removeConnection(const TcpConnectionPtr& conn);
   /// Not thread safe, but in loop
   void removeConnectionInLoop(const TcpConnectionPtr& conn);
+  /// Not thread safe, but in loop
+  void closeOldestIdle();
+  /// Not thread safe, but in loop
+  void checkOverload();
+  /// Not thread safe, but in loop
+  void checkElastic();
+  /// Not thread safe, but in loop
+  void drainRetiringLoop();
+  /// Not thread safe, but in loop
+  void checkBufferBudget();
+  /// Not thread safe, but in loop
+  void pauseLargestReaders();
+  /// Not thread safe, but in loop
+  void resumePausedReaders();
+  /// Connections made after it see the change.
+  ConnectionOptions* mutableOptions();
 
-  typedef std::map<std::string, TcpConnectionPtr> ConnectionMap;
+  // indexed by fd, an fd is not reused before its connection is removed
+  typedef std::vector<TcpConnectionPtr> ConnectionList;
+  typedef boost::weak_ptr<TcpConnection> WeakTcpConnectionPtr;
+  typedef std::set<WeakTcpConnectionPtr,
+                   boost::owner_less<WeakTcpConnectionPtr> > WeakConnectionSet;
+  // busyMicroseconds() of IO loops at the last check
+  typedef std::map<EventLoop*, int64_t> BusySamples;
 
   EventLoop* loop_;  // the acceptor loop
   const std::string name_;
   boost::scoped_ptr<Acceptor> acceptor_; // avoid revealing Acceptor
   boost::scoped_ptr<EventLoopThreadPool> threadPool_;
-  ConnectionCallback connectionCallback_;
-  MessageCallback messageCallback_;
-  WriteCompleteCallback writeCompleteCallback_;
+  // shared by connections
+  ConnectionOptionsPtr options_;
+  size_t readBudget_;
+  size_t zeroCopyThreshold_;
+  int maxConnections_;
+  OverflowPolicy overflowPolicy_;
+  double idleTimeout_;
+  double maxBusyRatio_;
+  int64_t maxBufferedBytes_;
+  double resumeRatio_;
+  double overloadCheckInterval_;
+  bool overloaded_;
   bool started_;
   int nextConnId_;  // always in loop thread
-  ConnectionMap connections_;
+  int numConnections_;  // always in loop thread
+  ConnectionList connections_;
+  TimerId overloadTimer_;
+  BusySamples busySamples_;
+  Timestamp lastOverloadCheck_;
+  BufferBudget bufferBudget_;
+  BufferBudgetCallback bufferBudgetCallback_;
+  double budgetCheckInterval_;
+  bool budgetExceeded_;
+  TimerId budgetTimer_;
+  WeakConnectionSet budgetPaused_;
+  int minThreads_;
+  int maxThreads_;
+  double growRatio_;
+  double shrinkRatio_;
+  double elasticInterval_;
+  TimerId elasticTimer_;
+  BusySamples elasticSamples_;
+  Timestamp lastElasticCheck_;
+  EventLoop* retiringLoop_;  // one at a time, or NULL
+  bool retiringDrained_;  // no connection left at the last check
+  int retiringPasses_;  // drain passes that left connections behind
 };
 
 }
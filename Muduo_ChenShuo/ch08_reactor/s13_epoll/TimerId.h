@@ -29,7 +29,7 @@ class TimerId : public muduo::copyable
 
   // default copy-ctor, dtor and assignment are okay
 
-  friend class TimerQueue;
+  template <typename Loop> friend class BasicTimerQueue;
 
  private:
   Timer* timer_;
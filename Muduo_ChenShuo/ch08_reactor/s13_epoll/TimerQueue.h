@@ -14,26 +14,41 @@
 #include <muduo/base/noncopyable.h>
 
 #include <muduo/base/Timestamp.h>
-#include <muduo/base/Mutex.h>
 #include "Callbacks.h"
 #include "Channel.h"
+#include "Timer.h"
+#include "TimerId.h"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
 
 namespace muduo
 {
 
-class EventLoop;
-class Timer;
-class TimerId;
+namespace detail
+{
+
+// timerfd(2) helpers, in TimerQueue.cc
+int createTimerfd();
+void readTimerfd(int timerfd, Timestamp now);
+void resetTimerfd(int timerfd, Timestamp expiration);
+
+}
 
 ///
-/// A best efforts timer queue.
+/// A best efforts timer queue, the timer policy of BasicEventLoop.
 /// No guarantee that the callback will be on time.
 ///
-class TimerQueue : muduo::noncopyable
+template <typename Loop>
+class BasicTimerQueue : muduo::noncopyable
 {
  public:
-  TimerQueue(EventLoop* loop);
-  ~TimerQueue();
+  BasicTimerQueue(Loop* loop);
+  ~BasicTimerQueue();
 
   ///
   /// Schedules the callback to be run at given time,
@@ -64,9 +79,9 @@ class TimerQueue : muduo::noncopyable
 
   bool insert(Timer* timer);
 
-  EventLoop* loop_;
+  Loop* loop_;
   const int timerfd_;
-  Channel timerfdChannel_;
+  BasicChannel<Loop> timerfdChannel_;
   // Timer list sorted by expiration
   TimerList timers_;
 
@@ -76,5 +91,191 @@ class TimerQueue : muduo::noncopyable
   ActiveTimerSet cancelingTimers_;
 };
 
+typedef BasicTimerQueue<EventLoop> TimerQueue;
+
+template <typename Loop>
+BasicTimerQueue<Loop>::BasicTimerQueue(Loop* loop)
+  : loop_(loop),
+    timerfd_(detail::createTimerfd()),
+    timerfdChannel_(loop, timerfd_),
+    timers_(),
+    callingExpiredTimers_(false)
+{
+  timerfdChannel_.setReadCallback(
+      boost::bind(&BasicTimerQueue::handleRead, this));
+  // we are always reading the timerfd, we disarm it with timerfd_settime.
+  timerfdChannel_.enableReading();
+}
+
+template <typename Loop>
+BasicTimerQueue<Loop>::~BasicTimerQueue()
+{
+  ::close(timerfd_);
+  // do not remove channel, since we're in EventLoop::dtor();
+  for (typename TimerList::iterator it = timers_.begin();
+      it != timers_.end(); ++it)
+  {
+    delete it->second;
+  }
+}
+
+template <typename Loop>
+TimerId BasicTimerQueue<Loop>::addTimer(const TimerCallback& cb,
+                                        Timestamp when,
+                                        double interval)
+{
+  Timer* timer = new Timer(cb, when, interval);
+  loop_->runInLoop(
+      boost::bind(&BasicTimerQueue::addTimerInLoop, this, timer));
+  return TimerId(timer, timer->sequence());
+}
+
+template <typename Loop>
+void BasicTimerQueue<Loop>::cancel(TimerId timerId)
+{
+  loop_->runInLoop(
+      boost::bind(&BasicTimerQueue::cancelInLoop, this, timerId));
+}
+
+template <typename Loop>
+void BasicTimerQueue<Loop>::addTimerInLoop(Timer* timer)
+{
+  loop_->assertInLoopThread();
+  bool earliestChanged = insert(timer);
+
+  if (earliestChanged)
+  {
+    detail::resetTimerfd(timerfd_, timer->expiration());
+  }
+}
+
+template <typename Loop>
+void BasicTimerQueue<Loop>::cancelInLoop(TimerId timerId)
+{
+  loop_->assertInLoopThread();
+  assert(timers_.size() == activeTimers_.size());
+  ActiveTimer timer(timerId.timer_, timerId.sequence_);
+  typename ActiveTimerSet::iterator it = activeTimers_.find(timer);
+  if (it != activeTimers_.end())
+  {
+    size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
+    assert(n == 1); (void)n;
+    delete it->first; // FIXME: no delete please
+    activeTimers_.erase(it);
+  }
+  else if (callingExpiredTimers_)
+  {
+    cancelingTimers_.insert(timer);
+  }
+  assert(timers_.size() == activeTimers_.size());
+}
+
+template <typename Loop>
+void BasicTimerQueue<Loop>::handleRead()
+{
+  loop_->assertInLoopThread();
+  Timestamp now(Timestamp::now());
+  detail::readTimerfd(timerfd_, now);
+
+  std::vector<Entry> expired = getExpired(now);
+
+  callingExpiredTimers_ = true;
+  cancelingTimers_.clear();
+  // safe to callback outside critical section
+  for (typename std::vector<Entry>::iterator it = expired.begin();
+      it != expired.end(); ++it)
+  {
+    it->second->run();
+  }
+  callingExpiredTimers_ = false;
+
+  reset(expired, now);
+}
+
+template <typename Loop>
+std::vector<typename BasicTimerQueue<Loop>::Entry>
+BasicTimerQueue<Loop>::getExpired(Timestamp now)
+{
+  assert(timers_.size() == activeTimers_.size());
+  std::vector<Entry> expired;
+  Entry sentry = std::make_pair(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
+  typename TimerList::iterator it = timers_.lower_bound(sentry);
+  assert(it == timers_.end() || now < it->first);
+  std::copy(timers_.begin(), it, back_inserter(expired));
+  timers_.erase(timers_.begin(), it);
+
+  BOOST_FOREACH(Entry entry, expired)
+  {
+    ActiveTimer timer(entry.second, entry.second->sequence());
+    size_t n = activeTimers_.erase(timer);
+    assert(n == 1); (void)n;
+  }
+
+  assert(timers_.size() == activeTimers_.size());
+  return expired;
+}
+
+template <typename Loop>
+void BasicTimerQueue<Loop>::reset(const std::vector<Entry>& expired,
+                                  Timestamp now)
+{
+  Timestamp nextExpire;
+
+  for (typename std::vector<Entry>::const_iterator it = expired.begin();
+      it != expired.end(); ++it)
+  {
+    ActiveTimer timer(it->second, it->second->sequence());
+    if (it->second->repeat()
+        && cancelingTimers_.find(timer) == cancelingTimers_.end())
+    {
+      it->second->restart(now);
+      insert(it->second);
+    }
+    else
+    {
+      // FIXME move to a free list
+      delete it->second;
+    }
+  }
+
+  if (!timers_.empty())
+  {
+    nextExpire = timers_.begin()->second->expiration();
+  }
+
+  if (nextExpire.valid())
+  {
+    detail::resetTimerfd(timerfd_, nextExpire);
+  }
+}
+
+template <typename Loop>
+bool BasicTimerQueue<Loop>::insert(Timer* timer)
+{
+  loop_->assertInLoopThread();
+  assert(timers_.size() == activeTimers_.size());
+  bool earliestChanged = false;
+  Timestamp when = timer->expiration();
+  typename TimerList::iterator it = timers_.begin();
+  if (it == timers_.end() || when < it->first)
+  {
+    earliestChanged = true;
+  }
+
+  {
+    std::pair<typename TimerList::iterator, bool> result
+      = timers_.insert(Entry(when, timer));
+    assert(result.second); (void)result;
+  }
+  {
+    std::pair<typename ActiveTimerSet::iterator, bool> result
+      = activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
+    assert(result.second); (void)result;
+  }
+
+  assert(timers_.size() == activeTimers_.size());
+  return earliestChanged;
+}
+
 }
 #endif  // MUDUO_NET_TIMERQUEUE_H
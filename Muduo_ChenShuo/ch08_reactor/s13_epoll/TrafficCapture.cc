@@ -0,0 +1,224 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "TrafficCapture.h"
+
+#include <muduo/base/Logging.h>
+#include "SocketsOps.h"
+
+#include <boost/bind.hpp>
+
+#include <string.h>  // memcpy
+
+using namespace muduo;
+
+namespace
+{
+
+const char kMagic[] = "MUDUOCAP1\n";
+const size_t kMagicLen = sizeof kMagic - 1;
+const size_t kRecordHeaderLen = 1 + 4 + 8 + 4;
+// full buffers waiting for the disk, then records are dropped
+const size_t kMaxPendingBuffers = 16;
+const double kFlushInterval = 1.0;
+
+}
+
+TrafficRecorder::TrafficRecorder(const std::string& filename,
+                                 size_t bufferSize)
+  : filename_(filename),
+    bufferSize_(bufferSize),
+    file_(NULL),
+    thread_(boost::bind(&TrafficRecorder::threadFunc, this), "TrafficRecorder"),
+    cond_(mutex_),
+    running_(false)
+{
+  current_.reserve(bufferSize_);
+  // no copying of buffers when these grow
+  full_.reserve(kMaxPendingBuffers + 1);
+  spare_.reserve(2);
+}
+
+TrafficRecorder::~TrafficRecorder()
+{
+  stop();
+}
+
+bool TrafficRecorder::start()
+{
+  assert(file_ == NULL);
+  file_ = ::fopen(filename_.c_str(), "wb");
+  if (file_ == NULL)
+  {
+    LOG_SYSERR << "TrafficRecorder::start - " << filename_;
+    return false;
+  }
+  ::fwrite(kMagic, 1, kMagicLen, file_);
+  {
+    MutexLockGuard lock(mutex_);
+    running_ = true;
+  }
+  thread_.start();
+  return true;
+}
+
+void TrafficRecorder::stop()
+{
+  {
+    MutexLockGuard lock(mutex_);
+    if (!running_)
+    {
+      return;
+    }
+    running_ = false;
+    cond_.notify();
+  }
+  thread_.join();
+  ::fclose(file_);
+  file_ = NULL;
+}
+
+void TrafficRecorder::record(TrafficEvent::Type type, int connId,
+                             Timestamp when, const char* data, size_t len)
+{
+  char header[kRecordHeaderLen];
+  uint32_t id32 = sockets::hostToNetwork32(static_cast<uint32_t>(connId));
+  uint64_t when64 = sockets::hostToNetwork64(
+      static_cast<uint64_t>(when.microSecondsSinceEpoch()));
+  uint32_t len32 = sockets::hostToNetwork32(static_cast<uint32_t>(len));
+  header[0] = static_cast<char>(type);
+  memcpy(header + 1, &id32, sizeof id32);
+  memcpy(header + 5, &when64, sizeof when64);
+  memcpy(header + 13, &len32, sizeof len32);
+
+  const size_t size = sizeof header + len;
+  MutexLockGuard lock(mutex_);
+  if (!running_)
+  {
+    droppedBytes_.add(size);
+    return;
+  }
+  if (current_.size() + size > bufferSize_ && !current_.empty())
+  {
+    if (full_.size() >= kMaxPendingBuffers)
+    {
+      droppedBytes_.add(size);
+      return;
+    }
+    full_.push_back(std::string());
+    full_.back().swap(current_);
+    if (!spare_.empty())
+    {
+      current_.swap(spare_.back());
+      spare_.pop_back();
+    }
+    else
+    {
+      current_.reserve(bufferSize_);
+    }
+    cond_.notify();
+  }
+  current_.append(header, sizeof header);
+  current_.append(data, len);
+}
+
+void TrafficRecorder::threadFunc()
+{
+  std::vector<std::string> buffers;
+  buffers.reserve(kMaxPendingBuffers + 1);
+  bool running = true;
+  while (running)
+  {
+    {
+      MutexLockGuard lock(mutex_);
+      if (full_.empty() && running_)
+      {
+        cond_.waitForSeconds(kFlushInterval);
+      }
+      buffers.swap(full_);
+      if (!current_.empty())
+      {
+        buffers.push_back(std::string());
+        buffers.back().swap(current_);
+        if (!spare_.empty())
+        {
+          current_.swap(spare_.back());
+          spare_.pop_back();
+        }
+      }
+      running = running_;
+    }
+
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+      size_t n = ::fwrite(buffers[i].data(), 1, buffers[i].size(), file_);
+      if (n != buffers[i].size())
+      {
+        LOG_SYSERR << "TrafficRecorder - " << filename_;
+        droppedBytes_.add(buffers[i].size() - n);
+      }
+      writtenBytes_.add(n);
+    }
+    ::fflush(file_);
+
+    MutexLockGuard lock(mutex_);
+    for (size_t i = 0; i < buffers.size() && spare_.size() < 2; ++i)
+    {
+      buffers[i].clear();
+      spare_.push_back(std::string());
+      spare_.back().swap(buffers[i]);
+    }
+    buffers.clear();
+  }
+}
+
+TrafficReader::TrafficReader(const std::string& filename)
+  : file_(::fopen(filename.c_str(), "rb"))
+{
+  char magic[kMagicLen];
+  if (file_ == NULL)
+  {
+    LOG_SYSERR << "TrafficReader - " << filename;
+  }
+  else if (::fread(magic, 1, kMagicLen, file_) != kMagicLen
+           || memcmp(magic, kMagic, kMagicLen) != 0)
+  {
+    LOG_ERROR << "TrafficReader - " << filename << " is not a capture";
+    ::fclose(file_);
+    file_ = NULL;
+  }
+}
+
+TrafficReader::~TrafficReader()
+{
+  if (file_)
+  {
+    ::fclose(file_);
+  }
+}
+
+bool TrafficReader::next(TrafficEvent* event)
+{
+  char header[kRecordHeaderLen];
+  if (file_ == NULL
+      || ::fread(header, 1, sizeof header, file_) != sizeof header)
+  {
+    return false;
+  }
+  uint32_t id32 = 0;
+  uint64_t when64 = 0;
+  uint32_t len32 = 0;
+  memcpy(&id32, header + 1, sizeof id32);
+  memcpy(&when64, header + 5, sizeof when64);
+  memcpy(&len32, header + 13, sizeof len32);
+  event->type = static_cast<TrafficEvent::Type>(header[0]);
+  event->connId = static_cast<int>(sockets::networkToHost32(id32));
+  event->when = Timestamp(static_cast<int64_t>(sockets::networkToHost64(when64)));
+  size_t len = sockets::networkToHost32(len32);
+  event->data.resize(len);
+  return len == 0 || ::fread(&event->data[0], 1, len, file_) == len;
+}
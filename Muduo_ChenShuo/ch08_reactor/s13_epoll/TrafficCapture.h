@@ -0,0 +1,115 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TRAFFICCAPTURE_H
+#define MUDUO_NET_TRAFFICCAPTURE_H
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Condition.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/noncopyable.h>
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+namespace muduo
+{
+
+///
+/// A capture file is the magic "MUDUOCAP1\n", then records of
+///   uint8  type       TrafficEvent::Type
+///   uint32 connection id of the connection in its TcpServer
+///   int64  time       microseconds since epoch
+///   uint32 length     of the bytes that follow, 0 but for kData
+/// in network byte order.
+///
+struct TrafficEvent
+{
+  enum Type { kOpen = 1, kData = 2, kClose = 3 };
+
+  Type type;
+  int connId;
+  Timestamp when;
+  std::string data;
+};
+
+///
+/// Writes the bytes received by connections to a capture file.
+///
+/// record() appends to an in-memory buffer, a background thread writes
+/// the full buffers, and the current one at least once a second.
+/// When the disk falls behind by more than a few buffers, records are
+/// dropped and counted, the connections are never blocked.
+///
+/// Install it with TcpServer::setTrafficRecorder().
+///
+class TrafficRecorder : muduo::noncopyable
+{
+ public:
+  explicit TrafficRecorder(const std::string& filename,
+                           size_t bufferSize = 4*1024*1024);
+  /// Stops and flushes, if not yet stopped.
+  ~TrafficRecorder();
+
+  /// Opens the file, false on error.
+  bool start();
+  /// Writes what is buffered and closes the file.
+  void stop();
+
+  /// Thread safe.
+  void record(TrafficEvent::Type type, int connId, Timestamp when,
+              const char* data, size_t len);
+
+  /// Bytes of records written or dropped, thread safe.
+  int64_t writtenBytes() const { return writtenBytes_.get(); }
+  int64_t droppedBytes() const { return droppedBytes_.get(); }
+
+ private:
+  void threadFunc();
+
+  const std::string filename_;
+  const size_t bufferSize_;
+  FILE* file_;
+  Thread thread_;
+  mutable AtomicInt64 writtenBytes_;
+  mutable AtomicInt64 droppedBytes_;
+  MutexLock mutex_;
+  Condition cond_;
+  bool running_;                   // @GuardedBy mutex_
+  std::string current_;            // @GuardedBy mutex_
+  std::vector<std::string> full_;  // @GuardedBy mutex_
+  std::vector<std::string> spare_; // @GuardedBy mutex_, empty with capacity
+};
+
+///
+/// Reads a capture file, event by event.
+///
+class TrafficReader : muduo::noncopyable
+{
+ public:
+  explicit TrafficReader(const std::string& filename);
+  ~TrafficReader();
+
+  /// False if the file can't be opened or isn't a capture.
+  bool valid() const { return file_ != NULL; }
+
+  /// False at the end of the file, or at a truncated record.
+  bool next(TrafficEvent* event);
+
+ private:
+  FILE* file_;
+};
+
+}
+
+#endif  // MUDUO_NET_TRAFFICCAPTURE_H
@@ -0,0 +1,226 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "TrafficReplayer.h"
+
+#include <muduo/base/Logging.h>
+#include "EventLoop.h"
+#include "TcpClient.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+using namespace muduo;
+
+namespace
+{
+
+const int kMaxConnectRetries = 3;
+
+// the last reference goes with the functor, after the caller returned
+template <typename T>
+void destroyLater(const boost::shared_ptr<T>&)
+{
+}
+
+}
+
+struct TrafficReplayer::Session
+{
+  Session(EventLoop* loop, const InetAddress& serverAddr, int id)
+    : client(loop, serverAddr),
+      connId(id),
+      shutdownDue(false)
+  {
+  }
+
+  TcpClient client;
+  const int connId;  // in the capture
+  TcpConnectionPtr conn;
+  Buffer pending;    // due before the connection was made
+  bool shutdownDue;  // closed in the capture before it was made
+};
+
+TrafficReplayer::TrafficReplayer(EventLoop* loop,
+                                 const InetAddress& serverAddr,
+                                 const std::string& filename,
+                                 double speed)
+  : loop_(CHECK_NOTNULL(loop)),
+    serverAddr_(serverAddr),
+    reader_(filename),
+    speed_(speed),
+    haveNext_(false),
+    numConnections_(0),
+    numFailed_(0),
+    numActive_(0),
+    maxConcurrency_(0),
+    bytesSent_(0),
+    bytesReceived_(0),
+    maxLag_(0),
+    elapsed_(0),
+    finished_(false)
+{
+}
+
+TrafficReplayer::~TrafficReplayer()
+{
+  loop_->assertInLoopThread();
+}
+
+bool TrafficReplayer::start()
+{
+  loop_->assertInLoopThread();
+  if (!reader_.valid())
+  {
+    return false;
+  }
+  startTime_ = Timestamp::now();
+  haveNext_ = reader_.next(&next_);
+  if (haveNext_)
+  {
+    firstEventTime_ = next_.when;
+  }
+  playDue();
+  return true;
+}
+
+void TrafficReplayer::playDue()
+{
+  const double now = timeDifference(Timestamp::now(), startTime_);
+  while (haveNext_)
+  {
+    const double due = speed_ > 0
+        ? timeDifference(next_.when, firstEventTime_) / speed_
+        : 0;
+    if (due > now)
+    {
+      loop_->runAfter(due - now, boost::bind(&TrafficReplayer::playDue, this));
+      return;
+    }
+    maxLag_ = std::max(maxLag_, now - due);
+    play(next_);
+    haveNext_ = reader_.next(&next_);
+  }
+  checkFinished();
+}
+
+void TrafficReplayer::play(const TrafficEvent& event)
+{
+  if (event.type == TrafficEvent::kOpen)
+  {
+    SessionPtr session(new Session(loop_, serverAddr_, event.connId));
+    session->client.setConnectionCallback(
+        boost::bind(&TrafficReplayer::onConnection, this, get_pointer(session), _1));
+    session->client.setMessageCallback(
+        boost::bind(&TrafficReplayer::onMessage, this, _1, _2, _3));
+    session->client.setMaxConnectRetries(kMaxConnectRetries);
+    session->client.setConnectFailedCallback(
+        boost::bind(&TrafficReplayer::onConnectFailed, this, get_pointer(session)));
+    sessions_[event.connId] = session;
+    ++numConnections_;
+    maxConcurrency_ = std::max(maxConcurrency_, ++numActive_);
+    session->client.connect();
+    return;
+  }
+
+  std::map<int, SessionPtr>::iterator it = sessions_.find(event.connId);
+  if (it == sessions_.end())
+  {
+    // opened before the capture, or closed by the server
+    return;
+  }
+  Session* session = get_pointer(it->second);
+  if (event.type == TrafficEvent::kData)
+  {
+    bytesSent_ += event.data.size();
+    if (session->conn)
+    {
+      session->conn->send(event.data);
+    }
+    else
+    {
+      session->pending.append(event.data);
+    }
+  }
+  else if (event.type == TrafficEvent::kClose)
+  {
+    if (session->conn)
+    {
+      session->conn->shutdown();
+    }
+    else
+    {
+      session->shutdownDue = true;
+    }
+  }
+  else
+  {
+    LOG_ERROR << "TrafficReplayer - unknown event " << event.type;
+  }
+}
+
+void TrafficReplayer::onConnection(Session* session,
+                                   const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    session->conn = conn;
+    if (session->pending.readableBytes() > 0)
+    {
+      conn->send(&session->pending);
+    }
+    if (session->shutdownDue)
+    {
+      conn->shutdown();
+    }
+    return;
+  }
+
+  session->conn.reset();
+  closeSession(session);
+}
+
+void TrafficReplayer::onConnectFailed(Session* session)
+{
+  LOG_WARN << "TrafficReplayer - connection " << session->connId
+           << " refused, given up";
+  ++numFailed_;
+  closeSession(session);
+}
+
+void TrafficReplayer::closeSession(Session* session)
+{
+  std::map<int, SessionPtr>::iterator it = sessions_.find(session->connId);
+  assert(it != sessions_.end() && get_pointer(it->second) == session);
+  // its TcpClient is calling us, don't destroy it here
+  loop_->queueInLoop(boost::bind(&destroyLater<Session>, it->second));
+  sessions_.erase(it);
+  --numActive_;
+  checkFinished();
+}
+
+void TrafficReplayer::onMessage(const TcpConnectionPtr&,
+                                Buffer* buf,
+                                Timestamp)
+{
+  bytesReceived_ += buf->readableBytes();
+  buf->retrieveAll();
+}
+
+void TrafficReplayer::checkFinished()
+{
+  if (!haveNext_ && numActive_ == 0 && !finished_)
+  {
+    finished_ = true;
+    elapsed_ = timeDifference(Timestamp::now(), startTime_);
+    if (finishCallback_)
+    {
+      finishCallback_();
+    }
+  }
+}
@@ -0,0 +1,108 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TRAFFICREPLAYER_H
+#define MUDUO_NET_TRAFFICREPLAYER_H
+
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "TrafficCapture.h"
+#include "EventLoopFwd.h"
+
+#include <muduo/base/noncopyable.h>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+
+namespace muduo
+{
+
+///
+/// Plays a capture file of TrafficRecorder to a server.
+///
+/// Each captured connection becomes a TcpClient connection, opened,
+/// fed and shut down at the captured times, so the server sees the same
+/// bytes with the same concurrency.  Bytes due before their connection
+/// is connected wait for it.  Replies are counted and dropped.
+/// A connection that can't be made is given up after a few retries,
+/// and counted as closed.
+///
+class TrafficReplayer : muduo::noncopyable
+{
+ public:
+  typedef boost::function<void()> FinishCallback;
+
+  /// @param speed 1 replays at the captured pace, 2 twice as fast,
+  ///        0 as fast as possible.
+  TrafficReplayer(EventLoop* loop,
+                  const InetAddress& serverAddr,
+                  const std::string& filename,
+                  double speed);
+  /// Must be called in the loop thread, after the replay finished.
+  ~TrafficReplayer();
+
+  /// Called when all captured events are played and all connections
+  /// are closed.
+  void setFinishCallback(const FinishCallback& cb)
+  { finishCallback_ = cb; }
+
+  /// False if the file can't be read.  Must be called in the loop thread.
+  bool start();
+
+  /// Must be called in the loop thread.
+  int numConnections() const { return numConnections_; }
+  /// Connections given up as the server refused them.
+  int numFailed() const { return numFailed_; }
+  int maxConcurrency() const { return maxConcurrency_; }
+  int64_t bytesSent() const { return bytesSent_; }
+  int64_t bytesReceived() const { return bytesReceived_; }
+  /// The most an event was played after its time.
+  double maxLag() const { return maxLag_; }
+  /// From start() to the finish.
+  double elapsed() const { return elapsed_; }
+
+ private:
+  struct Session;
+  typedef boost::shared_ptr<Session> SessionPtr;
+
+  void playDue();
+  void play(const TrafficEvent& event);
+  void onConnection(Session* session, const TcpConnectionPtr& conn);
+  void onConnectFailed(Session* session);
+  void closeSession(Session* session);
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp);
+  void checkFinished();
+
+  EventLoop* loop_;
+  const InetAddress serverAddr_;
+  TrafficReader reader_;
+  const double speed_;
+  FinishCallback finishCallback_;
+  TrafficEvent next_;
+  bool haveNext_;
+  Timestamp startTime_;
+  Timestamp firstEventTime_;
+  // by captured connection id, the live ones
+  std::map<int, SessionPtr> sessions_;
+  int numConnections_;
+  int numFailed_;
+  int numActive_;
+  int maxConcurrency_;
+  int64_t bytesSent_;
+  int64_t bytesReceived_;
+  double maxLag_;
+  double elapsed_;
+  bool finished_;
+};
+
+}
+
+#endif  // MUDUO_NET_TRAFFICREPLAYER_H
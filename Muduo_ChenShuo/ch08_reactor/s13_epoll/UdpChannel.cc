@@ -0,0 +1,206 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "UdpChannel.h"
+
+#include <muduo/base/Logging.h>
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "SocketsOps.h"
+
+#include <boost/bind.hpp>
+
+#include <errno.h>
+#include <strings.h>  // bzero
+
+using namespace muduo;
+
+const int UdpChannel::kBatchSize;
+const size_t UdpChannel::kMaxDatagramSize;
+
+UdpChannel::UdpChannel(EventLoop* loop, const InetAddress& listenAddr)
+  : loop_(CHECK_NOTNULL(loop)),
+    socket_(sockets::createNonblockingUdpOrDie()),
+    channel_(loop, socket_.fd()),
+    handlingRead_(false),
+    recvData_(kBatchSize * kMaxDatagramSize),
+    recvIovecs_(kBatchSize),
+    recvAddrs_(kBatchSize),
+    recvMsgs_(kBatchSize),
+    numPending_(0),
+    sendData_(kBatchSize * kMaxDatagramSize),
+    sendIovecs_(kBatchSize),
+    sendAddrs_(kBatchSize),
+    sendMsgs_(kBatchSize)
+{
+  socket_.setReuseAddr(true);
+  socket_.setReusePort(true);
+  socket_.bindAddress(listenAddr);
+
+  bzero(&recvMsgs_[0], kBatchSize * sizeof recvMsgs_[0]);
+  bzero(&sendMsgs_[0], kBatchSize * sizeof sendMsgs_[0]);
+  for (int i = 0; i < kBatchSize; ++i)
+  {
+    recvIovecs_[i].iov_base = &recvData_[i * kMaxDatagramSize];
+    recvIovecs_[i].iov_len = kMaxDatagramSize;
+    recvMsgs_[i].msg_hdr.msg_iov = &recvIovecs_[i];
+    recvMsgs_[i].msg_hdr.msg_iovlen = 1;
+    recvMsgs_[i].msg_hdr.msg_name = &recvAddrs_[i];
+
+    sendIovecs_[i].iov_base = &sendData_[i * kMaxDatagramSize];
+    sendMsgs_[i].msg_hdr.msg_iov = &sendIovecs_[i];
+    sendMsgs_[i].msg_hdr.msg_iovlen = 1;
+    sendMsgs_[i].msg_hdr.msg_name = &sendAddrs_[i];
+    sendMsgs_[i].msg_hdr.msg_namelen = sizeof sendAddrs_[i];
+  }
+
+  channel_.setReadCallback(
+      boost::bind(&UdpChannel::handleRead, this, _1));
+  channel_.setWriteCallback(
+      boost::bind(&UdpChannel::handleWrite, this));
+}
+
+UdpChannel::~UdpChannel()
+{
+}
+
+void UdpChannel::start()
+{
+  loop_->assertInLoopThread();
+  channel_.enableReading();
+}
+
+void UdpChannel::stop()
+{
+  loop_->assertInLoopThread();
+  channel_.disableAll();
+  loop_->removeChannel(&channel_);
+}
+
+void UdpChannel::handleRead(Timestamp receiveTime)
+{
+  loop_->assertInLoopThread();
+  for (int i = 0; i < kBatchSize; ++i)
+  {
+    recvMsgs_[i].msg_hdr.msg_namelen = sizeof recvAddrs_[i];
+  }
+  // one batch per event, the channel is level-triggered
+  int n = ::recvmmsg(socket_.fd(), &recvMsgs_[0], kBatchSize, 0, NULL);
+  if (n < 0)
+  {
+    if (errno != EAGAIN)
+    {
+      LOG_SYSERR << "UdpChannel::handleRead";
+    }
+    return;
+  }
+
+  numReceived_.add(n);
+  handlingRead_ = true;
+  for (int i = 0; i < n; ++i)
+  {
+    if (recvMsgs_[i].msg_hdr.msg_flags & MSG_TRUNC)
+    {
+      LOG_WARN << "UdpChannel::handleRead - datagram truncated to "
+               << kMaxDatagramSize << " bytes";
+    }
+    if (messageCallback_)
+    {
+      InetAddress peerAddr(recvAddrs_[i]);
+      messageCallback_(this,
+                       &recvData_[i * kMaxDatagramSize],
+                       recvMsgs_[i].msg_len,
+                       peerAddr,
+                       receiveTime);
+    }
+  }
+  handlingRead_ = false;
+  flush();
+}
+
+void UdpChannel::send(const InetAddress& peerAddr, const void* data, size_t len)
+{
+  loop_->assertInLoopThread();
+  if (len > kMaxDatagramSize)
+  {
+    LOG_ERROR << "UdpChannel::send - datagram of " << len << " bytes is too big";
+    numDropped_.increment();
+    return;
+  }
+  if (numPending_ == kBatchSize)
+  {
+    flush();
+    if (numPending_ == kBatchSize)
+    {
+      numDropped_.increment();
+      return;
+    }
+  }
+
+  int slot = numPending_++;
+  ::memcpy(sendIovecs_[slot].iov_base, data, len);
+  sendIovecs_[slot].iov_len = len;
+  sendAddrs_[slot] = peerAddr.getSockAddrInet();
+  if (!handlingRead_)
+  {
+    flush();
+  }
+}
+
+void UdpChannel::handleWrite()
+{
+  loop_->assertInLoopThread();
+  flush();
+}
+
+void UdpChannel::flush()
+{
+  if (numPending_ == 0)
+  {
+    return;
+  }
+
+  int n = ::sendmmsg(socket_.fd(), &sendMsgs_[0], numPending_, 0);
+  if (n < 0)
+  {
+    if (errno == EAGAIN)
+    {
+      n = 0;
+    }
+    else
+    {
+      LOG_SYSERR << "UdpChannel::flush";
+      // drop the head, which is the one failed
+      n = 1;
+      numDropped_.increment();
+    }
+  }
+  else
+  {
+    numSent_.add(n);
+  }
+
+  // move the unsent ones to the front
+  for (int i = n; i < numPending_; ++i)
+  {
+    ::memcpy(sendIovecs_[i-n].iov_base,
+             sendIovecs_[i].iov_base,
+             sendIovecs_[i].iov_len);
+    sendIovecs_[i-n].iov_len = sendIovecs_[i].iov_len;
+    sendAddrs_[i-n] = sendAddrs_[i];
+  }
+  numPending_ -= n;
+
+  if (numPending_ > 0 && !channel_.isWriting())
+  {
+    channel_.enableWriting();
+  }
+  else if (numPending_ == 0 && channel_.isWriting())
+  {
+    channel_.disableWriting();
+  }
+}
@@ -0,0 +1,95 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_NET_UDPCHANNEL_H
+#define MUDUO_NET_UDPCHANNEL_H
+
+#include "Callbacks.h"
+#include "Channel.h"
+#include "Socket.h"
+#include "EventLoopFwd.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/noncopyable.h>
+
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace muduo
+{
+
+class InetAddress;
+
+///
+/// A UDP socket in one loop, reads with recvmmsg(2), writes with sendmmsg(2).
+///
+/// All datagrams are copied in and out of slots preallocated at construction.
+class UdpChannel : muduo::noncopyable
+{
+ public:
+  static const int kBatchSize = 64;
+  static const size_t kMaxDatagramSize = 2048;
+
+  /// Binds to @c listenAddr with SO_REUSEPORT, so that several
+  /// UdpChannel can share one port.
+  UdpChannel(EventLoop* loop, const InetAddress& listenAddr);
+  ~UdpChannel();
+
+  EventLoop* getLoop() const { return loop_; }
+
+  void setMessageCallback(const UdpMessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Starts reading, must be called in the loop thread.
+  void start();
+  /// Stops reading, must be called in the loop thread.
+  void stop();
+
+  /// Queues a datagram to @c peerAddr.
+  ///
+  /// Datagrams queued in the message callback are sent in one
+  /// sendmmsg(2) after the read batch, others are sent at once.
+  /// Must be called in the loop thread.
+  void send(const InetAddress& peerAddr, const void* data, size_t len);
+
+  // thread safe
+  int64_t numReceived() { return numReceived_.get(); }
+  int64_t numSent() { return numSent_.get(); }
+  int64_t numDropped() { return numDropped_.get(); }
+
+ private:
+  void handleRead(Timestamp receiveTime);
+  void handleWrite();
+  void flush();
+
+  EventLoop* loop_;
+  Socket socket_;
+  Channel channel_;
+  UdpMessageCallback messageCallback_;
+  bool handlingRead_;
+
+  std::vector<char> recvData_;
+  std::vector<struct iovec> recvIovecs_;
+  std::vector<struct sockaddr_in> recvAddrs_;
+  std::vector<struct mmsghdr> recvMsgs_;
+
+  int numPending_;
+  std::vector<char> sendData_;
+  std::vector<struct iovec> sendIovecs_;
+  std::vector<struct sockaddr_in> sendAddrs_;
+  std::vector<struct mmsghdr> sendMsgs_;
+
+  AtomicInt64 numReceived_;
+  AtomicInt64 numSent_;
+  AtomicInt64 numDropped_;
+};
+
+}
+
+#endif  // MUDUO_NET_UDPCHANNEL_H
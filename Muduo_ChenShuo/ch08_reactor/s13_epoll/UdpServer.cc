@@ -0,0 +1,93 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "UdpServer.h"
+
+#include <muduo/base/Logging.h>
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "UdpChannel.h"
+
+#include <boost/bind.hpp>
+
+using namespace muduo;
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr)
+  : loop_(CHECK_NOTNULL(loop)),
+    listenAddr_(listenAddr),
+    started_(false),
+    threadPool_(new EventLoopThreadPool(loop))
+{
+}
+
+UdpServer::~UdpServer()
+{
+  loop_->assertInLoopThread();
+  for (size_t i = 0; i < channels_.size(); ++i)
+  {
+    // sockets in IO threads go away with their loops
+    if (channels_[i].getLoop() == loop_)
+    {
+      channels_[i].stop();
+    }
+  }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+  assert(0 <= numThreads);
+  threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+  loop_->assertInLoopThread();
+  assert(!started_);
+  started_ = true;
+  threadPool_->start();
+
+  std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    UdpChannel* channel = new UdpChannel(loops[i], listenAddr_);
+    channel->setMessageCallback(messageCallback_);
+    channels_.push_back(channel);
+    loops[i]->runInLoop(boost::bind(&UdpChannel::start, channel));
+  }
+  LOG_INFO << "UdpServer::start - " << loops.size()
+           << " sockets on " << listenAddr_.toHostPort();
+}
+
+int64_t UdpServer::numReceived()
+{
+  int64_t n = 0;
+  for (size_t i = 0; i < channels_.size(); ++i)
+  {
+    n += channels_[i].numReceived();
+  }
+  return n;
+}
+
+int64_t UdpServer::numSent()
+{
+  int64_t n = 0;
+  for (size_t i = 0; i < channels_.size(); ++i)
+  {
+    n += channels_[i].numSent();
+  }
+  return n;
+}
+
+int64_t UdpServer::numDropped()
+{
+  int64_t n = 0;
+  for (size_t i = 0; i < channels_.size(); ++i)
+  {
+    n += channels_[i].numDropped();
+  }
+  return n;
+}
@@ -0,0 +1,70 @@
+// excerpts from http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_NET_UDPSERVER_H
+#define MUDUO_NET_UDPSERVER_H
+
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "EventLoopFwd.h"
+
+#include <muduo/base/noncopyable.h>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace muduo
+{
+
+class EventLoopThreadPool;
+class UdpChannel;
+
+///
+/// UDP server, one SO_REUSEPORT socket per IO loop.
+///
+/// The kernel spreads datagrams over the sockets by their source address.
+class UdpServer : muduo::noncopyable
+{
+ public:
+
+  UdpServer(EventLoop* loop, const InetAddress& listenAddr);
+  ~UdpServer();  // force out-line dtor, for scoped_ptr members.
+
+  /// Set the number of threads for handling datagrams.
+  ///
+  /// Must be called before @c start
+  /// @param numThreads
+  /// - 0 means one socket in loop's thread, this is the default value.
+  /// - N means N threads, each one has its own socket.
+  void setThreadNum(int numThreads);
+
+  /// Starts the server, must be called once in loop's thread.
+  void start();
+
+  /// Set message callback, the @c UdpChannel argument replies to the peer.
+  /// Not thread safe.
+  void setMessageCallback(const UdpMessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Number of datagrams received, sent, dropped by all sockets.
+  /// Thread safe.
+  int64_t numReceived();
+  int64_t numSent();
+  int64_t numDropped();
+
+ private:
+  EventLoop* loop_;
+  const InetAddress listenAddr_;
+  UdpMessageCallback messageCallback_;
+  bool started_;
+  // destroyed after threadPool_, whose loops use them
+  boost::ptr_vector<UdpChannel> channels_;
+  boost::scoped_ptr<EventLoopThreadPool> threadPool_;
+};
+
+}
+
+#endif  // MUDUO_NET_UDPSERVER_H
@@ -0,0 +1,65 @@
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+
+std::string reply;
+int64_t numRequests = 0;
+int64_t lastRequests = 0;
+int64_t lastEpollCtl = 0;
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+  }
+}
+
+void onMessage(const muduo::TcpConnectionPtr& conn,
+               muduo::Buffer* buf,
+               muduo::Timestamp receiveTime)
+{
+  // every message is a request, answer it with a reply
+  buf->retrieveAll();
+  ++numRequests;
+  conn->send(reply);
+}
+
+void printStats(muduo::EventLoop* loop)
+{
+  int64_t requests = numRequests - lastRequests;
+  int64_t epollCtl = loop->numEpollCtl() - lastEpollCtl;
+  printf("%lld requests, %lld epoll_ctl, %.3f epoll_ctl per request\n",
+         static_cast<long long>(requests),
+         static_cast<long long>(epollCtl),
+         requests > 0 ? static_cast<double>(epollCtl) / requests : 0.0);
+  lastRequests = numRequests;
+  lastEpollCtl = loop->numEpollCtl();
+}
+
+int main(int argc, char* argv[])
+{
+  printf("main(): pid = %d\n", getpid());
+
+  int len = 256*1024;
+  if (argc > 1)
+  {
+    len = atoi(argv[1]);
+  }
+  reply.assign(len, 'R');
+
+  muduo::InetAddress listenAddr(9981);
+  muduo::EventLoop loop;
+
+  muduo::TcpServer server(&loop, listenAddr);
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.start();
+
+  loop.runEvery(1.0, boost::bind(printStats, &loop));
+  loop.loop();
+}
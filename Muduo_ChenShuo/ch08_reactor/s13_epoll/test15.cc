@@ -0,0 +1,105 @@
+// idle fds benchmark: registration and teardown of many channels.
+// build test15_poll for Poller, test15 for EPoller.
+
+#include "Channel.h"
+#include "EventLoop.h"
+
+#include <boost/bind.hpp>
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+int numChannels = 100*1000;
+int numRounds = 5;
+std::vector<int> fds;
+std::vector<muduo::Channel*> channels;
+muduo::EventLoop* g_loop;
+muduo::Timestamp start;
+int g_round = 0;
+
+void registerAll();
+
+void teardownAll()
+{
+  // channels have been added to the poller by the poll just returned
+  muduo::Timestamp registered(muduo::Timestamp::now());
+  double registerTime = timeDifference(registered, start);
+
+  for (int i = 0; i < numChannels; ++i)
+  {
+    channels[i]->disableAll();
+    g_loop->removeChannel(channels[i]);
+    delete channels[i];
+  }
+  channels.clear();
+  double teardownTime = timeDifference(muduo::Timestamp::now(), registered);
+
+  printf("round %d: %d channels, register %.3fs %.0f/s, teardown %.3fs %.0f/s\n",
+         g_round, numChannels,
+         registerTime, numChannels / registerTime,
+         teardownTime, numChannels / teardownTime);
+  if (++g_round < numRounds)
+  {
+    g_loop->runAfter(0, registerAll);
+  }
+  else
+  {
+    g_loop->quit();
+  }
+}
+
+void registerAll()
+{
+  start = muduo::Timestamp::now();
+  channels.reserve(numChannels);
+  for (int i = 0; i < numChannels; ++i)
+  {
+    muduo::Channel* channel = new muduo::Channel(g_loop, fds[i]);
+    channel->enableReading();
+    channels.push_back(channel);
+  }
+  // the next poll picks up the new channels
+  g_loop->runAfter(0, teardownAll);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1)
+  {
+    numChannels = atoi(argv[1]);
+  }
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+
+  struct rlimit rl;
+  ::getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = rl.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &rl);
+
+  for (int i = 0; i < numChannels; ++i)
+  {
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0)
+    {
+      perror("eventfd");
+      printf("only %d fds, raise RLIMIT_NOFILE\n", i);
+      numChannels = i;
+      break;
+    }
+    fds.push_back(fd);
+  }
+
+  loop.runAfter(0, registerAll);
+  loop.loop();
+
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    ::close(fds[i]);
+  }
+}
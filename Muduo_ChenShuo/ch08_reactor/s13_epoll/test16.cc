@@ -0,0 +1,74 @@
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <stdio.h>
+
+muduo::PayloadPtr payload;
+int64_t transferred = 0;
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    printf("onConnection(): new connection [%s] from %s\n",
+           conn->name().c_str(),
+           conn->peerAddress().toHostPort().c_str());
+    conn->send(payload);
+    transferred += payload->size();
+  }
+  else
+  {
+    printf("onConnection(): connection [%s] is down\n",
+           conn->name().c_str());
+  }
+}
+
+void onWriteComplete(const muduo::TcpConnectionPtr& conn)
+{
+  conn->send(payload);
+  transferred += payload->size();
+}
+
+void onMessage(const muduo::TcpConnectionPtr& conn,
+               muduo::Buffer* buf,
+               muduo::Timestamp receiveTime)
+{
+  buf->retrieveAll();
+}
+
+void printThroughput()
+{
+  printf("%.3f MiB/s\n", static_cast<double>(transferred) / (1024*1024));
+  transferred = 0;
+}
+
+int main(int argc, char* argv[])
+{
+  printf("main(): pid = %d\n", getpid());
+
+  int len = 1024*1024;
+  size_t threshold = 64*1024;
+  if (argc > 2)
+  {
+    len = atoi(argv[1]);
+    threshold = atoi(argv[2]);
+  }
+  payload = boost::make_shared<const std::string>(len, 'Z');
+
+  muduo::InetAddress listenAddr(9981);
+  muduo::EventLoop loop;
+
+  muduo::TcpServer server(&loop, listenAddr);
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.setWriteCompleteCallback(onWriteComplete);
+  server.setZeroCopyThreshold(threshold);
+  server.start();
+
+  loop.runEvery(1.0, printThroughput);
+  loop.loop();
+}
@@ -0,0 +1,105 @@
+// UDP echo server and load generator over loopback, prints packets/sec.
+// usage: test17 [server threads] [client threads] [datagram size]
+
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "SocketsOps.h"
+#include "UdpChannel.h"
+#include "UdpServer.h"
+
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const int kBatch = 64;
+int datagramSize = 64;
+bool running = true;
+muduo::UdpServer* g_server;
+int64_t lastReceived = 0;
+int64_t lastSent = 0;
+
+void onMessage(muduo::UdpChannel* channel,
+               const char* data,
+               size_t len,
+               const muduo::InetAddress& peerAddr,
+               muduo::Timestamp receiveTime)
+{
+  channel->send(peerAddr, data, len);
+}
+
+// blasts datagrams with sendmmsg(2), throws away the echoes
+void clientThread()
+{
+  int sockfd = ::socket(AF_INET, SOCK_DGRAM, 0);
+  muduo::InetAddress serverAddr("127.0.0.1", 9981);
+  struct sockaddr_in addr = serverAddr.getSockAddrInet();
+  ::connect(sockfd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr);
+
+  std::vector<char> data(datagramSize, 'U');
+  struct iovec iov = { &data[0], data.size() };
+  std::vector<struct mmsghdr> msgs(kBatch);
+  bzero(&msgs[0], kBatch * sizeof msgs[0]);
+  for (int i = 0; i < kBatch; ++i)
+  {
+    msgs[i].msg_hdr.msg_iov = &iov;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  while (running)
+  {
+    ::sendmmsg(sockfd, &msgs[0], kBatch, 0);
+  }
+  ::close(sockfd);
+}
+
+void printStats()
+{
+  int64_t received = g_server->numReceived();
+  int64_t sent = g_server->numSent();
+  printf("%lld packets/s received, %lld packets/s sent, %lld dropped\n",
+         static_cast<long long>(received - lastReceived),
+         static_cast<long long>(sent - lastSent),
+         static_cast<long long>(g_server->numDropped()));
+  lastReceived = received;
+  lastSent = sent;
+}
+
+int main(int argc, char* argv[])
+{
+  int numServerThreads = argc > 1 ? atoi(argv[1]) : 0;
+  int numClientThreads = argc > 2 ? atoi(argv[2]) : 1;
+  datagramSize = argc > 3 ? atoi(argv[3]) : 64;
+
+  muduo::EventLoop loop;
+  muduo::InetAddress listenAddr(9981);
+  muduo::UdpServer server(&loop, listenAddr);
+  g_server = &server;
+  server.setMessageCallback(onMessage);
+  server.setThreadNum(numServerThreads);
+  server.start();
+
+  boost::ptr_vector<muduo::Thread> clients;
+  for (int i = 0; i < numClientThreads; ++i)
+  {
+    clients.push_back(new muduo::Thread(clientThread));
+    clients.back().start();
+  }
+
+  loop.runEvery(1.0, printStats);
+  loop.runAfter(10.0, boost::bind(&muduo::EventLoop::quit, &loop));
+  loop.loop();
+
+  running = false;
+  for (int i = 0; i < numClientThreads; ++i)
+  {
+    clients[i].join();
+  }
+}
@@ -0,0 +1,148 @@
+#include "Coroutine.h"
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <stdio.h>
+
+// pingpong in one loop, with callbacks or with coroutines
+
+int messageSize = 4096;
+int64_t bytesRead = 0;
+bool running = true;
+
+void onServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+  }
+}
+
+void onServerMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp receiveTime)
+{
+  conn->send(buf->retrieveAsString());
+}
+
+void onClientConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    conn->send(std::string(messageSize, 'P'));
+  }
+}
+
+void onClientMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp receiveTime)
+{
+  bytesRead += buf->readableBytes();
+  if (running)
+  {
+    conn->send(buf->retrieveAsString());
+  }
+  else
+  {
+    buf->retrieveAll();
+  }
+}
+
+muduo::Task echoSession(muduo::CoConnection conn)
+{
+  for (;;)
+  {
+    std::string message = co_await conn.readExactly(messageSize);
+    if (message.empty() || !co_await conn.write(message))
+    {
+      break;
+    }
+  }
+}
+
+void onServerConnectionCo(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    echoSession(muduo::CoConnection(conn));
+  }
+}
+
+muduo::Task pingSession(muduo::CoClient* client)
+{
+  muduo::CoConnection conn = co_await client->connect();
+  conn.connection()->setTcpNoDelay(true);
+  std::string message(messageSize, 'P');
+  while (running)
+  {
+    co_await conn.write(message);
+    std::string reply = co_await conn.readExactly(messageSize);
+    if (reply.empty())
+    {
+      break;
+    }
+    bytesRead += reply.size();
+  }
+}
+
+void stop(muduo::EventLoop* loop, double seconds)
+{
+  running = false;
+  printf("%.3f MiB/s\n", static_cast<double>(bytesRead) / seconds / 1024 / 1024);
+  loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: test18 cb|co [connections] [size] [seconds]\n");
+    return 1;
+  }
+  bool coroutine = strcmp(argv[1], "co") == 0;
+  int numConnections = argc > 2 ? atoi(argv[2]) : 10;
+  messageSize = argc > 3 ? atoi(argv[3]) : 4096;
+  double seconds = argc > 4 ? atof(argv[4]) : 10.0;
+
+  muduo::EventLoop loop;
+  muduo::InetAddress serverAddr("127.0.0.1", 9981);
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  if (coroutine)
+  {
+    server.setConnectionCallback(onServerConnectionCo);
+  }
+  else
+  {
+    server.setConnectionCallback(onServerConnection);
+    server.setMessageCallback(onServerMessage);
+  }
+  server.start();
+
+  boost::ptr_vector<muduo::TcpClient> clients;
+  boost::ptr_vector<muduo::CoClient> coClients;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    if (coroutine)
+    {
+      coClients.push_back(new muduo::CoClient(&loop, serverAddr));
+      pingSession(&coClients.back());
+    }
+    else
+    {
+      clients.push_back(new muduo::TcpClient(&loop, serverAddr));
+      clients.back().setConnectionCallback(onClientConnection);
+      clients.back().setMessageCallback(onClientMessage);
+      clients.back().connect();
+    }
+  }
+
+  loop.runAfter(seconds, boost::bind(stop, &loop, seconds));
+  loop.loop();
+}
@@ -0,0 +1,191 @@
+// fan-out benchmark: one publisher, many subscribers of one topic.
+
+#include "PubSubHub.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int numSubscribers = 50*1000;
+const int kWindow = 16;  // messages in flight
+double seconds = 10.0;
+std::string content;
+muduo::PubSubHub* g_hub;
+muduo::EventLoop* g_loop;
+muduo::EventLoop* g_clientLoop;
+
+// in client loop
+std::vector<muduo::Channel*> subscribers;
+std::vector<bool> ready;  // indexed by fd, got a message
+int numReady = 0;
+bool running = false;
+int64_t received = 0;
+int64_t target = 0;
+int64_t lastReceived = 0;
+int64_t lastPublished = 0;
+long peakRss = 0;
+muduo::Timestamp start;
+
+long rssKb()
+{
+  long kb = 0;
+  char line[256];
+  FILE* fp = fopen("/proc/self/status", "r");
+  while (fp && fgets(line, sizeof line, fp))
+  {
+    if (sscanf(line, "VmRSS: %ld", &kb) == 1)
+      break;
+  }
+  if (fp)
+    fclose(fp);
+  return kb;
+}
+
+void publishWindow()
+{
+  for (int i = 0; i < kWindow; ++i)
+  {
+    g_hub->publish("bench", content);
+  }
+  target += static_cast<int64_t>(kWindow) * numSubscribers;
+}
+
+void onSubscriberRead(int fd, muduo::Timestamp)
+{
+  char buf[65536];
+  ssize_t n = ::read(fd, buf, sizeof buf);
+  if (n <= 0)
+  {
+    return;
+  }
+  received += std::count(buf, buf+n, '\n');
+  if (!ready[fd])
+  {
+    ready[fd] = true;
+    ++numReady;
+  }
+  if (running && received >= target)
+  {
+    publishWindow();
+  }
+}
+
+void printStats()
+{
+  long rss = rssKb();
+  peakRss = std::max(peakRss, rss);
+  int64_t published = g_hub->numPublished();
+  printf("%lld messages/s published, %lld messages/s delivered, RSS %ld KiB\n",
+         static_cast<long long>(published - lastPublished),
+         static_cast<long long>(received - lastReceived),
+         rss);
+  lastPublished = published;
+  lastReceived = received;
+}
+
+void stop()
+{
+  running = false;
+  double elapsed = timeDifference(muduo::Timestamp::now(), start);
+  printf("%d subscribers, %zd bytes messages: %.0f deliveries/s, "
+         "peak RSS %ld KiB\n",
+         numSubscribers, content.size() + 12,
+         static_cast<double>(received) / elapsed, peakRss);
+  g_loop->quit();
+}
+
+void waitReady()
+{
+  if (numReady < numSubscribers)
+  {
+    // a probe for the subscribers whose sub request is still on the way
+    g_hub->publish("bench", content);
+    g_clientLoop->runAfter(0.2, waitReady);
+    return;
+  }
+  printf("%d subscribers ready, RSS %ld KiB\n", numSubscribers, rssKb());
+  running = true;
+  received = 0;
+  target = 0;
+  start = muduo::Timestamp::now();
+  publishWindow();
+  g_clientLoop->runEvery(1.0, printStats);
+  g_clientLoop->runAfter(seconds, stop);
+}
+
+void subscribeAll()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  const char request[] = "sub bench\r\n";
+
+  for (int i = 0; i < numSubscribers; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                            sizeof addr) < 0)
+    {
+      perror("connect");
+      printf("only %d subscribers, raise RLIMIT_NOFILE\n", i);
+      numSubscribers = i;
+      if (fd >= 0)
+        ::close(fd);
+      break;
+    }
+    ::write(fd, request, sizeof request - 1);
+    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+    if (static_cast<size_t>(fd) >= ready.size())
+    {
+      ready.resize(fd * 2);
+    }
+    muduo::Channel* channel = new muduo::Channel(g_clientLoop, fd);
+    channel->setReadCallback(boost::bind(onSubscriberRead, fd, _1));
+    channel->enableReading();
+    subscribers.push_back(channel);
+  }
+  waitReady();
+}
+
+int main(int argc, char* argv[])
+{
+  numSubscribers = argc > 1 ? atoi(argv[1]) : 50*1000;
+  int numThreads = argc > 2 ? atoi(argv[2]) : 0;
+  int messageSize = argc > 3 ? atoi(argv[3]) : 64;
+  seconds = argc > 4 ? atof(argv[4]) : 10.0;
+  // "pub bench " + content + "\r\n"
+  content.assign(std::max(messageSize - 12, 1), 'M');
+
+  struct rlimit rl;
+  ::getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = rl.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &rl);
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::PubSubHub hub(&loop, muduo::InetAddress(9981));
+  g_hub = &hub;
+  hub.setThreadNum(numThreads);
+  hub.start();
+  printf("RSS %ld KiB before subscribing\n", rssKb());
+
+  muduo::EventLoopThread clientThread;
+  g_clientLoop = clientThread.startLoop();
+  g_clientLoop->runInLoop(subscribeAll);
+  loop.loop();
+}
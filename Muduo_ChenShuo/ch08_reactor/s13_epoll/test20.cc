@@ -0,0 +1,132 @@
+// idle connections: memory of a TcpServer per connection.
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+
+#include <vector>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int numConnections = 100*1000;
+muduo::AtomicInt32 numConnected;
+long startRss = 0;
+muduo::EventLoop* g_loop;
+std::vector<int> clientFds;
+
+long rssKb()
+{
+  long kb = 0;
+  char line[256];
+  FILE* fp = fopen("/proc/self/status", "r");
+  while (fp && fgets(line, sizeof line, fp))
+  {
+    if (sscanf(line, "VmRSS: %ld", &kb) == 1)
+      break;
+  }
+  if (fp)
+    fclose(fp);
+  return kb;
+}
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    numConnected.increment();
+  }
+}
+
+void onMessage(const muduo::TcpConnectionPtr& conn,
+               muduo::Buffer* buf,
+               muduo::Timestamp receiveTime)
+{
+  buf->retrieveAll();
+}
+
+void report()
+{
+  long rss = rssKb();
+  int connected = numConnected.get();
+  // client sockets are kernel memory, they don't count in RSS
+  printf("%d connections, RSS %ld KiB, %.0f bytes per connection\n",
+         connected, rss,
+         connected > 0 ? (rss - startRss) * 1024.0 / connected : 0.0);
+  g_loop->quit();
+}
+
+void waitConnected()
+{
+  if (numConnected.get() < numConnections)
+  {
+    g_loop->runAfter(0.1, waitConnected);
+  }
+  else
+  {
+    report();
+  }
+}
+
+void connectAll()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (int i = 0; i < numConnections; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                            sizeof addr) < 0)
+    {
+      perror("connect");
+      printf("only %d connections, raise RLIMIT_NOFILE\n", i);
+      if (fd >= 0)
+        ::close(fd);
+      numConnections = i;
+      break;
+    }
+    clientFds.push_back(fd);
+  }
+  // waitConnected() reads numConnections after this
+  g_loop->runInLoop(boost::bind(&waitConnected));
+}
+
+int main(int argc, char* argv[])
+{
+  numConnections = argc > 1 ? atoi(argv[1]) : 100*1000;
+  int numThreads = argc > 2 ? atoi(argv[2]) : 0;
+
+  struct rlimit rl;
+  ::getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = rl.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &rl);
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.setThreadNum(numThreads);
+  server.start();
+  clientFds.reserve(numConnections);
+  startRss = rssKb();
+  printf("RSS %ld KiB before connecting\n", startRss);
+
+  muduo::Thread client(connectAll);
+  client.start();
+  loop.loop();
+  client.join();
+}
@@ -0,0 +1,94 @@
+// message dispatch rate: small pingpong messages, prints messages/s per core.
+
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+std::string message;
+muduo::AtomicInt64 numMessages;
+int64_t lastMessages = 0;
+int numCores = 1;
+
+void onServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+  }
+}
+
+void onServerMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp receiveTime)
+{
+  numMessages.increment();
+  conn->send(buf->retrieveAsString());
+}
+
+void onClientConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    conn->send(message);
+  }
+}
+
+void onClientMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp receiveTime)
+{
+  conn->send(buf->retrieveAsString());
+}
+
+void printStats()
+{
+  int64_t messages = numMessages.get();
+  printf("%lld messages/s, %lld messages/s per core\n",
+         static_cast<long long>(messages - lastMessages),
+         static_cast<long long>((messages - lastMessages) / numCores));
+  lastMessages = messages;
+}
+
+int main(int argc, char* argv[])
+{
+  int numConnections = argc > 1 ? atoi(argv[1]) : 100;
+  int numThreads = argc > 2 ? atoi(argv[2]) : 0;
+  double seconds = argc > 3 ? atof(argv[3]) : 10.0;
+  message.assign(16, 'M');
+  // server threads, or the main thread, and the client thread
+  numCores = (numThreads > 0 ? numThreads : 1) + 1;
+
+  muduo::EventLoop loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setConnectionCallback(onServerConnection);
+  server.setMessageCallback(onServerMessage);
+  server.setThreadNum(numThreads);
+  server.start();
+
+  muduo::EventLoopThread clientThread;
+  muduo::EventLoop* clientLoop = clientThread.startLoop();
+  muduo::InetAddress serverAddr("127.0.0.1", 9981);
+  boost::ptr_vector<muduo::TcpClient> clients;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    clients.push_back(new muduo::TcpClient(clientLoop, serverAddr));
+    clients.back().setConnectionCallback(onClientConnection);
+    clients.back().setMessageCallback(onClientMessage);
+    clients.back().connect();
+  }
+
+  loop.runEvery(1.0, printStats);
+  loop.runAfter(seconds, boost::bind(&muduo::EventLoop::quit, &loop));
+  loop.loop();
+}
@@ -0,0 +1,166 @@
+// pingpong over loopback TCP or a Unix domain socket,
+// prints throughput and round trip latency.  "fd" passes an fd over it.
+
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+const char* kPath = "/tmp/muduo_test22.sock";
+std::string message;
+muduo::AtomicInt64 roundTrips;
+muduo::EventLoop* g_loop;
+
+void onServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  printf("server: %s -> %s is %s\n",
+         conn->peerAddress().toHostPort().c_str(),
+         conn->localAddress().toHostPort().c_str(),
+         conn->connected() ? "UP" : "DOWN");
+}
+
+void onServerMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp receiveTime)
+{
+  conn->send(buf->retrieveAsString());
+}
+
+void onClientConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    conn->send(message);
+  }
+}
+
+void onClientMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp receiveTime)
+{
+  if (buf->readableBytes() >= message.size())
+  {
+    buf->retrieve(message.size());
+    roundTrips.increment();
+    conn->send(message);
+  }
+}
+
+void onFdServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setReceiveFds(true);
+  }
+}
+
+void onFdServerMessage(const muduo::TcpConnectionPtr& conn,
+                       muduo::Buffer* buf,
+                       muduo::Timestamp receiveTime)
+{
+  buf->retrieveAll();
+  std::vector<int> fds = conn->takePassedFds();
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    const char hello[] = "hello through the passed fd\n";
+    ::write(fds[i], hello, sizeof hello - 1);
+    ::close(fds[i]);
+  }
+}
+
+void onFdClientConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    int pipefd[2];
+    if (::pipe(pipefd) < 0)
+    {
+      perror("pipe");
+      return;
+    }
+    conn->sendWithFd("fd", pipefd[1]);
+    ::close(pipefd[1]);
+    // the server writes to our pipe, and closes it
+    char buf[256];
+    ssize_t n = 0;
+    std::string received;
+    while ((n = ::read(pipefd[0], buf, sizeof buf)) > 0)
+    {
+      received.append(buf, n);
+    }
+    ::close(pipefd[0]);
+    printf("client: read from pipe: %s", received.c_str());
+    // after the Connector has reset its channel, queued before this
+    conn->getLoop()->queueInLoop(
+        boost::bind(&muduo::EventLoop::quit, g_loop));
+  }
+}
+
+void stop(const char* mode, int numConnections, double seconds)
+{
+  int64_t n = roundTrips.get();
+  printf("%s: %d connections, %zd bytes, %.3f MiB/s, %.1f us per round trip\n",
+         mode, numConnections, message.size(),
+         static_cast<double>(n) * message.size() * 2 / seconds / 1024 / 1024,
+         n > 0 ? seconds * numConnections * 1e6 / n : 0.0);
+  g_loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: test22 tcp|unix|fd [connections] [size] [seconds]\n");
+    return 1;
+  }
+  const char* mode = argv[1];
+  int numConnections = argc > 2 ? atoi(argv[2]) : 1;
+  message.assign(argc > 3 ? atoi(argv[3]) : 64, 'P');
+  double seconds = argc > 4 ? atof(argv[4]) : 10.0;
+  bool tcp = strcmp(mode, "tcp") == 0;
+  bool passFd = strcmp(mode, "fd") == 0;
+
+  muduo::InetAddress listenAddr = tcp
+      ? muduo::InetAddress(9981) : muduo::InetAddress::fromUnixPath(kPath);
+  muduo::InetAddress serverAddr = tcp
+      ? muduo::InetAddress("127.0.0.1", 9981) : listenAddr;
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, listenAddr);
+  server.setConnectionCallback(passFd ? onFdServerConnection
+                                      : onServerConnection);
+  server.setMessageCallback(passFd ? onFdServerMessage : onServerMessage);
+  server.start();
+
+  muduo::EventLoopThread clientThread;
+  muduo::EventLoop* clientLoop = clientThread.startLoop();
+  boost::ptr_vector<muduo::TcpClient> clients;
+  for (int i = 0; i < (passFd ? 1 : numConnections); ++i)
+  {
+    clients.push_back(new muduo::TcpClient(clientLoop, serverAddr));
+    clients.back().setConnectionCallback(passFd ? onFdClientConnection
+                                                : onClientConnection);
+    clients.back().setMessageCallback(onClientMessage);
+    clients.back().connect();
+  }
+
+  if (!passFd)
+  {
+    loop.runAfter(seconds, boost::bind(stop, mode, numConnections, seconds));
+  }
+  loop.loop();
+  ::unlink(kPath);
+}
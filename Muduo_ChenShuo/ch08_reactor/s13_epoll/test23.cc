@@ -0,0 +1,131 @@
+// framed pingpong: LengthHeaderCodec on both sides, prints frames/s.
+// usage: test23 [frame_bytes] [frames_in_flight] [header_bytes] [seconds]
+
+#include "LengthHeaderCodec.h"
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+std::string frame;
+int framesInFlight = 100;
+muduo::AtomicInt64 numFrames;
+muduo::AtomicInt64 numBatches;
+int64_t lastFrames = 0;
+int64_t lastBatches = 0;
+
+void onServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+  }
+}
+
+void onServerFrames(muduo::LengthHeaderCodec* codec,
+                    const muduo::TcpConnectionPtr& conn,
+                    const muduo::StringView* frames,
+                    int count,
+                    muduo::Timestamp)
+{
+  numFrames.add(count);
+  numBatches.increment();
+  for (int i = 0; i < count; ++i)
+  {
+    codec->send(conn, frames[i]);
+  }
+}
+
+void onClientFrames(muduo::LengthHeaderCodec* codec,
+                    const muduo::TcpConnectionPtr& conn,
+                    const muduo::StringView* frames,
+                    int count,
+                    muduo::Timestamp)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    if (frames[i] != frame)
+    {
+      printf("corrupted frame of %zd bytes\n", frames[i].size());
+      abort();
+    }
+    codec->send(conn, frames[i]);
+  }
+}
+
+void onClientConnection(muduo::LengthHeaderCodec* codec,
+                        const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    for (int i = 0; i < framesInFlight; ++i)
+    {
+      muduo::Buffer buf;
+      buf.append(frame);
+      codec->send(conn, &buf);
+    }
+  }
+}
+
+void printStats()
+{
+  int64_t frames = numFrames.get();
+  int64_t batches = numBatches.get();
+  printf("%lld frames/s, %.1f frames per callback\n",
+         static_cast<long long>(frames - lastFrames),
+         batches > lastBatches
+           ? static_cast<double>(frames - lastFrames) / (batches - lastBatches)
+           : 0.0);
+  lastFrames = frames;
+  lastBatches = batches;
+}
+
+int main(int argc, char* argv[])
+{
+  int frameBytes = argc > 1 ? atoi(argv[1]) : 64;
+  framesInFlight = argc > 2 ? atoi(argv[2]) : 100;
+  int headerLen = argc > 3 ? atoi(argv[3]) : 4;
+  double seconds = argc > 4 ? atof(argv[4]) : 10.0;
+  muduo::EventLoop loop;
+  muduo::LengthHeaderCodec serverCodec(
+      boost::bind(onServerFrames, &serverCodec, _1, _2, _3, _4), headerLen);
+  if (static_cast<size_t>(frameBytes) > serverCodec.maxFrameLen())
+  {
+    printf("frame too long for a %d byte header\n", headerLen);
+    return 1;
+  }
+  frame.resize(frameBytes);
+  for (int i = 0; i < frameBytes; ++i)
+  {
+    frame[i] = static_cast<char>('A' + i % 26);
+  }
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setConnectionCallback(onServerConnection);
+  server.setMessageCallback(
+      boost::bind(&muduo::LengthHeaderCodec::onMessage, &serverCodec, _1, _2, _3));
+  server.start();
+
+  // outlives the client thread
+  muduo::LengthHeaderCodec clientCodec(
+      boost::bind(onClientFrames, &clientCodec, _1, _2, _3, _4), headerLen);
+  muduo::EventLoopThread clientThread;
+  muduo::EventLoop* clientLoop = clientThread.startLoop();
+  muduo::TcpClient client(clientLoop, muduo::InetAddress("127.0.0.1", 9981));
+  client.setConnectionCallback(boost::bind(onClientConnection, &clientCodec, _1));
+  client.setMessageCallback(
+      boost::bind(&muduo::LengthHeaderCodec::onMessage, &clientCodec, _1, _2, _3));
+  client.connect();
+
+  loop.runEvery(1.0, printStats);
+  loop.runAfter(seconds, boost::bind(&muduo::EventLoop::quit, &loop));
+  loop.loop();
+}
@@ -0,0 +1,119 @@
+// line splitting throughput: byte-by-byte rescan, vectorized rescan,
+// and LineCodec, on 64 to 4096 byte lines fed in 1448 byte reads.
+
+#include "LineCodec.h"
+#include "Buffer.h"
+#include "TcpConnection.h"
+
+#include <muduo/base/Timestamp.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+const char kCRLF[] = "\r\n";
+const size_t kReadSize = 1448;  // one TCP segment on Ethernet
+int64_t numLines = 0;
+int64_t numBytes = 0;
+
+void countLine(const char* begin, const char* end)
+{
+  ++numLines;
+  numBytes += end - begin;
+}
+
+// what the sudoku and pubsub servers did, from the start of the buffer
+void splitBySearch(muduo::Buffer* buf)
+{
+  for (;;)
+  {
+    // retrieving all of it moves beginWrite()
+    const char* end = buf->beginWrite();
+    const char* crlf = std::search(buf->peek(), end, kCRLF, kCRLF+2);
+    if (crlf == end)
+    {
+      break;
+    }
+    countLine(buf->peek(), crlf);
+    buf->retrieveUntil(crlf + 2);
+  }
+}
+
+void splitByFindCRLF(muduo::Buffer* buf)
+{
+  const char* crlf = NULL;
+  while ((crlf = buf->findCRLF()) != NULL)
+  {
+    countLine(buf->peek(), crlf);
+    buf->retrieveUntil(crlf + 2);
+  }
+}
+
+void onLines(const muduo::TcpConnectionPtr&,
+             const muduo::StringView* lines,
+             int count,
+             muduo::Timestamp)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    countLine(lines[i].begin(), lines[i].end());
+  }
+}
+
+template<typename Split>
+void run(const char* name, const std::string& input, int lineLen, Split split)
+{
+  numLines = 0;
+  numBytes = 0;
+  muduo::Buffer buf;
+  muduo::Timestamp start(muduo::Timestamp::now());
+  for (size_t offset = 0; offset < input.size(); offset += kReadSize)
+  {
+    buf.append(input.data() + offset, std::min(kReadSize, input.size() - offset));
+    split(&buf);
+  }
+  double seconds = timeDifference(muduo::Timestamp::now(), start);
+  printf("%5d byte lines %-10s %9.1f MiB/s %10.0f lines/s\n",
+         lineLen, name, input.size() / seconds / 1024 / 1024, numLines / seconds);
+  if (numLines != static_cast<int64_t>(input.size() / (lineLen + 2))
+      || numBytes != numLines * lineLen)
+  {
+    printf("wrong split: %lld lines\n", static_cast<long long>(numLines));
+    abort();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  size_t totalBytes = (argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+  const int lineLens[] = { 64, 256, 1024, 4096 };
+  for (size_t i = 0; i < sizeof lineLens / sizeof lineLens[0]; ++i)
+  {
+    const int lineLen = lineLens[i];
+    std::string line(lineLen, 'x');
+    for (int j = 0; j < lineLen; ++j)
+    {
+      // digits and colons, like id:puzzle
+      line[j] = j % 10 == 9 ? ':' : static_cast<char>('0' + j % 10);
+    }
+    line += kCRLF;
+    std::string input;
+    input.reserve(totalBytes + line.size());
+    while (input.size() < totalBytes)
+    {
+      input += line;
+    }
+
+    run("search", input, lineLen, splitBySearch);
+    run("findCRLF", input, lineLen, splitByFindCRLF);
+    muduo::LineCodec codec(onLines);
+    size_t scanned = 0;
+    run("LineCodec", input, lineLen,
+        boost::bind(&muduo::LineCodec::splitLines, &codec,
+                    muduo::TcpConnectionPtr(), _1, muduo::Timestamp(),
+                    &scanned));
+  }
+}
@@ -0,0 +1,152 @@
+// HTTP load test: small GETs over keep-alive connections, prints requests/s.
+// usage: test25 [connections] [server_threads] [pipeline_depth] [seconds]
+// the client runs in a child process, so each side has its own fd limit.
+
+#include "HttpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const char kRequest[] = "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+const char kBody[] = "Hello, world!\n";
+size_t responseSize = 0;
+int pipelineDepth = 1;
+int64_t numResponses = 0;
+int64_t warmupResponses = 0;
+int numConnected = 0;
+muduo::Timestamp warmupEnd;
+
+void onRequest(const muduo::HttpRequest& req, muduo::HttpResponse* resp)
+{
+  if (req.path() == "/hello")
+  {
+    resp->setContentType("text/plain");
+    resp->addHeader("Server", "muduo-s13");
+    resp->setBody(kBody);
+  }
+  else
+  {
+    resp->setStatus(404, "Not Found");
+    resp->setBody(muduo::StringView());
+  }
+}
+
+void sendRequests(const muduo::TcpConnectionPtr& conn, int n)
+{
+  muduo::Buffer buf(n * (sizeof kRequest - 1));
+  for (int i = 0; i < n; ++i)
+  {
+    buf.append(kRequest, sizeof kRequest - 1);
+  }
+  conn->send(&buf);
+}
+
+void onClientConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    ++numConnected;
+    conn->setTcpNoDelay(true);
+    sendRequests(conn, pipelineDepth);
+  }
+}
+
+void onClientMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp)
+{
+  // responses are all alike, count them by size
+  int n = static_cast<int>(buf->readableBytes() / responseSize);
+  if (n > 0)
+  {
+    buf->retrieve(n * responseSize);
+    numResponses += n;
+    sendRequests(conn, n);
+  }
+}
+
+void startMeasuring()
+{
+  warmupResponses = numResponses;
+  warmupEnd = muduo::Timestamp::now();
+}
+
+void runClient(int numConnections, double seconds)
+{
+  muduo::EventLoop loop;
+  muduo::InetAddress serverAddr("127.0.0.1", 9981);
+  boost::ptr_vector<muduo::TcpClient> clients;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    clients.push_back(new muduo::TcpClient(&loop, serverAddr));
+    clients.back().setConnectionCallback(onClientConnection);
+    clients.back().setMessageCallback(onClientMessage);
+    clients.back().connect();
+  }
+  loop.runAfter(1.0, startMeasuring);
+  loop.runAfter(seconds, boost::bind(&muduo::EventLoop::quit, &loop));
+  loop.loop();
+
+  double elapsed = timeDifference(muduo::Timestamp::now(), warmupEnd);
+  printf("%d connections (%d connected), pipeline %d: %.0f requests/s\n",
+         numConnections, numConnected, pipelineDepth,
+         (numResponses - warmupResponses) / elapsed);
+  fflush(stdout);
+}
+
+void checkClient(muduo::EventLoop* loop, pid_t client)
+{
+  if (::waitpid(client, NULL, WNOHANG) == client)
+  {
+    loop->quit();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int numConnections = argc > 1 ? atoi(argv[1]) : 100;
+  int numThreads = argc > 2 ? atoi(argv[2]) : 0;
+  pipelineDepth = argc > 3 ? atoi(argv[3]) : 1;
+  double seconds = argc > 4 ? atof(argv[4]) : 10.0;
+
+  struct rlimit rl;
+  ::getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = rl.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &rl);
+
+  {
+    // the response the client expects, built as the server does
+    muduo::Buffer response;
+    muduo::HttpResponse resp(&response, false, false);
+    resp.setContentType("text/plain");
+    resp.addHeader("Server", "muduo-s13");
+    resp.setBody(kBody);
+    responseSize = response.readableBytes();
+  }
+
+  // before any EventLoop, one per thread
+  pid_t client = ::fork();
+  if (client == 0)
+  {
+    runClient(numConnections, seconds);
+    _exit(0);
+  }
+
+  muduo::EventLoop loop;
+  muduo::HttpServer server(&loop, muduo::InetAddress(9981));
+  server.setHttpCallback(onRequest);
+  server.setThreadNum(numThreads);
+  server.start();
+
+  loop.runEvery(0.1, boost::bind(checkClient, &loop, client));
+  loop.loop();
+}
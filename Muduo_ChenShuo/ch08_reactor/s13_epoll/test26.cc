@@ -0,0 +1,214 @@
+// connection limits, idle timeout and overload shedding of TcpServer.
+// usage: test26 reject|evict|idle|overload
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+muduo::EventLoop* g_loop;
+muduo::TcpServer* g_server;
+double burnSeconds = 0;
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+}
+
+void onMessage(const muduo::TcpConnectionPtr& conn,
+               muduo::Buffer* buf,
+               muduo::Timestamp receiveTime)
+{
+  buf->retrieveAll();
+  // a slow handler, for overload
+  muduo::Timestamp start(muduo::Timestamp::now());
+  while (timeDifference(muduo::Timestamp::now(), start) < burnSeconds)
+  {
+  }
+}
+
+int connectOne()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    perror("connect");
+  }
+  return fd;
+}
+
+// whether the server has closed fd
+bool closedByServer(int fd)
+{
+  char c;
+  ssize_t n = ::recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return n == 0 || (n < 0 && errno != EAGAIN);
+}
+
+void printClosed(const std::vector<int>& fds)
+{
+  printf("closed by server:");
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    printf(" %c", closedByServer(fds[i]) ? 'x' : '.');
+  }
+  printf("\n");
+}
+
+void closeAll(std::vector<int>* fds)
+{
+  for (size_t i = 0; i < fds->size(); ++i)
+  {
+    ::close((*fds)[i]);
+  }
+  fds->clear();
+}
+
+void printServerState()
+{
+  printf("server: %d connections, %s\n", g_server->numConnections(),
+         g_server->overloaded() ? "overloaded" : "accepting");
+}
+
+// 8 connections, limit 5
+void reject()
+{
+  std::vector<int> fds;
+  for (int i = 0; i < 8; ++i)
+  {
+    fds.push_back(connectOne());
+  }
+  usleep(200*1000);
+  printf("limit 5, reject new, expect the last 3 closed\n");
+  printClosed(fds);
+  closeAll(&fds);
+}
+
+// 5 connections, 1 to 4 send something, then a 6th connects
+void evict()
+{
+  std::vector<int> fds;
+  for (int i = 0; i < 5; ++i)
+  {
+    fds.push_back(connectOne());
+  }
+  usleep(200*1000);
+  for (int i = 1; i < 5; ++i)
+  {
+    ::write(fds[i], "hi", 2);
+  }
+  usleep(200*1000);
+  fds.push_back(connectOne());
+  usleep(200*1000);
+  printf("limit 5, close oldest idle, expect the first closed\n");
+  printClosed(fds);
+  closeAll(&fds);
+}
+
+// idle timeout 1s, the second connection sends every 0.3s
+void idle()
+{
+  std::vector<int> fds;
+  fds.push_back(connectOne());
+  fds.push_back(connectOne());
+  for (int i = 0; i < 8; ++i)
+  {
+    usleep(300*1000);
+    ::write(fds[1], "hi", 2);
+  }
+  printf("idle timeout 1s after 2.4s, expect the first closed\n");
+  printClosed(fds);
+  closeAll(&fds);
+}
+
+// a busy connection makes the loop busy for about 80%
+void overload()
+{
+  std::vector<int> fds;
+  fds.push_back(connectOne());
+  for (int i = 0; i < 100; ++i)
+  {
+    ::write(fds[0], "x", 1);
+    usleep(10*1000);
+    if (i == 50)
+    {
+      // waits in the backlog until the server resumes accepting
+      fds.push_back(connectOne());
+    }
+    if (i % 10 == 0)
+    {
+      g_loop->runInLoop(printServerState);
+    }
+  }
+  usleep(500*1000);
+  g_loop->runInLoop(printServerState);
+  usleep(100*1000);
+  closeAll(&fds);
+}
+
+void runClient(void (*scenario)())
+{
+  usleep(100*1000);
+  scenario();
+  g_loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  std::string mode = argc > 1 ? argv[1] : "reject";
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  g_server = &server;
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+
+  void (*scenario)() = reject;
+  if (mode == "reject")
+  {
+    server.setMaxConnections(5, muduo::TcpServer::kRejectNew);
+  }
+  else if (mode == "evict")
+  {
+    server.setMaxConnections(5, muduo::TcpServer::kCloseOldestIdle);
+    scenario = evict;
+  }
+  else if (mode == "idle")
+  {
+    server.setIdleTimeout(1.0);
+    scenario = idle;
+  }
+  else if (mode == "overload")
+  {
+    burnSeconds = 0.008;
+    server.setOverloadLimits(0.5, 0);
+    scenario = overload;
+  }
+  else
+  {
+    printf("usage: %s reject|evict|idle|overload\n", argv[0]);
+    return 1;
+  }
+  server.start();
+
+  muduo::Thread client(boost::bind(runClient, scenario));
+  client.start();
+  loop.loop();
+  client.join();
+}
@@ -0,0 +1,444 @@
+// reactor benchmark suite, one JSON object per result on stdout.
+// usage: test27 [all|pingpong|throughput|churn|idle|timers] [seconds]
+//               [idle_connections] [active_connections]
+// build optimized with "make bench": bench_epoll and bench_poll.
+
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef MUDUO_USE_POLL
+const char kPoller[] = "poll";
+#else
+const char kPoller[] = "epoll";
+#endif
+
+double seconds = 2.0;
+muduo::EventLoop* g_serverLoop;
+std::string message;
+
+int64_t nowNs()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void onServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+  }
+}
+
+void onEcho(const muduo::TcpConnectionPtr& conn,
+            muduo::Buffer* buf,
+            muduo::Timestamp)
+{
+  conn->send(buf);
+}
+
+// runs @c client in its own thread with its own loop,
+// while the server runs in this thread.
+void runWithServer(const boost::function<void ()>& client,
+                   const muduo::ConnectionCallback& onConnection,
+                   const muduo::MessageCallback& onMessage)
+{
+  muduo::EventLoop loop;
+  g_serverLoop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.start();
+  muduo::Thread thread(client);
+  thread.start();
+  loop.loop();
+  thread.join();
+  g_serverLoop = NULL;
+}
+
+void quitServer()
+{
+  g_serverLoop->quit();
+}
+
+// --- ping-pong latency ---
+
+std::vector<int64_t> latencies;
+int64_t sentNs = 0;
+int64_t startNs = 0;
+
+void onPingConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    startNs = sentNs = nowNs();
+    conn->send(message);
+  }
+}
+
+void onPong(muduo::EventLoop* loop,
+            const muduo::TcpConnectionPtr& conn,
+            muduo::Buffer* buf,
+            muduo::Timestamp)
+{
+  if (buf->readableBytes() < message.size())
+  {
+    return;
+  }
+  buf->retrieve(message.size());
+  int64_t now = nowNs();
+  latencies.push_back(now - sentNs);
+  if (now - startNs < seconds * 1e9)
+  {
+    sentNs = now;
+    conn->send(message);
+  }
+  else
+  {
+    loop->quit();
+  }
+}
+
+void pingClient()
+{
+  muduo::EventLoop loop;
+  muduo::TcpClient client(&loop, muduo::InetAddress("127.0.0.1", 9981));
+  client.setConnectionCallback(onPingConnection);
+  client.setMessageCallback(boost::bind(onPong, &loop, _1, _2, _3));
+  client.connect();
+  loop.loop();
+  g_serverLoop->runInLoop(quitServer);
+}
+
+double percentileUs(const std::vector<int64_t>& sorted, double p)
+{
+  if (sorted.empty())
+    return 0;
+  size_t i = std::min(sorted.size() - 1,
+                      static_cast<size_t>(p * static_cast<double>(sorted.size())));
+  return sorted[i] / 1000.0;
+}
+
+void benchPingpong()
+{
+  message.assign(64, 'P');
+  latencies.clear();
+  latencies.reserve(1000*1000);
+  runWithServer(pingClient, onServerConnection, onEcho);
+  std::sort(latencies.begin(), latencies.end());
+  printf("{\"bench\":\"pingpong\",\"poller\":\"%s\",\"size\":%zu,"
+         "\"round_trips\":%zu,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+         "\"p999_us\":%.1f}\n",
+         kPoller, message.size(), latencies.size(),
+         percentileUs(latencies, 0.5),
+         percentileUs(latencies, 0.99),
+         percentileUs(latencies, 0.999));
+}
+
+// --- bulk throughput, both sides echo, 16 messages in flight ---
+
+int64_t bytesRead = 0;
+
+void onBulkConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    for (int i = 0; i < 16; ++i)
+    {
+      conn->send(message);
+    }
+  }
+}
+
+void onBulkMessage(const muduo::TcpConnectionPtr& conn,
+                   muduo::Buffer* buf,
+                   muduo::Timestamp)
+{
+  bytesRead += buf->readableBytes();
+  conn->send(buf);
+}
+
+void bulkClient()
+{
+  muduo::EventLoop loop;
+  muduo::TcpClient client(&loop, muduo::InetAddress("127.0.0.1", 9981));
+  client.setConnectionCallback(onBulkConnection);
+  client.setMessageCallback(onBulkMessage);
+  client.connect();
+  loop.runAfter(seconds, boost::bind(&muduo::EventLoop::quit, &loop));
+  loop.loop();
+  g_serverLoop->runInLoop(quitServer);
+}
+
+void benchThroughput()
+{
+  const int sizes[] = { 64, 1024, 16*1024, 64*1024 };
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i)
+  {
+    message.assign(sizes[i], 'T');
+    bytesRead = 0;
+    runWithServer(bulkClient, onServerConnection, onEcho);
+    printf("{\"bench\":\"throughput\",\"poller\":\"%s\",\"size\":%d,"
+           "\"mib_per_s\":%.1f}\n",
+           kPoller, sizes[i], bytesRead / seconds / 1024 / 1024);
+  }
+}
+
+// --- accept/close churn ---
+
+int64_t numAccepted = 0;
+
+void onChurnConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    ++numAccepted;
+  }
+}
+
+void onDiscard(const muduo::TcpConnectionPtr&,
+               muduo::Buffer* buf,
+               muduo::Timestamp)
+{
+  buf->retrieveAll();
+}
+
+int connectBlocking()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd >= 0 && ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                           sizeof addr) < 0)
+  {
+    ::close(fd);
+    fd = -1;
+  }
+  return fd;
+}
+
+int64_t numConnects = 0;
+
+void churnClient()
+{
+  int64_t start = nowNs();
+  while (nowNs() - start < seconds * 1e9)
+  {
+    int fd = connectBlocking();
+    if (fd < 0)
+    {
+      perror("connect");  // out of ephemeral ports
+      break;
+    }
+    ++numConnects;
+    ::close(fd);
+  }
+  // let the server see the last ones
+  g_serverLoop->runAfter(0.2, quitServer);
+}
+
+void benchChurn()
+{
+  numAccepted = 0;
+  numConnects = 0;
+  int64_t start = nowNs();
+  runWithServer(churnClient, onChurnConnection, onDiscard);
+  double elapsed = (nowNs() - start) / 1e9 - 0.2;
+  printf("{\"bench\":\"churn\",\"poller\":\"%s\",\"connects\":%lld,"
+         "\"accepted\":%lld,\"connections_per_s\":%.0f}\n",
+         kPoller, static_cast<long long>(numConnects),
+         static_cast<long long>(numAccepted), numAccepted / elapsed);
+}
+
+// --- N idle and M active connections ---
+
+int numIdle = 5000;
+int numActive = 10;
+muduo::AtomicInt32 numServerConnections;
+int64_t numMessages = 0;
+bool measuring = false;
+
+void onIdleServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    numServerConnections.increment();
+  }
+}
+
+void onActiveConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    conn->send(message);
+  }
+}
+
+// the idle ones may overflow the backlog, so the server can accept the
+// active ones seconds after they see connected.  Measure from there.
+void startMeasuring(muduo::EventLoop* loop)
+{
+  if (!measuring && numServerConnections.get() == numIdle + numActive)
+  {
+    measuring = true;
+    numMessages = 0;
+    loop->runAfter(seconds, boost::bind(&muduo::EventLoop::quit, loop));
+  }
+}
+
+void onActiveMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp)
+{
+  ++numMessages;
+  conn->send(buf);
+}
+
+void idleClient()
+{
+  std::vector<int> idleFds;
+  for (int i = 0; i < numIdle; ++i)
+  {
+    int fd = connectBlocking();
+    if (fd < 0)
+    {
+      perror("connect");
+      numIdle = i;
+      break;
+    }
+    idleFds.push_back(fd);
+  }
+
+  muduo::EventLoop loop;
+  boost::ptr_vector<muduo::TcpClient> clients;
+  for (int i = 0; i < numActive; ++i)
+  {
+    clients.push_back(
+        new muduo::TcpClient(&loop, muduo::InetAddress("127.0.0.1", 9981)));
+    clients.back().setConnectionCallback(onActiveConnection);
+    clients.back().setMessageCallback(onActiveMessage);
+    clients.back().connect();
+  }
+  loop.runEvery(0.05, boost::bind(startMeasuring, &loop));
+  loop.loop();
+  for (size_t i = 0; i < idleFds.size(); ++i)
+  {
+    ::close(idleFds[i]);
+  }
+  g_serverLoop->runInLoop(quitServer);
+}
+
+void benchIdle()
+{
+  message.assign(16, 'I');
+  numServerConnections.getAndSet(0);
+  numMessages = 0;
+  measuring = false;
+  runWithServer(idleClient, onIdleServerConnection, onEcho);
+  printf("{\"bench\":\"idle_active\",\"poller\":\"%s\",\"idle\":%d,"
+         "\"active\":%d,\"messages_per_s\":%.0f}\n",
+         kPoller, numIdle, numActive, numMessages / seconds);
+}
+
+// --- timer add/cancel storm ---
+
+int numTimers = 200*1000;
+int numFired = 0;
+muduo::EventLoop* g_timerLoop;
+
+void onTimer()
+{
+  if (++numFired == numTimers / 2)
+  {
+    g_timerLoop->quit();
+  }
+}
+
+void benchTimers()
+{
+  muduo::EventLoop loop;
+  g_timerLoop = &loop;
+  numFired = 0;
+  std::vector<muduo::TimerId> timers;
+  timers.reserve(numTimers);
+  srand(42);
+  int64_t start = nowNs();
+  for (int i = 0; i < numTimers; ++i)
+  {
+    // spread over 0.1 to 0.6s, after the adds and cancels
+    double delay = 0.1 + (rand() % 500000) / 1e6;
+    timers.push_back(loop.runAfter(delay, onTimer));
+  }
+  int64_t added = nowNs();
+  for (int i = 0; i < numTimers; i += 2)
+  {
+    loop.cancel(timers[i]);
+  }
+  int64_t cancelled = nowNs();
+  loop.loop();
+  int64_t fired = nowNs();
+  printf("{\"bench\":\"timers\",\"poller\":\"%s\",\"timers\":%d,"
+         "\"adds_per_s\":%.0f,\"cancels_per_s\":%.0f,\"fired\":%d,"
+         "\"fire_seconds\":%.3f}\n",
+         kPoller, numTimers,
+         numTimers / ((added - start) / 1e9),
+         numTimers / 2 / ((cancelled - added) / 1e9),
+         numFired, (fired - cancelled) / 1e9);
+}
+
+int main(int argc, char* argv[])
+{
+  std::string which = argc > 1 ? argv[1] : "all";
+  seconds = argc > 2 ? atof(argv[2]) : 2.0;
+  numIdle = argc > 3 ? atoi(argv[3]) : 5000;
+  numActive = argc > 4 ? atoi(argv[4]) : 10;
+
+  struct rlimit rl;
+  ::getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = rl.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &rl);
+  // both ends of each idle connection are in this process
+  numIdle = std::min(numIdle, static_cast<int>(rl.rlim_cur / 2) - 100);
+
+  bool all = which == "all";
+  if (all || which == "pingpong")
+    benchPingpong();
+  if (all || which == "throughput")
+    benchThroughput();
+  if (all || which == "churn")
+    benchChurn();
+  if (all || which == "idle")
+    benchIdle();
+  if (all || which == "timers")
+    benchTimers();
+  fflush(stdout);
+}
@@ -0,0 +1,198 @@
+// TcpClientPool: pipelined line requests to a fast and a slow echo server,
+// the servers drop all connections halfway, the pool reconnects.
+// usage: test28 [seconds] [connections_per_server] [requests_in_flight]
+
+#include "TcpClientPool.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+
+#include <boost/bind.hpp>
+
+#include <set>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+muduo::EventLoop* g_loop;
+muduo::TcpClientPool* g_pool;
+muduo::AtomicInt64 nextSeq;
+muduo::AtomicInt64 numCompleted;
+muduo::AtomicInt64 numFailed;
+muduo::AtomicInt32 stopping;
+int numConnections = 0;
+int requestsInFlight = 0;
+
+// server side, in the main loop
+std::set<muduo::TcpConnectionPtr> serverConnections;
+std::vector<std::pair<muduo::TcpConnectionPtr, std::string> > slowReplies;
+
+void onServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    serverConnections.insert(conn);
+  }
+  else
+  {
+    serverConnections.erase(conn);
+  }
+}
+
+void onFastMessage(const muduo::TcpConnectionPtr& conn,
+                   muduo::Buffer* buf,
+                   muduo::Timestamp)
+{
+  conn->send(buf);
+}
+
+void onSlowMessage(const muduo::TcpConnectionPtr& conn,
+                   muduo::Buffer* buf,
+                   muduo::Timestamp)
+{
+  slowReplies.push_back(std::make_pair(conn, buf->retrieveAsString()));
+}
+
+// in order, the client matches responses by order
+void flushSlowReplies()
+{
+  for (size_t i = 0; i < slowReplies.size(); ++i)
+  {
+    slowReplies[i].first->send(slowReplies[i].second);
+  }
+  slowReplies.clear();
+}
+
+void dropAll()
+{
+  printf("server drops %zd connections\n", serverConnections.size());
+  std::set<muduo::TcpConnectionPtr> conns;
+  conns.swap(serverConnections);
+  for (std::set<muduo::TcpConnectionPtr>::iterator it = conns.begin();
+       it != conns.end(); ++it)
+  {
+    (*it)->forceClose();
+  }
+}
+
+// client side, in any thread
+
+void sendOne();
+
+void onResponse(const std::string& request, const muduo::StringView* response)
+{
+  if (response == NULL)
+  {
+    numFailed.increment();
+  }
+  else if (*response != request)
+  {
+    printf("response mismatch\n");
+    abort();
+  }
+  else
+  {
+    numCompleted.increment();
+  }
+  sendOne();
+}
+
+void sendOne()
+{
+  if (stopping.get())
+  {
+    return;
+  }
+  char buf[32];
+  snprintf(buf, sizeof buf, "%lld\r\n",
+           static_cast<long long>(nextSeq.incrementAndGet()));
+  std::string request(buf);
+  if (!g_pool->request(request, boost::bind(onResponse, request, _1)))
+  {
+    // all down, try again later
+    g_loop->runAfter(0.01, sendOne);
+  }
+}
+
+void startRequests()
+{
+  static bool started = false;
+  if (!started && g_pool->numConnected() == numConnections)
+  {
+    started = true;
+    printf("%d connections up\n", numConnections);
+    for (int i = 0; i < requestsInFlight; ++i)
+    {
+      sendOne();
+    }
+  }
+}
+
+void printStats()
+{
+  std::vector<muduo::TcpClientPool::ConnectionStats> stats = g_pool->stats();
+  for (size_t i = 0; i < stats.size(); ++i)
+  {
+    const muduo::TcpClientPool::ConnectionStats& s = stats[i];
+    printf("%s %s inflight %d completed %lld failed %lld"
+           " latency avg %.0fus max %lldus\n",
+           s.server.c_str(), s.connected ? "up  " : "down",
+           s.inflight, static_cast<long long>(s.completed),
+           static_cast<long long>(s.failed),
+           s.completed > 0
+             ? static_cast<double>(s.latencyTotalUs) / s.completed : 0.0,
+           static_cast<long long>(s.latencyMaxUs));
+  }
+  printf("completed %lld failed %lld, %d connected\n",
+         static_cast<long long>(numCompleted.get()),
+         static_cast<long long>(numFailed.get()),
+         g_pool->numConnected());
+}
+
+void finish()
+{
+  printStats();
+  stopping.getAndSet(1);
+  g_pool->stop();
+  g_loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  double seconds = argc > 1 ? atof(argv[1]) : 4.0;
+  int connectionsPerServer = argc > 2 ? atoi(argv[2]) : 4;
+  requestsInFlight = argc > 3 ? atoi(argv[3]) : 64;
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+
+  muduo::TcpServer fastServer(&loop, muduo::InetAddress(9981));
+  fastServer.setConnectionCallback(onServerConnection);
+  fastServer.setMessageCallback(onFastMessage);
+  fastServer.start();
+  muduo::TcpServer slowServer(&loop, muduo::InetAddress(9982));
+  slowServer.setConnectionCallback(onServerConnection);
+  slowServer.setMessageCallback(onSlowMessage);
+  slowServer.start();
+  loop.runEvery(0.002, flushSlowReplies);
+
+  std::vector<muduo::InetAddress> servers;
+  servers.push_back(muduo::InetAddress("127.0.0.1", 9981));
+  servers.push_back(muduo::InetAddress("127.0.0.1", 9982));
+  muduo::TcpClientPool pool(&loop, servers, "test28");
+  g_pool = &pool;
+  pool.setThreadNum(2);
+  pool.setConnectionsPerServer(connectionsPerServer);
+  pool.start();
+  numConnections = connectionsPerServer * static_cast<int>(servers.size());
+
+  loop.runEvery(0.01, startRequests);
+  loop.runAfter(seconds / 2, printStats);
+  loop.runAfter(seconds / 2, dropAll);
+  loop.runAfter(seconds, finish);
+  loop.loop();
+}
@@ -0,0 +1,202 @@
+// RPC benchmark: calls/s and latency with 1 and 1000 concurrent callers,
+// handlers inline in the IO loop or in worker threads.
+// usage: test29 [seconds] [request_bytes]
+
+#include "RpcClient.h"
+#include "RpcServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+enum Method { kEchoInLoop = 1, kEchoInWorker = 2 };
+
+struct Scenario
+{
+  const char* name;
+  uint32_t method;
+  int callers;
+};
+
+const Scenario kScenarios[] =
+{
+  { "inline", kEchoInLoop, 1 },
+  { "inline", kEchoInLoop, 1000 },
+  { "worker", kEchoInWorker, 1 },
+  { "worker", kEchoInWorker, 1000 },
+};
+const int kNumScenarios = sizeof kScenarios / sizeof kScenarios[0];
+
+double seconds = 2.0;
+std::string message;
+muduo::EventLoop* g_serverLoop;
+
+int64_t nowNs()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+bool echo(const muduo::StringView& request, muduo::Buffer* response)
+{
+  response->append(request.data(), request.size());
+  return true;
+}
+
+double percentileUs(const std::vector<int64_t>& sorted, double p)
+{
+  if (sorted.empty())
+  {
+    return 0;
+  }
+  size_t i = std::min(sorted.size() - 1,
+                      static_cast<size_t>(p * static_cast<double>(sorted.size())));
+  return sorted[i] / 1000.0;
+}
+
+// all in the client loop
+class Bench
+{
+ public:
+  Bench(muduo::EventLoop* loop, muduo::RpcClient* client)
+    : loop_(loop), client_(client), scenario_(0), running_(false),
+      errors_(0), startNs_(0)
+  { }
+
+  void onConnection(const muduo::TcpConnectionPtr& conn)
+  {
+    if (conn->connected() && scenario_ == 0 && !running_)
+    {
+      startScenario();
+    }
+  }
+
+ private:
+  void startScenario()
+  {
+    const Scenario& s = kScenarios[scenario_];
+    latencies_.clear();
+    errors_ = 0;
+    running_ = true;
+    startNs_ = nowNs();
+    for (int i = 0; i < s.callers; ++i)
+    {
+      call();
+    }
+    loop_->runAfter(seconds, boost::bind(&Bench::stopScenario, this));
+  }
+
+  void call()
+  {
+    client_->call(kScenarios[scenario_].method, message, 1.0,
+                  boost::bind(&Bench::onResponse, this, nowNs(), _1, _2));
+  }
+
+  void onResponse(int64_t sentNs,
+                  muduo::RpcStatus status,
+                  const muduo::StringView& response)
+  {
+    if (status != muduo::kRpcOk || response != message)
+    {
+      ++errors_;
+    }
+    else
+    {
+      latencies_.push_back(nowNs() - sentNs);
+    }
+    if (running_)
+    {
+      call();
+    }
+    else if (client_->numPending() == 0)
+    {
+      finishScenario();
+    }
+  }
+
+  void stopScenario()
+  {
+    running_ = false;
+    elapsed_ = static_cast<double>(nowNs() - startNs_) / 1e9;
+    if (client_->numPending() == 0)
+    {
+      finishScenario();
+    }
+  }
+
+  void finishScenario()
+  {
+    const Scenario& s = kScenarios[scenario_];
+    std::sort(latencies_.begin(), latencies_.end());
+    printf("%s %4d callers: %8.0f calls/s  p50 %7.1fus  p99 %7.1fus"
+           "  p999 %7.1fus  errors %d\n",
+           s.name, s.callers,
+           static_cast<double>(latencies_.size()) / elapsed_,
+           percentileUs(latencies_, 0.5),
+           percentileUs(latencies_, 0.99),
+           percentileUs(latencies_, 0.999),
+           errors_);
+    fflush(stdout);
+    if (++scenario_ < kNumScenarios)
+    {
+      // not inside the callback of the last call
+      loop_->queueInLoop(boost::bind(&Bench::startScenario, this));
+    }
+    else
+    {
+      g_serverLoop->queueInLoop(
+          boost::bind(&muduo::EventLoop::quit, g_serverLoop));
+      loop_->quit();
+    }
+  }
+
+  muduo::EventLoop* loop_;
+  muduo::RpcClient* client_;
+  int scenario_;
+  bool running_;
+  int errors_;
+  int64_t startNs_;
+  double elapsed_;
+  std::vector<int64_t> latencies_;
+};
+
+void runClient()
+{
+  muduo::EventLoop loop;
+  muduo::RpcClient client(&loop, muduo::InetAddress("127.0.0.1", 9981));
+  Bench bench(&loop, &client);
+  client.setConnectionCallback(
+      boost::bind(&Bench::onConnection, &bench, _1));
+  client.connect();
+  loop.loop();
+}
+
+int main(int argc, char* argv[])
+{
+  seconds = argc > 1 ? atof(argv[1]) : 2.0;
+  int requestBytes = argc > 2 ? atoi(argv[2]) : 64;
+  message.assign(requestBytes, 'x');
+
+  muduo::EventLoop loop;
+  g_serverLoop = &loop;
+  muduo::RpcServer server(&loop, muduo::InetAddress(9981));
+  server.registerMethod(kEchoInLoop, echo);
+  server.registerMethod(kEchoInWorker, echo, muduo::RpcServer::kInWorker);
+  server.setWorkerThreads(2);
+  server.start();
+
+  muduo::Thread thread(runClient);
+  thread.start();
+  loop.loop();
+  thread.join();
+}
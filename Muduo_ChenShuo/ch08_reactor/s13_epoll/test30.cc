@@ -0,0 +1,283 @@
+// MemcacheServer: a protocol check, then a load of 90% get and 10% set,
+// prints ops/s.  Works with memcached too, start it on port 9981 with
+// server_threads -1 to test the client alone.
+// usage: test30 [connections] [server_threads] [pipeline_depth] [seconds]
+//               [keys] [value_bytes]
+// the client runs in a child process, so each side has its own fd limit.
+
+#include "MemcacheServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <string>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int pipelineDepth = 16;
+int numKeys = 10000;
+std::string value;
+int64_t numOps = 0;
+int64_t warmupOps = 0;
+int numConnected = 0;
+unsigned int seed = 1;
+muduo::Timestamp warmupEnd;
+
+// blocking, for the protocol check
+int connectServer()
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (int i = 0; i < 100; ++i)
+  {
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+    {
+      return fd;
+    }
+    ::usleep(10*1000);
+  }
+  perror("connect");
+  exit(1);
+}
+
+void expect(int fd, const std::string& request, const std::string& expected)
+{
+  if (::write(fd, request.data(), request.size())
+      != static_cast<ssize_t>(request.size()))
+  {
+    perror("write");
+    exit(1);
+  }
+  std::string response;
+  char buf[4096];
+  while (response.size() < expected.size())
+  {
+    ssize_t n = ::read(fd, buf, sizeof buf);
+    if (n <= 0)
+    {
+      break;
+    }
+    response.append(buf, n);
+  }
+  if (response != expected)
+  {
+    printf("protocol check failed\nrequest:\n%s\nexpected:\n%s\ngot:\n%s\n",
+           request.c_str(), expected.c_str(), response.c_str());
+    exit(1);
+  }
+}
+
+void checkProtocol()
+{
+  int fd = connectServer();
+  // keys on all shards, their replies come back in request order
+  std::string sets;
+  std::string stored;
+  std::string get = "get";
+  std::string values;
+  for (int i = 0; i < 16; ++i)
+  {
+    char key[16];
+    char line[64];
+    snprintf(key, sizeof key, "k%d", i);
+    snprintf(line, sizeof line, "set %s %d 0 %zd\r\n%s\r\n",
+             key, i, strlen(key), key);
+    sets += line;
+    stored += "STORED\r\n";
+    get += " ";
+    get += key;
+    snprintf(line, sizeof line, "VALUE %s %d %zd\r\n%s\r\n",
+             key, i, strlen(key), key);
+    values += line;
+  }
+  expect(fd, sets, stored);
+  expect(fd, get + " missing\r\n", values + "END\r\n");
+  expect(fd, "delete k3\r\ndelete k3\r\nget k3\r\n",
+         "DELETED\r\nNOT_FOUND\r\nEND\r\n");
+  expect(fd, "set e 0 -1 1\r\nz\r\nget e\r\n", "STORED\r\nEND\r\n");
+  expect(fd, "set n 0 0 1 noreply\r\nn\r\nget n\r\n",
+         "VALUE n 0 1\r\nn\r\nEND\r\n");
+  expect(fd, "bogus\r\nversion\r\n", "ERROR\r\nVERSION 1.4.0-muduo\r\n");
+
+  // preload, so gets hit
+  std::string preload;
+  for (int i = 0; i < numKeys; ++i)
+  {
+    char line[64];
+    snprintf(line, sizeof line, "set key:%d 0 0 %zd noreply\r\n",
+             i, value.size());
+    preload += line;
+    preload += value;
+    preload += "\r\n";
+  }
+  expect(fd, preload + "version\r\n", "VERSION 1.4.0-muduo\r\n");
+  ::close(fd);
+  printf("protocol check passed, %d keys loaded\n", numKeys);
+  fflush(stdout);
+}
+
+void sendRequests(const muduo::TcpConnectionPtr& conn, int n)
+{
+  muduo::Buffer buf;
+  for (int i = 0; i < n; ++i)
+  {
+    int key = rand_r(&seed) % numKeys;
+    char line[64];
+    if (rand_r(&seed) % 10 == 0)
+    {
+      int len = snprintf(line, sizeof line, "set key:%d 0 0 %zd\r\n",
+                         key, value.size());
+      buf.append(line, len);
+      buf.append(value);
+      buf.append("\r\n", 2);
+    }
+    else
+    {
+      int len = snprintf(line, sizeof line, "get key:%d\r\n", key);
+      buf.append(line, len);
+    }
+  }
+  conn->send(&buf);
+}
+
+void onClientConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    ++numConnected;
+    conn->setTcpNoDelay(true);
+    sendRequests(conn, pipelineDepth);
+  }
+}
+
+void onClientMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp)
+{
+  int done = 0;
+  const char* crlf = NULL;
+  while ((crlf = buf->findCRLF()) != NULL)
+  {
+    const char* line = buf->peek();
+    if (strncmp(line, "VALUE ", 6) == 0)
+    {
+      const char* space = static_cast<const char*>(
+          memrchr(line, ' ', crlf - line));
+      size_t bytes = atoi(space + 1);
+      if (static_cast<size_t>(buf->beginWrite() - crlf) < 2 + bytes + 2)
+      {
+        break;
+      }
+      buf->retrieveUntil(crlf + 2 + bytes + 2);
+    }
+    else if (strncmp(line, "END\r\n", 5) == 0
+             || strncmp(line, "STORED\r\n", 8) == 0)
+    {
+      ++done;
+      buf->retrieveUntil(crlf + 2);
+    }
+    else
+    {
+      printf("unexpected reply %s\n", std::string(line, crlf).c_str());
+      abort();
+    }
+  }
+  if (done > 0)
+  {
+    numOps += done;
+    sendRequests(conn, done);
+  }
+}
+
+void startMeasuring()
+{
+  warmupOps = numOps;
+  warmupEnd = muduo::Timestamp::now();
+}
+
+void runClient(int numConnections, double seconds)
+{
+  checkProtocol();
+
+  muduo::EventLoop loop;
+  muduo::InetAddress serverAddr("127.0.0.1", 9981);
+  boost::ptr_vector<muduo::TcpClient> clients;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    clients.push_back(new muduo::TcpClient(&loop, serverAddr));
+    clients.back().setConnectionCallback(onClientConnection);
+    clients.back().setMessageCallback(onClientMessage);
+    clients.back().connect();
+  }
+  loop.runAfter(1.0, startMeasuring);
+  loop.runAfter(seconds, boost::bind(&muduo::EventLoop::quit, &loop));
+  loop.loop();
+
+  double elapsed = timeDifference(muduo::Timestamp::now(), warmupEnd);
+  printf("%d connections (%d connected), pipeline %d: %.0f ops/s\n",
+         numConnections, numConnected, pipelineDepth,
+         static_cast<double>(numOps - warmupOps) / elapsed);
+  fflush(stdout);
+}
+
+void checkClient(muduo::EventLoop* loop, pid_t client)
+{
+  if (::waitpid(client, NULL, WNOHANG) == client)
+  {
+    loop->quit();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int numConnections = argc > 1 ? atoi(argv[1]) : 16;
+  int numThreads = argc > 2 ? atoi(argv[2]) : 2;
+  pipelineDepth = argc > 3 ? atoi(argv[3]) : 16;
+  double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+  numKeys = argc > 5 ? atoi(argv[5]) : 10000;
+  value.assign(argc > 6 ? atoi(argv[6]) : 32, 'v');
+
+  struct rlimit rl;
+  ::getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = rl.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &rl);
+
+  if (numThreads < 0)
+  {
+    runClient(numConnections, seconds);
+    return 0;
+  }
+
+  // before any EventLoop, one per thread
+  pid_t client = ::fork();
+  if (client == 0)
+  {
+    runClient(numConnections, seconds);
+    _exit(0);
+  }
+
+  muduo::EventLoop loop;
+  muduo::MemcacheServer server(&loop, muduo::InetAddress(9981),
+                               64*1024*1024);
+  server.setThreadNum(numThreads);
+  server.start();
+
+  loop.runEvery(0.1, boost::bind(checkClient, &loop, client));
+  loop.loop();
+  printf("server forwarded %lld requests to other shards\n",
+         static_cast<long long>(server.numForwarded()));
+}
@@ -0,0 +1,396 @@
+// TcpRelay against a proxy that copies through buffers, prints MB/s.
+// The proxy listens on 9981 and connects each client to an echo
+// backend on 9982.  Clients check the bytes that come back; with splice
+// they shut down writing when done and wait for the end of file, which
+// must come back through both half-closes.
+// usage: test31 [splice|copy] [connections] [megabytes_per_connection]
+// the clients and the backend run in a child process.
+
+#include "TcpRelay.h"
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const size_t kHighWaterMark = 1024*1024;
+const size_t kChunk = 64*1024;
+bool useSplice = true;
+size_t bytesPerConnection = 0;
+muduo::EventLoop* g_loop;
+int64_t relayedBytes = 0;
+
+struct Tunnel
+{
+  explicit Tunnel(const muduo::TcpConnectionPtr& conn)
+    : client(conn),
+      backend(g_loop, muduo::InetAddress("127.0.0.1", 9982))
+  {
+  }
+
+  boost::weak_ptr<muduo::TcpConnection> client;
+  muduo::TcpConnectionPtr backendConn;
+  muduo::TcpClient backend;
+};
+
+typedef boost::shared_ptr<Tunnel> TunnelPtr;
+typedef boost::weak_ptr<Tunnel> TunnelWeakPtr;
+
+// ---- proxy, in the parent ----
+
+void onRelayClose(const muduo::TcpRelayPtr& relay)
+{
+  relayedBytes += relay->forwardBytes() + relay->backwardBytes();
+}
+
+void onBackendConnection(const TunnelWeakPtr& weakTunnel,
+                         const muduo::TcpConnectionPtr& conn)
+{
+  TunnelPtr tunnel(weakTunnel.lock());
+  muduo::TcpConnectionPtr client(tunnel ? tunnel->client.lock()
+                                        : muduo::TcpConnectionPtr());
+  if (!conn->connected())
+  {
+    if (client)
+    {
+      client->shutdown();
+    }
+    if (tunnel)
+    {
+      tunnel->backendConn.reset();
+    }
+    return;
+  }
+  if (!client)
+  {
+    conn->shutdown();
+    return;
+  }
+  if (useSplice)
+  {
+    muduo::TcpRelayPtr relay(boost::make_shared<muduo::TcpRelay>(client, conn));
+    relay->setCloseCallback(onRelayClose);
+    relay->start();
+  }
+  else
+  {
+    tunnel->backendConn = conn;
+    client->startRead();
+  }
+}
+
+void onBackendMessage(const TunnelWeakPtr& weakTunnel,
+                      const muduo::TcpConnectionPtr& conn,
+                      muduo::Buffer* buf,
+                      muduo::Timestamp)
+{
+  TunnelPtr tunnel(weakTunnel.lock());
+  muduo::TcpConnectionPtr client(tunnel ? tunnel->client.lock()
+                                        : muduo::TcpConnectionPtr());
+  if (client)
+  {
+    relayedBytes += buf->readableBytes();
+    client->send(buf);
+    if (client->pendingOutputBytes() > kHighWaterMark)
+    {
+      conn->stopRead();
+    }
+  }
+  else
+  {
+    buf->retrieveAll();
+  }
+}
+
+void onBackendWriteComplete(const TunnelWeakPtr& weakTunnel,
+                            const muduo::TcpConnectionPtr&)
+{
+  TunnelPtr tunnel(weakTunnel.lock());
+  muduo::TcpConnectionPtr client(tunnel ? tunnel->client.lock()
+                                        : muduo::TcpConnectionPtr());
+  if (client)
+  {
+    client->startRead();
+  }
+}
+
+void onClientMessage(const TunnelPtr& tunnel,
+                     const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp)
+{
+  if (tunnel->backendConn)
+  {
+    relayedBytes += buf->readableBytes();
+    tunnel->backendConn->send(buf);
+    if (tunnel->backendConn->pendingOutputBytes() > kHighWaterMark)
+    {
+      conn->stopRead();
+    }
+  }
+}
+
+void onClientWriteComplete(const TunnelPtr& tunnel,
+                           const muduo::TcpConnectionPtr&)
+{
+  if (tunnel->backendConn)
+  {
+    tunnel->backendConn->startRead();
+  }
+}
+
+void onClientConnection(const TunnelPtr& tunnel,
+                        const muduo::TcpConnectionPtr& conn)
+{
+  if (!conn->connected() && tunnel->backendConn)
+  {
+    tunnel->backendConn->shutdown();
+  }
+}
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    return;
+  }
+  // nothing to do with the bytes until the backend is connected
+  conn->stopRead();
+  TunnelPtr tunnel(new Tunnel(conn));
+  TunnelWeakPtr weakTunnel(tunnel);
+  tunnel->backend.setConnectionCallback(
+      boost::bind(onBackendConnection, weakTunnel, _1));
+  tunnel->backend.setMessageCallback(
+      boost::bind(onBackendMessage, weakTunnel, _1, _2, _3));
+  tunnel->backend.setWriteCompleteCallback(
+      boost::bind(onBackendWriteComplete, weakTunnel, _1));
+  // the client connection owns the tunnel
+  conn->setConnectionCallback(boost::bind(onClientConnection, tunnel, _1));
+  conn->setMessageCallback(boost::bind(onClientMessage, tunnel, _1, _2, _3));
+  conn->setWriteCompleteCallback(
+      boost::bind(onClientWriteComplete, tunnel, _1));
+  tunnel->backend.connect();
+}
+
+// ---- backend and clients, in the child ----
+
+void writeAll(int fd, const char* data, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = ::write(fd, data, len);
+    if (n <= 0)
+    {
+      perror("write");
+      exit(1);
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+void echo(int fd)
+{
+  char buf[kChunk];
+  ssize_t n = 0;
+  while ((n = ::read(fd, buf, sizeof buf)) > 0)
+  {
+    writeAll(fd, buf, n);
+  }
+  ::shutdown(fd, SHUT_WR);
+  // wait for the proxy to close
+  while (::read(fd, buf, sizeof buf) > 0)
+  {
+  }
+  ::close(fd);
+}
+
+void runBackend(int listenFd, int numConnections)
+{
+  boost::ptr_vector<muduo::Thread> threads;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    int fd = ::accept(listenFd, NULL, NULL);
+    threads.push_back(new muduo::Thread(boost::bind(echo, fd)));
+    threads.back().start();
+  }
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+}
+
+char pattern(size_t offset)
+{
+  return static_cast<char>(offset % 251);
+}
+
+void writeClient(int fd)
+{
+  char buf[kChunk];
+  for (size_t offset = 0; offset < bytesPerConnection; offset += kChunk)
+  {
+    size_t len = std::min(kChunk, bytesPerConnection - offset);
+    for (size_t i = 0; i < len; ++i)
+    {
+      buf[i] = pattern(offset + i);
+    }
+    writeAll(fd, buf, len);
+  }
+  if (useSplice)
+  {
+    ::shutdown(fd, SHUT_WR);
+  }
+}
+
+void readClient(int fd)
+{
+  char buf[kChunk];
+  size_t offset = 0;
+  while (offset < bytesPerConnection)
+  {
+    ssize_t n = ::read(fd, buf, sizeof buf);
+    if (n <= 0)
+    {
+      printf("connection closed after %zd of %zd bytes\n",
+             offset, bytesPerConnection);
+      exit(1);
+    }
+    for (ssize_t i = 0; i < n; ++i)
+    {
+      if (buf[i] != pattern(offset + i))
+      {
+        printf("wrong byte at %zd\n", offset + i);
+        exit(1);
+      }
+    }
+    offset += n;
+  }
+  if (useSplice && ::read(fd, buf, sizeof buf) != 0)
+  {
+    printf("no end of file after the echo\n");
+    exit(1);
+  }
+}
+
+int connectProxy()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (int i = 0; i < 100; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+    {
+      return fd;
+    }
+    ::close(fd);
+    ::usleep(10*1000);
+  }
+  perror("connect");
+  exit(1);
+}
+
+void runClients(int numConnections)
+{
+  int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9982);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0
+      || ::listen(listenFd, SOMAXCONN) < 0)
+  {
+    perror("backend");
+    exit(1);
+  }
+  muduo::Thread backend(boost::bind(runBackend, listenFd, numConnections));
+  backend.start();
+
+  muduo::Timestamp start(muduo::Timestamp::now());
+  std::vector<int> fds;
+  boost::ptr_vector<muduo::Thread> threads;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    fds.push_back(connectProxy());
+    threads.push_back(new muduo::Thread(boost::bind(writeClient, fds.back())));
+    threads.back().start();
+    threads.push_back(new muduo::Thread(boost::bind(readClient, fds.back())));
+    threads.back().start();
+  }
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+  double seconds = timeDifference(muduo::Timestamp::now(), start);
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    ::close(fds[i]);
+  }
+  backend.join();
+
+  double megabytes = static_cast<double>(bytesPerConnection)
+                     * numConnections / (1024*1024);
+  printf("%s: %d connections, %.0f MiB each way in %.3f s, %.1f MiB/s\n",
+         useSplice ? "splice" : "copy", numConnections,
+         megabytes, seconds, megabytes / seconds);
+  fflush(stdout);
+}
+
+void checkClient(pid_t client)
+{
+  int status = 0;
+  if (::waitpid(client, &status, WNOHANG) == client)
+  {
+    if (status != 0)
+    {
+      printf("client failed\n");
+    }
+    g_loop->quit();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  useSplice = argc > 1 ? strcmp(argv[1], "copy") != 0 : true;
+  int numConnections = argc > 2 ? atoi(argv[2]) : 4;
+  bytesPerConnection = (argc > 3 ? atoi(argv[3]) : 256) * 1024 * 1024L;
+
+  // before any EventLoop, one per thread
+  pid_t client = ::fork();
+  if (client == 0)
+  {
+    runClients(numConnections);
+    _exit(0);
+  }
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setConnectionCallback(onConnection);
+  server.start();
+
+  loop.runEvery(0.1, boost::bind(checkClient, client));
+  loop.loop();
+  printf("proxy relayed %lld bytes\n", static_cast<long long>(relayedBytes));
+}
@@ -0,0 +1,235 @@
+// Traffic capture and replay.
+// Captures request-response traffic of clients to an echo server, then
+// replays the capture to the server at 1x, 4x and full speed, prints
+// how long each took and how far it fell behind the captured times.
+// usage: test32 [capture_file] [connections] [requests_per_connection]
+//        test32 replay capture_file ip port [speed]
+// the second form replays a capture to any server, 0 is full speed.
+
+#include "TrafficCapture.h"
+#include "TrafficReplayer.h"
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+muduo::EventLoop* g_loop;
+int requestsPerConnection = 20;
+unsigned int seed = 1;
+
+// ---- clients, in the child ----
+
+struct Client
+{
+  explicit Client(const muduo::InetAddress& serverAddr)
+    : client(g_loop, serverAddr), remaining(requestsPerConnection)
+  {
+  }
+
+  muduo::TcpClient client;
+  int remaining;
+};
+
+void sendRequest(Client* c)
+{
+  muduo::TcpConnectionPtr conn(c->client.connection());
+  if (conn)
+  {
+    // a sudoku puzzle shaped line
+    char line[96];
+    for (int i = 0; i < 81; ++i)
+    {
+      line[i] = static_cast<char>('0' + rand_r(&seed) % 10);
+    }
+    memcpy(line + 81, "\r\n", 2);
+    conn->send(std::string(line, 83));
+  }
+}
+
+void onClientConnection(Client* c, const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    sendRequest(c);
+  }
+}
+
+void onClientMessage(Client* c, const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf, muduo::Timestamp)
+{
+  const char* crlf = NULL;
+  while ((crlf = buf->findCRLF()) != NULL)
+  {
+    buf->retrieveUntil(crlf + 2);
+    if (--c->remaining > 0)
+    {
+      // think time of 1 to 20 ms
+      g_loop->runAfter(0.001 * (1 + rand_r(&seed) % 20),
+                       boost::bind(sendRequest, c));
+    }
+    else
+    {
+      conn->shutdown();
+    }
+  }
+}
+
+void runClients(int numConnections)
+{
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::InetAddress serverAddr("127.0.0.1", 9981);
+  boost::ptr_vector<Client> clients;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    clients.push_back(new Client(serverAddr));
+    Client* c = &clients.back();
+    c->client.setConnectionCallback(boost::bind(onClientConnection, c, _1));
+    c->client.setMessageCallback(boost::bind(onClientMessage, c, _1, _2, _3));
+    // connections arrive over the first second
+    loop.runAfter(1.0 * i / numConnections,
+                  boost::bind(&muduo::TcpClient::connect, &c->client));
+  }
+  // long enough for all requests
+  loop.runAfter(2.0 + 0.021 * requestsPerConnection,
+                boost::bind(&muduo::EventLoop::quit, &loop));
+  loop.loop();
+}
+
+// ---- server and replays, in the parent ----
+
+void onServerConnection(const muduo::TcpConnectionPtr&)
+{
+}
+
+void onServerMessage(const muduo::TcpConnectionPtr& conn,
+                     muduo::Buffer* buf,
+                     muduo::Timestamp)
+{
+  conn->send(buf);
+}
+
+const double kSpeeds[] = { 1.0, 4.0, 0.0 };
+const size_t kNumSpeeds = sizeof kSpeeds / sizeof kSpeeds[0];
+boost::ptr_vector<muduo::TrafficReplayer> replayers;
+std::string captureFile;
+
+void printReplay(const muduo::TrafficReplayer& r, double speed)
+{
+  char pace[32];
+  snprintf(pace, sizeof pace, speed > 0 ? "%gx" : "full speed", speed);
+  printf("replay at %s: %d connections, %d refused, %d at most at once, "
+         "sent %lld received %lld bytes in %.3f s, at most %.1f ms late\n",
+         pace, r.numConnections(), r.numFailed(), r.maxConcurrency(),
+         static_cast<long long>(r.bytesSent()),
+         static_cast<long long>(r.bytesReceived()),
+         r.elapsed(), r.maxLag() * 1000);
+  fflush(stdout);
+}
+
+void replayNext()
+{
+  if (!replayers.empty())
+  {
+    const muduo::TrafficReplayer& r = replayers.back();
+    printReplay(r, kSpeeds[replayers.size() - 1]);
+    if (r.bytesReceived() != r.bytesSent())
+    {
+      printf("echo bytes differ\n");
+    }
+  }
+  if (replayers.size() == kNumSpeeds)
+  {
+    g_loop->quit();
+    return;
+  }
+  replayers.push_back(new muduo::TrafficReplayer(
+      g_loop, muduo::InetAddress("127.0.0.1", 9981), captureFile,
+      kSpeeds[replayers.size()]));
+  replayers.back().setFinishCallback(replayNext);
+  replayers.back().start();
+}
+
+void checkClient(pid_t client, muduo::TrafficRecorder* recorder,
+                 muduo::TcpServer* server)
+{
+  if (::waitpid(client, NULL, WNOHANG) == client)
+  {
+    // the replays are not recorded
+    server->setTrafficRecorder(NULL);
+    recorder->stop();
+    printf("captured %lld bytes, dropped %lld\n",
+           static_cast<long long>(recorder->writtenBytes()),
+           static_cast<long long>(recorder->droppedBytes()));
+    fflush(stdout);
+    replayNext();
+  }
+}
+
+void quitAfterReplay(muduo::TrafficReplayer* replayer, double speed)
+{
+  printReplay(*replayer, speed);
+  g_loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 4 && strcmp(argv[1], "replay") == 0)
+  {
+    muduo::EventLoop loop;
+    g_loop = &loop;
+    double speed = argc > 5 ? atof(argv[5]) : 1.0;
+    muduo::TrafficReplayer replayer(
+        &loop,
+        muduo::InetAddress(argv[3], static_cast<uint16_t>(atoi(argv[4]))),
+        argv[2], speed);
+    replayer.setFinishCallback(boost::bind(quitAfterReplay, &replayer, speed));
+    if (!replayer.start())
+    {
+      return 1;
+    }
+    loop.loop();
+    return 0;
+  }
+
+  captureFile = argc > 1 ? argv[1] : "/tmp/test32.cap";
+  int numConnections = argc > 2 ? atoi(argv[2]) : 50;
+  requestsPerConnection = argc > 3 ? atoi(argv[3]) : 20;
+
+  // before any EventLoop, one per thread
+  pid_t client = ::fork();
+  if (client == 0)
+  {
+    // give the server time to listen
+    ::usleep(100*1000);
+    runClients(numConnections);
+    _exit(0);
+  }
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TrafficRecorder recorder(captureFile);
+  if (!recorder.start())
+  {
+    return 1;
+  }
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setConnectionCallback(onServerConnection);
+  server.setMessageCallback(onServerMessage);
+  server.setTrafficRecorder(&recorder);
+  server.start();
+
+  loop.runEvery(0.1, boost::bind(checkClient, client, &recorder, &server));
+  loop.loop();
+  // in the loop thread, before the loop goes away
+  replayers.clear();
+}
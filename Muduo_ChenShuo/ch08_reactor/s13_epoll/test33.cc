@@ -0,0 +1,164 @@
+// policy benchmark: the same loop-bound work on specialized BasicEventLoops,
+// one JSON object per result on stdout.
+// usage: test33 [all|pingpong|functors] [seconds]
+// build optimized with "make bench": bench_policies.
+
+#include "Channel.h"
+#include "EventLoop.h"
+
+#include <boost/bind.hpp>
+
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+using muduo::BasicEventLoop;
+using muduo::BasicBusyEPoller;
+using muduo::BasicEPoller;
+using muduo::BasicPoller;
+using muduo::BasicTimerQueue;
+using muduo::LockedQueue;
+using muduo::SingleThreadQueue;
+
+typedef BasicEventLoop<BasicEPoller, BasicTimerQueue, SingleThreadQueue>
+        SingleThreadLoop;
+typedef BasicEventLoop<BasicBusyEPoller, BasicTimerQueue, SingleThreadQueue>
+        BusyLoop;
+typedef BasicEventLoop<BasicPoller, BasicTimerQueue, SingleThreadQueue>
+        SinglePollLoop;
+
+double seconds = 2.0;
+
+int64_t nowNs()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+template <typename Loop>
+class Bench
+{
+ public:
+  typedef typename Loop::ChannelType ChannelType;
+
+  explicit Bench(const char* name)
+    : name_(name),
+      count_(0)
+  {
+  }
+
+  // 8 bytes bounce between the two ends of a socketpair,
+  // both channels belong to the loop.
+  void pingpong()
+  {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                     0, fds) < 0)
+    {
+      perror("socketpair");
+      exit(1);
+    }
+    Loop loop;
+    ChannelType left(&loop, fds[0]);
+    ChannelType right(&loop, fds[1]);
+    left.setReadCallback(boost::bind(&Bench::bounce, this, fds[0], _1));
+    right.setReadCallback(boost::bind(&Bench::bounce, this, fds[1], _1));
+    left.enableReading();
+    right.enableReading();
+
+    count_ = 0;
+    char buf[8] = { 0 };
+    ::write(fds[0], buf, sizeof buf);
+    loop.runAfter(seconds, boost::bind(&Loop::quit, &loop));
+    int64_t start = nowNs();
+    loop.loop();
+    double elapsed = (nowNs() - start) / 1e9;
+
+    left.disableAll();
+    right.disableAll();
+    loop.removeChannel(&left);
+    loop.removeChannel(&right);
+    ::close(fds[0]);
+    ::close(fds[1]);
+    printf("{\"bench\":\"pingpong\",\"loop\":\"%s\",\"messages_per_s\":%.0f}\n",
+           name_, count_ / elapsed);
+  }
+
+  // every functor queues the next one, one loop iteration each.
+  void functors()
+  {
+    Loop loop;
+    count_ = 0;
+    loop_ = &loop;
+    stop_ = false;
+    loop.runAfter(seconds, boost::bind(&Bench::stop, this));
+    // from a callback, queueing before loop() would wait for a wakeup
+    loop.runAfter(0, boost::bind(&Bench::chain, this));
+    int64_t start = nowNs();
+    loop.loop();
+    double elapsed = (nowNs() - start) / 1e9;
+    printf("{\"bench\":\"functors\",\"loop\":\"%s\",\"functors_per_s\":%.0f}\n",
+           name_, count_ / elapsed);
+  }
+
+ private:
+  void bounce(int fd, muduo::Timestamp)
+  {
+    char buf[8];
+    ssize_t n = ::read(fd, buf, sizeof buf);
+    if (n > 0)
+    {
+      ++count_;
+      ::write(fd, buf, n);
+    }
+  }
+
+  void chain()
+  {
+    ++count_;
+    if (stop_)
+    {
+      loop_->quit();
+    }
+    else
+    {
+      loop_->queueInLoop(boost::bind(&Bench::chain, this));
+    }
+  }
+
+  void stop() { stop_ = true; }
+
+  const char* name_;
+  int64_t count_;
+  Loop* loop_;
+  bool stop_;
+};
+
+template <typename Loop>
+void run(const char* name, const std::string& which)
+{
+  Bench<Loop> bench(name);
+  bool all = which == "all";
+  if (all || which == "pingpong")
+    bench.pingpong();
+  if (all || which == "functors")
+    bench.functors();
+}
+
+int main(int argc, char* argv[])
+{
+  std::string which = argc > 1 ? argv[1] : "all";
+  seconds = argc > 2 ? atof(argv[2]) : 2.0;
+
+  // loops run one after another, one loop per thread at a time.
+  run<muduo::EventLoop>("default", which);
+  run<SingleThreadLoop>("single_thread", which);
+  run<BusyLoop>("busy_poll", which);
+  run<SinglePollLoop>("single_thread_poll", which);
+  fflush(stdout);
+}
@@ -0,0 +1,172 @@
+// buffer budget of TcpServer: accounting and backpressure.
+// two clients flood an echo server without reading the replies,
+// a third one pingpongs.  after 2s the flooders drain their replies.
+// usage: test34 [budget_kib]
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+muduo::EventLoop* g_loop;
+muduo::TcpServer* g_server;
+muduo::AtomicInt64 pingpongs;
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+}
+
+void onMessage(const muduo::TcpConnectionPtr& conn,
+               muduo::Buffer* buf,
+               muduo::Timestamp)
+{
+  conn->send(buf);
+}
+
+void onSendRefused(const muduo::TcpConnectionPtr& conn, size_t len)
+{
+  LOG_DEBUG << conn->name() << " refused " << len << " bytes";
+}
+
+void onBudget(bool exceeded)
+{
+  printf("budget %s\n", exceeded ? "exceeded" : "resumed");
+}
+
+void printStats()
+{
+  muduo::BufferBudget* budget = g_server->bufferBudget();
+  printf("server: %6lld KiB buffered, %d paused, %lld sends refused (%lld KiB)\n",
+         static_cast<long long>(budget->bytes() / 1024),
+         g_server->numBudgetPaused(),
+         static_cast<long long>(budget->refusedSends()),
+         static_cast<long long>(budget->refusedBytes() / 1024));
+  std::vector<muduo::EventLoop*> loops = g_server->threadPool()->getAllLoops();
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    printf("  loop %zd: input %lld KiB, output %lld KiB\n", i,
+           static_cast<long long>(loops[i]->bufferedInputBytes() / 1024),
+           static_cast<long long>(loops[i]->bufferedOutputBytes() / 1024));
+  }
+  printf("  pingpongs so far %lld\n", static_cast<long long>(pingpongs.get()));
+}
+
+int connectOne(int rcvbuf)
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (rcvbuf > 0)
+  {
+    // small, so the replies pile up in the server
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+  }
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    perror("connect");
+    exit(1);
+  }
+  return fd;
+}
+
+void pingpong(int fd)
+{
+  char buf[64] = "ping";
+  if (::write(fd, buf, sizeof buf) == sizeof buf)
+  {
+    ssize_t n = 0;
+    while (n < static_cast<ssize_t>(sizeof buf))
+    {
+      ssize_t nr = ::read(fd, buf, sizeof buf - n);
+      if (nr <= 0)
+        return;
+      n += nr;
+    }
+    pingpongs.increment();
+  }
+}
+
+void clients()
+{
+  int polite = connectOne(0);
+  std::vector<int> flooders;
+  flooders.push_back(connectOne(64 * 1024));
+  flooders.push_back(connectOne(64 * 1024));
+  std::string chunk(64 * 1024, 'x');
+  std::vector<char> sink(256 * 1024);
+
+  muduo::Timestamp start(muduo::Timestamp::now());
+  double elapsed = 0;
+  while ((elapsed = timeDifference(muduo::Timestamp::now(), start)) < 4.0)
+  {
+    for (size_t i = 0; i < flooders.size(); ++i)
+    {
+      if (elapsed < 2.0)
+      {
+        // never blocks, the server may have stopped reading
+        ::send(flooders[i], chunk.data(), chunk.size(), MSG_DONTWAIT);
+      }
+      else
+      {
+        while (::recv(flooders[i], &*sink.begin(), sink.size(),
+                      MSG_DONTWAIT) > 0)
+        {
+        }
+      }
+    }
+    pingpong(polite);
+    usleep(1000);
+  }
+  ::close(polite);
+  for (size_t i = 0; i < flooders.size(); ++i)
+  {
+    ::close(flooders[i]);
+  }
+  g_loop->runAfter(0.5, boost::bind(&muduo::EventLoop::quit, g_loop));
+}
+
+int main(int argc, char* argv[])
+{
+  int64_t budgetKiB = argc > 1 ? atoi(argv[1]) : 4096;
+  printf("budget %lld KiB, flooding 2s, then draining 2s\n",
+         static_cast<long long>(budgetKiB));
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  g_server = &server;
+  server.setThreadNum(2);
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.setSendRefusedCallback(onSendRefused);
+  server.setBufferBudget(budgetKiB * 1024);
+  server.setBufferBudgetCallback(onBudget);
+  server.start();
+  loop.runEvery(0.5, printStats);
+
+  muduo::Thread thread(clients);
+  thread.start();
+  loop.loop();
+  thread.join();
+  printStats();
+}
@@ -0,0 +1,191 @@
+// elastic IO threads of TcpServer.
+// busy phase: clients reconnect often and each message burns CPU,
+// the pool grows.  quiet phase: clients keep their connections and
+// send now and then, the pool shrinks and connections move between
+// loops, every reply is checked.
+// usage: test35 [busy_seconds] [quiet_seconds] [clients]
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+muduo::EventLoop* g_loop;
+muduo::TcpServer* g_server;
+double busySeconds = 4.0;
+double quietSeconds = 8.0;
+int numClients = 8;
+muduo::Timestamp g_start;
+muduo::AtomicInt32 busy;  // clients in the busy phase
+muduo::AtomicInt64 messages;
+muduo::AtomicInt64 errors;
+muduo::AtomicInt32 running;
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+}
+
+void onMessage(const muduo::TcpConnectionPtr& conn,
+               muduo::Buffer* buf,
+               muduo::Timestamp)
+{
+  if (busy.get() > 0)
+  {
+    // 100us of work per message
+    muduo::Timestamp start(muduo::Timestamp::now());
+    while (timeDifference(muduo::Timestamp::now(), start) < 100e-6)
+    {
+    }
+  }
+  conn->send(buf);
+}
+
+std::map<muduo::EventLoop*, int64_t> samples;
+muduo::Timestamp lastSample;
+
+void printStats()
+{
+  muduo::Timestamp now(muduo::Timestamp::now());
+  double elapsed = timeDifference(now, lastSample) * 1e6;
+  lastSample = now;
+  std::vector<muduo::EventLoop*> loops = g_server->threadPool()->getAllLoops();
+  printf("%4.1fs %-5s %d loops, busy", timeDifference(now, g_start),
+         busy.get() > 0 ? "busy" : "quiet", static_cast<int>(loops.size()));
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    int64_t us = loops[i]->busyMicroseconds();
+    if (samples.count(loops[i]))
+    {
+      printf(" %3.0f%%", (us - samples[loops[i]]) / elapsed * 100);
+    }
+    else
+    {
+      printf("  new");
+    }
+    samples[loops[i]] = us;
+  }
+  printf(", %lld messages, %lld errors\n",
+         static_cast<long long>(messages.get()),
+         static_cast<long long>(errors.get()));
+  if (running.get() == 0)
+  {
+    g_loop->quit();
+  }
+}
+
+int connectOne()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    perror("connect");
+    exit(1);
+  }
+  return fd;
+}
+
+// returns false if the reply is not the request
+bool roundTrip(int fd, int seq)
+{
+  char request[32];
+  snprintf(request, sizeof request, "request %d", seq);
+  if (::write(fd, request, sizeof request) != sizeof request)
+  {
+    return false;
+  }
+  char reply[32];
+  size_t n = 0;
+  while (n < sizeof reply)
+  {
+    ssize_t nr = ::read(fd, reply + n, sizeof reply - n);
+    if (nr <= 0)
+    {
+      return false;
+    }
+    n += nr;
+  }
+  messages.increment();
+  return memcmp(request, reply, sizeof reply) == 0;
+}
+
+void client()
+{
+  int seq = 0;
+  // reconnects every 200 messages, new connections go to new loops
+  while (timeDifference(muduo::Timestamp::now(), g_start) < busySeconds)
+  {
+    int fd = connectOne();
+    for (int i = 0; i < 200; ++i)
+    {
+      if (!roundTrip(fd, seq++))
+        errors.increment();
+    }
+    ::close(fd);
+  }
+  busy.decrement();
+
+  int fd = connectOne();
+  while (timeDifference(muduo::Timestamp::now(), g_start)
+         < busySeconds + quietSeconds)
+  {
+    if (!roundTrip(fd, seq++))
+      errors.increment();
+    usleep(20*1000);
+  }
+  ::close(fd);
+  running.decrement();
+}
+
+int main(int argc, char* argv[])
+{
+  busySeconds = argc > 1 ? atof(argv[1]) : 4.0;
+  quietSeconds = argc > 2 ? atof(argv[2]) : 8.0;
+  numClients = argc > 3 ? atoi(argv[3]) : 8;
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  g_server = &server;
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.setElasticThreads(1, 4, 0.5, 0.1, 0.5);
+  server.start();
+
+  g_start = muduo::Timestamp::now();
+  lastSample = g_start;
+  busy.getAndSet(numClients);
+  running.getAndSet(numClients);
+  loop.runEvery(0.5, printStats);
+  boost::ptr_vector<muduo::Thread> threads;
+  for (int i = 0; i < numClients; ++i)
+  {
+    threads.push_back(new muduo::Thread(client));
+    threads.back().start();
+  }
+  loop.loop();
+  for (int i = 0; i < numClients; ++i)
+  {
+    threads[i].join();
+  }
+}
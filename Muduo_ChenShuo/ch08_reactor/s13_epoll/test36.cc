@@ -0,0 +1,191 @@
+// per-connection context: a line protocol whose parser lives in
+// the TcpConnection, no allocation and no boost::any_cast per message.
+// clients write lines split at random points, the server numbers them,
+// every reply is checked.
+// usage: test36 [clients] [lines]
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <string>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+muduo::EventLoop* g_loop;
+int numClients = 4;
+int numLines = 10000;
+muduo::AtomicInt32 liveContexts;
+muduo::AtomicInt32 running;
+muduo::AtomicInt64 errors;
+
+// state of one connection, numbers the lines it has seen
+class LineCounter
+{
+ public:
+  LineCounter() : lines_(0), scanned_(0) { liveContexts.increment(); }
+  ~LineCounter() { liveContexts.decrement(); }
+
+  // replies to the complete lines in buf, remembers how far it looked
+  void parse(muduo::Buffer* buf, muduo::Buffer* output)
+  {
+    const char* eol = NULL;
+    while ((eol = static_cast<const char*>(
+                ::memchr(buf->peek() + scanned_, '\n',
+                         buf->readableBytes() - scanned_))) != NULL)
+    {
+      char num[32];
+      int n = snprintf(num, sizeof num, "%d ", ++lines_);
+      output->append(num, n);
+      output->append(buf->peek(), eol + 1 - buf->peek());
+      buf->retrieveUntil(eol + 1);
+      scanned_ = 0;
+    }
+    scanned_ = buf->readableBytes();
+  }
+
+ private:
+  int lines_;
+  size_t scanned_;  // bytes of buf without a newline
+};
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->emplaceContext<LineCounter>();
+    // typed, another type gets nothing
+    assert(conn->context<int>() == NULL);
+  }
+}
+
+void onMessage(const muduo::TcpConnectionPtr& conn,
+               muduo::Buffer* buf,
+               muduo::Timestamp)
+{
+  LineCounter* counter = conn->context<LineCounter>();
+  assert(counter);
+  muduo::Buffer output(0);
+  counter->parse(buf, &output);
+  if (output.readableBytes() > 0)
+  {
+    conn->send(&output);
+  }
+}
+
+int connectOne()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    perror("connect");
+    exit(1);
+  }
+  return fd;
+}
+
+void client(int seed)
+{
+  int fd = connectOne();
+  std::string request;
+  std::string expected;
+  for (int i = 1; i <= numLines; ++i)
+  {
+    char line[64];
+    snprintf(line, sizeof line, "line %d of client %d\n", i, seed);
+    request += line;
+    char num[32];
+    snprintf(num, sizeof num, "%d ", i);
+    expected += num;
+    expected += line;
+  }
+
+  // writes in random pieces, lines often span two messages
+  unsigned int rand = seed;
+  size_t written = 0;
+  std::string reply;
+  char buf[4096];
+  while (written < request.size())
+  {
+    size_t len = rand_r(&rand) % 100 + 1;
+    if (len > request.size() - written)
+      len = request.size() - written;
+    ssize_t nw = ::write(fd, request.data() + written, len);
+    if (nw <= 0)
+      break;
+    written += nw;
+    // keeps the replies from filling up the socket
+    ssize_t nr = 0;
+    while ((nr = ::recv(fd, buf, sizeof buf, MSG_DONTWAIT)) > 0)
+    {
+      reply.append(buf, nr);
+    }
+  }
+  ::shutdown(fd, SHUT_WR);
+  while (reply.size() < expected.size())
+  {
+    ssize_t nr = ::read(fd, buf, sizeof buf);
+    if (nr <= 0)
+      break;
+    reply.append(buf, nr);
+  }
+  ::close(fd);
+  if (reply != expected)
+  {
+    errors.increment();
+  }
+  if (running.decrementAndGet() == 0)
+  {
+    // lets the server close the connections
+    g_loop->runAfter(0.5, boost::bind(&muduo::EventLoop::quit, g_loop));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  numClients = argc > 1 ? atoi(argv[1]) : 4;
+  numLines = argc > 2 ? atoi(argv[2]) : 10000;
+  printf("context area %zd bytes, LineCounter %zd bytes\n",
+         muduo::TcpConnection::kContextSize, sizeof(LineCounter));
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setThreadNum(2);
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.start();
+
+  running.getAndSet(numClients);
+  boost::ptr_vector<muduo::Thread> threads;
+  for (int i = 0; i < numClients; ++i)
+  {
+    threads.push_back(new muduo::Thread(boost::bind(client, i + 1)));
+    threads.back().start();
+  }
+  loop.loop();
+  for (int i = 0; i < numClients; ++i)
+  {
+    threads[i].join();
+  }
+  printf("%d clients, %d lines each, %lld errors, %d contexts left\n",
+         numClients, numLines, static_cast<long long>(errors.get()),
+         liveContexts.get());
+}
@@ -0,0 +1,122 @@
+// TcpClient to replicas: staggered connects, the fastest wins.
+// port 9983 refuses, port 9982 drops SYNs as its accept queue is full,
+// port 9981 is up.  the server closes every connection, the client
+// reconnects and should go to 9981 first from then on.
+// usage: test37 [rounds]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <boost/bind.hpp>
+
+#include <vector>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+muduo::EventLoop* g_loop;
+muduo::TcpClient* g_client;
+int rounds = 5;
+int g_round = 0;
+muduo::Timestamp g_downTime;
+
+struct sockaddr_in loopback(uint16_t port)
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return addr;
+}
+
+// a listener that never accepts, connects to it hang once its
+// accept queue is full.  returns the fds to keep open.
+std::vector<int> blackhole(uint16_t port)
+{
+  std::vector<int> fds;
+  struct sockaddr_in addr = loopback(port);
+  int listenfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int on = 1;
+  ::setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+  if (::bind(listenfd, reinterpret_cast<struct sockaddr*>(&addr),
+             sizeof addr) < 0 || ::listen(listenfd, 0) < 0)
+  {
+    perror("blackhole");
+    exit(1);
+  }
+  fds.push_back(listenfd);
+  for (int i = 0; i < 4; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr);
+    fds.push_back(fd);
+  }
+  usleep(100*1000);
+  return fds;
+}
+
+void onServerConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->forceClose();
+  }
+}
+
+void onClientConnection(const muduo::TcpConnectionPtr& conn)
+{
+  muduo::Timestamp now(muduo::Timestamp::now());
+  if (conn->connected())
+  {
+    ++g_round;
+    printf("round %d: %s connected to %s in %.3f ms\n", g_round,
+           conn->name().c_str(),
+           conn->peerAddress().toHostPort().c_str(),
+           timeDifference(now, g_downTime) * 1000);
+    if (g_round >= rounds)
+    {
+      g_client->disconnect();
+      g_loop->runAfter(0.1, boost::bind(&muduo::EventLoop::quit, g_loop));
+    }
+  }
+  else
+  {
+    g_downTime = now;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  rounds = argc > 1 ? atoi(argv[1]) : 5;
+  std::vector<int> hole = blackhole(9982);
+
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setConnectionCallback(onServerConnection);
+  server.start();
+
+  std::vector<muduo::InetAddress> replicas;
+  replicas.push_back(muduo::InetAddress("127.0.0.1", 9983));
+  replicas.push_back(muduo::InetAddress("127.0.0.1", 9982));
+  replicas.push_back(muduo::InetAddress("127.0.0.1", 9981));
+  muduo::TcpClient client(&loop, replicas);
+  g_client = &client;
+  client.setConnectionCallback(onClientConnection);
+  client.enableRetry();
+  g_downTime = muduo::Timestamp::now();
+  client.connect();
+  loop.loop();
+
+  for (size_t i = 0; i < hole.size(); ++i)
+  {
+    ::close(hole[i]);
+  }
+}
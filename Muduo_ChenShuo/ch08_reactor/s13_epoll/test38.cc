@@ -0,0 +1,208 @@
+// read budget of TcpConnection.
+// stop: with a 1 MiB budget, a message callback that stops reading or
+// force closes gets no more messages, each case is checked.
+// fair: one client floods, another pingpongs on the same loop, prints
+// the flood rate and the round trip time for several budgets.
+// usage: test38 [seconds]
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+
+#include <string>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+enum Action { kStopRead, kForceClose };
+const char* kActionNames[] = { "stopRead", "forceClose" };
+
+muduo::EventLoop* g_loop;
+double seconds = 2.0;
+Action action;
+int messages;
+int64_t floodBytes;
+muduo::AtomicInt32 running;
+
+int connectOne()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    perror("connect");
+    exit(1);
+  }
+  return fd;
+}
+
+void onStopConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    // lets the bytes pile up in the kernel, then reads them in one event
+    conn->stopRead();
+    g_loop->runAfter(0.2, boost::bind(&muduo::TcpConnection::startRead, conn));
+  }
+}
+
+void onStopMessage(const muduo::TcpConnectionPtr& conn,
+                   muduo::Buffer* buf,
+                   muduo::Timestamp)
+{
+  buf->retrieveAll();
+  if (++messages == 1)
+  {
+    if (action == kStopRead)
+      conn->stopRead();
+    else
+      conn->forceClose();
+  }
+}
+
+void stopClient()
+{
+  int fd = connectOne();
+  std::string chunk(64 * 1024, 's');
+  // as much as the kernel takes, the server may never read it
+  while (::send(fd, chunk.data(), chunk.size(), MSG_DONTWAIT) > 0)
+  {
+  }
+  usleep(500*1000);
+  ::close(fd);
+  g_loop->runAfter(0.1, boost::bind(&muduo::EventLoop::quit, g_loop));
+}
+
+bool testStop(Action a)
+{
+  action = a;
+  messages = 0;
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setReadBudget(1024 * 1024);
+  server.setConnectionCallback(onStopConnection);
+  server.setMessageCallback(onStopMessage);
+  server.start();
+  muduo::Thread thread(stopClient);
+  thread.start();
+  loop.loop();
+  thread.join();
+  printf("stop: %-10s %d messages, %s\n", kActionNames[a], messages,
+         messages == 1 ? "ok" : "FAILED");
+  return messages == 1;
+}
+
+void onFairConnection(const muduo::TcpConnectionPtr& conn)
+{
+}
+
+// 'p' pings are echoed, the flood is dropped
+void onFairMessage(const muduo::TcpConnectionPtr& conn,
+                   muduo::Buffer* buf,
+                   muduo::Timestamp)
+{
+  if (*buf->peek() == 'p')
+  {
+    conn->send(buf);
+  }
+  else
+  {
+    floodBytes += buf->readableBytes();
+    buf->retrieveAll();
+  }
+}
+
+void flooder()
+{
+  int fd = connectOne();
+  std::string chunk(64 * 1024, 'f');
+  muduo::Timestamp start(muduo::Timestamp::now());
+  while (timeDifference(muduo::Timestamp::now(), start) < seconds)
+  {
+    if (::write(fd, chunk.data(), chunk.size()) <= 0)
+      break;
+  }
+  ::close(fd);
+  if (running.decrementAndGet() == 0)
+    g_loop->runAfter(0.1, boost::bind(&muduo::EventLoop::quit, g_loop));
+}
+
+double g_roundTripUs;
+
+void pinger()
+{
+  int fd = connectOne();
+  char buf[64];
+  memset(buf, 'p', sizeof buf);
+  int64_t count = 0;
+  muduo::Timestamp start(muduo::Timestamp::now());
+  double elapsed = 0;
+  while ((elapsed = timeDifference(muduo::Timestamp::now(), start)) < seconds)
+  {
+    if (::write(fd, buf, sizeof buf) != sizeof buf)
+      break;
+    size_t n = 0;
+    while (n < sizeof buf)
+    {
+      ssize_t nr = ::read(fd, buf + n, sizeof buf - n);
+      if (nr <= 0)
+        break;
+      n += nr;
+    }
+    ++count;
+  }
+  ::close(fd);
+  g_roundTripUs = count > 0 ? elapsed * 1e6 / static_cast<double>(count) : 0;
+  if (running.decrementAndGet() == 0)
+    g_loop->runAfter(0.1, boost::bind(&muduo::EventLoop::quit, g_loop));
+}
+
+void testFair(size_t budget)
+{
+  floodBytes = 0;
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setReadBudget(budget);
+  server.setConnectionCallback(onFairConnection);
+  server.setMessageCallback(onFairMessage);
+  server.start();
+  running.getAndSet(2);
+  muduo::Thread flood(flooder);
+  muduo::Thread ping(pinger);
+  flood.start();
+  ping.start();
+  loop.loop();
+  flood.join();
+  ping.join();
+  printf("fair: budget %5zu KiB, flood %7.1f MiB/s, pingpong %7.1f us\n",
+         budget / 1024, static_cast<double>(floodBytes) / seconds / 1024 / 1024,
+         g_roundTripUs);
+}
+
+int main(int argc, char* argv[])
+{
+  seconds = argc > 1 ? atof(argv[1]) : 2.0;
+  bool ok = true;
+  ok = testStop(kStopRead) && ok;
+  ok = testStop(kForceClose) && ok;
+
+  testFair(0);
+  testFair(64 * 1024);
+  testFair(16 * 1024 * 1024);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+// zero copy payloads of a closed connection.
+// the server sends a 16 MiB payload with MSG_ZEROCOPY to a client that
+// doesn't read, and force closes.  the payload must live until the kernel
+// is done with it: until the client reads all that was queued, or until
+// kZeroCopyLingerSeconds when it never does, then the client gets a RST.
+// usage: test39
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <muduo/base/Thread.h>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+muduo::EventLoop* g_loop;
+double clientDelay;  // seconds before the client reads, < 0 never
+muduo::Timestamp g_start;
+double releasedAt;   // seconds since g_start
+double readAt;
+int64_t received;
+bool intact;
+int readErrno;
+
+struct PayloadDeleter
+{
+  void operator()(const std::string* p) const
+  {
+    releasedAt = timeDifference(muduo::Timestamp::now(), g_start);
+    delete p;
+  }
+};
+
+void onConnection(const muduo::TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    // the test holds no reference, only the connection and the kernel
+    muduo::PayloadPtr payload(new std::string(16 * 1024 * 1024, 'Z'),
+                              PayloadDeleter());
+    conn->send(payload);
+    g_loop->runAfter(0.2,
+        boost::bind(&muduo::TcpConnection::forceClose, conn));
+  }
+}
+
+void client()
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9981);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    perror("connect");
+    exit(1);
+  }
+  usleep(static_cast<useconds_t>(
+      (clientDelay < 0 ? muduo::TcpConnection::kZeroCopyLingerSeconds + 1
+                       : clientDelay) * 1000 * 1000));
+  readAt = timeDifference(muduo::Timestamp::now(), g_start);
+  char buf[65536];
+  ssize_t n = 0;
+  while ((n = ::read(fd, buf, sizeof buf)) > 0)
+  {
+    for (ssize_t i = 0; i < n; ++i)
+    {
+      intact = intact && buf[i] == 'Z';
+    }
+    received += n;
+  }
+  readErrno = n < 0 ? errno : 0;
+  ::close(fd);
+  g_loop->runAfter(0.1, boost::bind(&muduo::EventLoop::quit, g_loop));
+}
+
+bool run(double delay)
+{
+  clientDelay = delay;
+  releasedAt = -1;
+  received = 0;
+  intact = true;
+  muduo::EventLoop loop;
+  g_loop = &loop;
+  muduo::TcpServer server(&loop, muduo::InetAddress(9981));
+  server.setZeroCopyThreshold(64 * 1024);
+  server.setConnectionCallback(onConnection);
+  server.start();
+  g_start = muduo::Timestamp::now();
+  muduo::Thread thread(client);
+  thread.start();
+  loop.loop();
+  thread.join();
+
+  bool ok = false;
+  if (delay >= 0)
+  {
+    // released once the queued bytes are read, intact
+    ok = releasedAt >= readAt && received > 0 && intact;
+  }
+  else
+  {
+    // released at the deadline, the client is reset
+    ok = releasedAt >= muduo::TcpConnection::kZeroCopyLingerSeconds
+         && releasedAt < readAt && readErrno == ECONNRESET;
+  }
+  printf("client reads at %.2f s: %lld bytes%s, %s, "
+         "payload released at %.2f s, %s\n",
+         readAt, static_cast<long long>(received), intact ? "" : " CORRUPT",
+         readErrno ? strerror(readErrno) : "EOF", releasedAt,
+         ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main()
+{
+  bool ok = run(0.5);
+  ok = run(-1) && ok;
+  return ok ? 0 : 1;
+}